@@ -4,6 +4,7 @@
 #include "app.hpp"
 #include "include.h"
 #include "system.hpp"
+#include "resources/shader.hpp"
 
 void App::run() {
     setup();
@@ -13,6 +14,7 @@ void App::run() {
 
 void App::cleanup() {
     System::Files()->cleanup();
+    System::ThreadPool()->cleanup();
     m_cleaner.flush("App");
 }
 
@@ -37,10 +39,20 @@ void App::initDevice() {
     m_pDevice->createLogicalDevice();
     System::Instance().setDevice(m_pDevice);
     m_cleaner.push([=](){ m_pDevice->cleanup(); });
+    
+    MemoryAllocator* pMemoryAllocator = new MemoryAllocator();
+    pMemoryAllocator->create();
+    System::Instance().setMemoryAllocator(pMemoryAllocator);
+    m_cleaner.push([=](){ pMemoryAllocator->cleanup(); });
 }
 
 void App::initCommander() {
     LOG("App::initCommander");
+    Scheduler* pScheduler = new Scheduler();
+    pScheduler->create(m_pDevice->getGraphicQueue());
+    System::Instance().setScheduler(pScheduler);
+    m_cleaner.push([=](){ pScheduler->cleanup(); });
+    
     m_pCommander = new Commander();
     m_pCommander->setupPool();
     m_pCommander->createPool();
@@ -48,6 +60,49 @@ void App::initCommander() {
     m_cleaner.push([=](){ m_pCommander->cleanup(); });
 }
 
+void App::initStagingArena() {
+    LOG("App::initStagingArena");
+    StagingArena* pStagingArena = new StagingArena();
+    pStagingArena->create(STAGING_ARENA_SIZE);
+    System::Instance().setStagingArena(pStagingArena);
+    m_cleaner.push([=](){ pStagingArena->cleanup(); });
+}
+
+// After the arena so batches still in flight release their staging first
+void App::initTransferManager() {
+    LOG("App::initTransferManager");
+    TransferManager* pTransferManager = new TransferManager();
+    pTransferManager->create();
+    System::Instance().setTransferManager(pTransferManager);
+    m_cleaner.push([=](){ pTransferManager->cleanup(); });
+}
+
+// Before any pipeline and cleaned after all of them, so the save sees every one
+void App::initPipelineCache() {
+    LOG("App::initPipelineCache");
+    PipelineCache* pPipelineCache = new PipelineCache();
+    pPipelineCache->create();
+    System::Instance().setPipelineCache(pPipelineCache);
+    m_cleaner.push([=](){ pPipelineCache->cleanup(); });
+}
+
+void App::initTextureHeap() {
+    LOG("App::initTextureHeap");
+    TextureHeap* pTextureHeap = new TextureHeap();
+    pTextureHeap->create(TEXTURE_HEAP_SIZE);
+    System::Instance().setTextureHeap(pTextureHeap);
+    m_cleaner.push([=](){ pTextureHeap->cleanup(); });
+}
+
+// Before any descriptor and cleaned after all of them, their sets go back to these pools
+void App::initDescriptorAllocator() {
+    LOG("App::initDescriptorAllocator");
+    DescriptorAllocator* pDescriptorAllocator = new DescriptorAllocator();
+    pDescriptorAllocator->create();
+    System::Instance().setDescriptorAllocator(pDescriptorAllocator);
+    m_cleaner.push([=](){ pDescriptorAllocator->cleanup(); });
+}
+
 void App::createGraphicsScreen() {
     LOG("App::createGraphicsScreen");
     m_pGraphicsScreen = new GraphicsScreen();
@@ -69,6 +124,24 @@ void App::createSwapchain() {
     m_cleaner.push([=](){ m_pSwapchain->cleanup(); });
 }
 
+// One slot per frame in flight, each slot waits on its own last submit
+void App::initUniformRing() {
+    LOG("App::initUniformRing");
+    UniformRing* pUniformRing = new UniformRing();
+    pUniformRing->create(m_pSwapchain->getFramesInFlight(), UNIFORM_RING_FRAME_SIZE);
+    System::Instance().setUniformRing(pUniformRing);
+    m_cleaner.push([=](){ pUniformRing->cleanup(); });
+}
+
+// Slots follow the uniform ring, reset behind the same per slot wait
+void App::initFrameCommander() {
+    LOG("App::initFrameCommander");
+    FrameCommander* pFrameCommander = new FrameCommander();
+    pFrameCommander->create(m_pSwapchain->getFramesInFlight());
+    System::Instance().setFrameCommander(pFrameCommander);
+    m_cleaner.push([=](){ pFrameCommander->cleanup(); });
+}
+
 void App::createGUI() {
     LOG("App::createGUI");
     Renderpass* pRenderpass  = m_pGraphicsScreen->getRenderpass();
@@ -77,13 +150,14 @@ void App::createGUI() {
     m_cleaner.push([=](){ m_pGUI->cleanupGUI(); });
 }
 
-void App::createGraphicsScene() {
+void App::createGraphicsScene(VECTOR<Mesh*> pMeshes) {
     LOG("App::createGraphicsScene");
     UInt2D size = m_pWindow->getFrameSize();
     m_pGraphicsScene = new GraphicsScene();
     m_pGraphicsScene->setupShader();
     m_pGraphicsScene->createDescriptor();
     m_pGraphicsScene->setupInput();
+    m_pGraphicsScene->setupMesh(pMeshes);
     m_pGraphicsScene->updateTexture();
     m_pGraphicsScene->createRenderpass();
     m_pGraphicsScene->createPipelineLayout();
@@ -94,9 +168,17 @@ void App::createGraphicsScene() {
     m_pGraphicsScreen->setupInput(m_pGraphicsScene->getFrame());
 }
 
+void App::createBenchmark() {
+    LOG("App::createBenchmark");
+    m_pBenchmark = new Benchmark();
+    m_pBenchmark->create();
+    m_cleaner.push([=](){ m_pBenchmark->cleanup(); });
+}
+
 void App::createComputeFluid() {
     LOG("App::createComputeFluid");
     m_pComputeFluid = new ComputeFluid();
+    m_pComputeFluid->setupQueue();
     m_pComputeFluid->setupShader();
     m_pComputeFluid->createDescriptor();
     m_pComputeFluid->setupInput();
@@ -105,10 +187,12 @@ void App::createComputeFluid() {
     m_pComputeFluid->createPipeline();
     m_cleaner.push([=](){ m_pComputeFluid->cleanup(); });
     
-    m_pGraphicsScene->updateHeightmapInput(m_pComputeFluid->getHeightImage());
-    m_pGUI->updateFluidImage(m_pComputeFluid->getFluidImage());
-    m_pGUI->updateHeightMapImage(m_pComputeFluid->getHeightImage());
-    m_pGUI->updateIridescentImage(m_pComputeFluid->getIridescentImage());
+    for (uint i = 0; i < m_pComputeFluid->getOutputCount(); i++) {
+        m_pGraphicsScene->updateHeightmapInput(m_pComputeFluid->getHeightImage(i), i);
+        m_pGUI->updateFluidImage(m_pComputeFluid->getFluidImage(i), i);
+        m_pGUI->updateHeightMapImage(m_pComputeFluid->getHeightImage(i), i);
+        m_pGUI->updateIridescentImage(m_pComputeFluid->getIridescentImage(i), i);
+    }
 }
 
 void App::createInterference() {
@@ -132,25 +216,112 @@ void App::createInterference() {
 }
 
 void App::createCubemap() {
-    LOG("App::createGraphicsEquirect");
+    LOG("App::createCubemap");
     Files *pFiles = System::Files();
     pFiles->setCubemapIdx(System::Settings()->Cubemaps);
-    Image *hdrImg, *hdrEnv, *cubemap, *envMap, *reflMap, *brdfMap;
+    VECTOR<Image*> cubemaps = loadCubemap(pFiles->getCubemapHDRPath(), pFiles->getCubemapEnvPath());
+    m_pGraphicsScene->updateCubemap(cubemaps[0], cubemaps[1], cubemaps[2], cubemaps[3]);
+}
+
+// Builds the new environment on a worker thread with its own pool and queue,
+// the scene keeps the current one until swapCubemap picks the result up
+void App::rebuildCubemap() {
+    LOG("App::rebuildCubemap");
+    if (m_cubemapThread.joinable()) {
+        LOG("App::rebuildCubemap already running");
+        return;
+    }
+    if (!m_pDevice->hasBackgroundQueue()) {
+        createCubemap();
+        return;
+    }
+    Files *pFiles = System::Files();
+    pFiles->setCubemapIdx(System::Settings()->Cubemaps);
+    STRING hdrPath = pFiles->getCubemapHDRPath();
+    STRING envPath = pFiles->getCubemapEnvPath();
+    
+    m_cubemapReady = false;
+    m_cubemapThread = std::thread([=](){
+        Commander* pCommander = new Commander();
+        pCommander->setupPool(System::Device()->getBackgroundQueue());
+        pCommander->createPool();
+        System::setThreadCommander(pCommander);
+        try {
+            m_pendingCubemaps = loadCubemap(hdrPath, envPath);
+        } catch (const std::exception& e) {
+            ERR("App::rebuildCubemap " << e.what());
+        }
+        System::setThreadCommander(nullptr);
+        pCommander->cleanup();
+        m_cubemapReady = true;
+    });
+}
+
+void App::swapCubemap() {
+    if (!m_cubemapReady) return;
+    m_cubemapThread.join();
+    m_cubemapReady = false;
+    VECTOR<Image*> cubemaps = m_pendingCubemaps;
+    m_pendingCubemaps.clear();
+    if (cubemaps.size() != 4) return;
+    m_pGraphicsScene->updateCubemap(cubemaps[0], cubemaps[1], cubemaps[2], cubemaps[3]);
+}
+
+VECTOR<Image*> App::loadCubemap(STRING hdrPath, STRING envPath) {
+    LOG("App::loadCubemap");
+    Image *cubemap, *envMap, *reflMap, *brdfMap;
+    uint length = 1024;
+    VkFormat hdrFormat = System::Settings()->HalfFloatHDR ? VK_FORMAT_R16G16B16A16_SFLOAT
+                                                          : VK_FORMAT_R32G32B32A32_SFLOAT;
+    
+    CubemapCache* pCubemapCache = new CubemapCache();
+    pCubemapCache->setup(hdrPath, envPath, length, GraphicsReflection::MIPLEVELS, hdrFormat);
+    if (!pCubemapCache->load(cubemap, envMap, reflMap, brdfMap)) {
+        TimeVal startTime = ChronoTime::now();
+        MemoryAllocator* pAllocator = System::MemoryAllocator();
+        VkDeviceSize deviceBytes = pAllocator->getDeviceBytes();
+        pAllocator->resetPeakDeviceBytes();
+        
+        // Intermediates alias one pool for the length of the build, switch it off to compare
+        TransientPool* pTransientPool = nullptr;
+        if (System::Settings()->TransientAliasing) {
+            pTransientPool = new TransientPool();
+            pTransientPool->create("cubemap");
+            System::setThreadTransientPool(pTransientPool);
+        }
+        buildCubemap(hdrPath, envPath, length, hdrFormat, cubemap, envMap, reflMap, brdfMap);
+        if (pTransientPool) {
+            System::setThreadTransientPool(nullptr);
+            pTransientPool->report();
+            pTransientPool->cleanup();
+        }
+        LOG("App::loadCubemap device memory " << deviceBytes / (1 << 20) << "MB before build, peak " <<
+            pAllocator->getPeakDeviceBytes() / (1 << 20) << "MB, aliasing " <<
+            (pTransientPool ? "on" : "off"));
+        
+        pCubemapCache->save(cubemap, envMap, reflMap, brdfMap,
+                            TimeDif(ChronoTime::now() - startTime).count());
+        cubemap->cmdTransitionToShaderR();
+        envMap ->cmdTransitionToShaderR();
+        reflMap->cmdTransitionToShaderR();
+        brdfMap->cmdTransitionToShaderR();
+    }
+    pCubemapCache->cleanup();
+    return { cubemap, envMap, reflMap, brdfMap };
+}
+
+void App::buildCubemap(STRING hdrPath, STRING envPath, uint length, VkFormat hdrFormat,
+                       Image*& cubemap, Image*& envMap, Image*& reflMap, Image*& brdfMap) {
+    LOG("App::buildCubemap");
+    Image *hdrImg, *hdrEnv;
+    // Every pipeline of the build is queued first, they compile on the pool while the sources decode
     ComputeHDR* pComputeHDR = new ComputeHDR();
+    pComputeHDR->setOutputFormat(hdrFormat);
     pComputeHDR->setupShader();
     pComputeHDR->createDescriptor();
     pComputeHDR->createPipelineLayout();
     pComputeHDR->createPipeline();
     
-    pComputeHDR->setupInputOutput(pFiles->getCubemapHDRPath());
-    hdrImg = pComputeHDR->dispatch();
-    
-    pComputeHDR->cleanInputOutput();
-    pComputeHDR->setupInputOutput(pFiles->getCubemapEnvPath());
-    hdrEnv = pComputeHDR->dispatch();
-    pComputeHDR->cleanup();
-    
-    uint length = 1024;
     GraphicsEquirect* pGraphicsEquirect = new GraphicsEquirect();
     pGraphicsEquirect->setupShader();
     pGraphicsEquirect->createDescriptor();
@@ -159,64 +330,88 @@ void App::createCubemap() {
     pGraphicsEquirect->createPipelineLayout();
     pGraphicsEquirect->createPipeline();
     
+    GraphicsReflection* pGraphicsReflection = new GraphicsReflection();
+    pGraphicsReflection->setupShader();
+    pGraphicsReflection->createDescriptor();
+    pGraphicsReflection->setupMesh();
+    pGraphicsReflection->createRenderpass();
+    pGraphicsReflection->createPipelineLayout();
+    pGraphicsReflection->createPipeline();
+    
+    ComputeBRDF* pComputeBRDF = new ComputeBRDF();
+    pComputeBRDF->setupShader();
+    pComputeBRDF->createDescriptor();
+    pComputeBRDF->createPipelineLayout();
+    pComputeBRDF->createPipeline();
+    
+    // Each source is released as soon as its cubemap is drawn, so the
+    // second one can take the transient memory the first one left
+    hdrImg = pComputeHDR->load(hdrPath);
     pGraphicsEquirect->setupInput(hdrImg);
     pGraphicsEquirect->createFrame(length);
     cubemap = pGraphicsEquirect->render();
-    m_cleaner.push([=](){ cubemap->cleanup(); });
-    
     pGraphicsEquirect->cleanFrame();
+    hdrImg->cleanup();
+    
+    hdrEnv = pComputeHDR->load(envPath);
     pGraphicsEquirect->setupInput(hdrEnv);
     pGraphicsEquirect->createFrame(length / 16);
     envMap = pGraphicsEquirect->render();
-    m_cleaner.push([=](){ envMap->cleanup(); });
-    
     pGraphicsEquirect->cleanup();
-    hdrImg->cleanup();
     hdrEnv->cleanup();
-    
-    GraphicsReflection* pGraphicsReflection = new GraphicsReflection();
-    pGraphicsReflection->setupShader();
-    pGraphicsReflection->createDescriptor();
-    pGraphicsReflection->setupMesh();
-    pGraphicsReflection->createRenderpass();
-    pGraphicsReflection->createPipelineLayout();
-    pGraphicsReflection->createPipeline();
+    pComputeHDR->cleanup();
     
     pGraphicsReflection->setupInput(cubemap);
     pGraphicsReflection->createFrame();
     reflMap = pGraphicsReflection->render();
-    m_cleaner.push([=](){ reflMap->cleanup(); });
     pGraphicsReflection->cleanup();
     
-    ComputeBRDF* pComputeBRDF = new ComputeBRDF();
-    pComputeBRDF->setupShader();
-    pComputeBRDF->createDescriptor();
-    pComputeBRDF->createPipelineLayout();
-    pComputeBRDF->createPipeline();
     brdfMap = pComputeBRDF->dispatch({1024, 1024});
-    m_cleaner.push([=](){ brdfMap->cleanup(); });
     pComputeBRDF->cleanup();
-    
-    m_pGraphicsScene->updateCubemap(cubemap, envMap, reflMap, brdfMap);
 }
 
+// Workers take the file reads and mesh building off the main thread, which
+// keeps every step that records or submits in the order of the dependencies
 void App::setup() {
     System::Instance().initFiles();
-    
+    System::Instance().initThreadPool();
     m_pCamera = new Camera();
-    initWindow();
-    initDevice();
-    initCommander();
-    createGraphicsScreen();
-    createSwapchain();
-    createGUI();
     
-    createGraphicsScene();
-    createComputeFluid();
+    VECTOR<Mesh*> pMeshes;
+    TaskGraph graph;
+    uint shaders   = graph.addWorker("shaders",      [&](){ Shader::Preload(SPIRV_PATH); });
+    uint meshes    = graph.addWorker("meshes",       [&](){ pMeshes = GraphicsScene::LoadMeshes(); });
+    
+    uint window    = graph.addMain(  "window",       [&](){ initWindow(); });
+    uint device    = graph.addMain(  "device",       [&](){ initDevice(); },                 { window });
+    uint commander = graph.addMain(  "commander",    [&](){ initCommander(); },              { device });
+    uint arena     = graph.addMain(  "stagingArena", [&](){ initStagingArena(); },           { commander });
+    uint transfer  = graph.addMain(  "transfer",     [&](){ initTransferManager(); },        { arena });
+    uint pipelines = graph.addMain(  "pipelines",    [&](){ initPipelineCache(); },          { device });
+    uint texHeap   = graph.addMain(  "textureHeap",  [&](){ initTextureHeap(); },            { commander });
+    uint sets      = graph.addMain(  "descriptors",  [&](){ initDescriptorAllocator(); },    { device });
+    uint screen    = graph.addMain(  "screen",       [&](){ createGraphicsScreen(); },       { transfer, shaders, pipelines, sets });
+    uint swapchain = graph.addMain(  "swapchain",    [&](){ createSwapchain(); },            { screen });
+    uint uniforms  = graph.addMain(  "uniformRing",  [&](){ initUniformRing(); },            { swapchain });
+    uint frameCmds = graph.addMain(  "frameCmds",    [&](){ initFrameCommander(); },         { swapchain });
+    uint gui       = graph.addMain(  "gui",          [&](){ createGUI(); },                  { swapchain, transfer });
     
-    createInterference();
-    createCubemap();
+    uint scene     = graph.addMain(  "scene",        [&](){ createGraphicsScene(pMeshes); }, { screen, transfer, meshes, uniforms, texHeap });
+    uint fluid     = graph.addMain(  "fluid",        [&](){ createComputeFluid(); },         { scene, gui });
+    uint interfere = graph.addMain(  "interference", [&](){ createInterference(); },         { fluid });
+    uint cubemap   = graph.addMain(  "cubemap",      [&](){ createCubemap(); },              { scene });
+    uint benchmark = graph.addMain(  "benchmark",    [&](){ createBenchmark(); },            { transfer, shaders, pipelines, sets });
     
+    // Textures decode on the pool while the steps above run
+    uint textures  = graph.addMain(  "textures",     [&](){ m_pGraphicsScene->streamTexture(true); },
+                                     { interfere, cubemap, benchmark });
+    
+    // Whatever setup left in the batch goes out in one submit
+    graph.addMain("submitTransfers", [&](){ System::TransferManager()->submit(); }, { textures, frameCmds });
+    
+    graph.run();
+    graph.report();
+    Shader::ReleasePreloaded();
 }
 
 void App::draw() {
@@ -227,17 +422,22 @@ void App::draw() {
     GUI* pGUI = m_pGUI;
     
     pSwapchain->prepareFrame();
+    System::UniformRing()->beginFrame(pSwapchain->getFrameIdx());
+    System::FrameCommander()->beginFrame(pSwapchain->getFrameIdx());
     Frame*      pCurrentFrame = pSwapchain->getCurrentFrame();
-    VkCommandBuffer cmdBuffer = pSwapchain->getCommandBuffer();
+    VkCommandBuffer cmdBuffer = System::FrameCommander()->getCommandBuffer();
     
     VkCommandBufferBeginInfo commandBeginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
     VkResult result = vkBeginCommandBuffer(cmdBuffer, &commandBeginInfo);
     CHECK_VKRESULT(result, "failed to begin recording command buffer!");
     
-    if (System::Settings()->RunFluid && System::Settings()->UseFluid) {
+    bool runFluid = System::Settings()->RunFluid && System::Settings()->UseFluid;
+    if (runFluid && !pComputeFluid->isAsync()) {
         pComputeFluid->dispatch(cmdBuffer);
     }
     
+    pGraphicsScene->setHeightmapIdx(pComputeFluid->getOutputIdx());
+    pGUI->setFluidIdx(pComputeFluid->getOutputIdx());
     pGraphicsScene->render(cmdBuffer);
     
     pGraphicsScreen->setFrame(pCurrentFrame);
@@ -245,7 +445,14 @@ void App::draw() {
     
     vkEndCommandBuffer(cmdBuffer);
     
-    pSwapchain->submitFrame();
+    // Uploads recorded since the last frame land ahead of it on the queue
+    System::TransferManager()->submit();
+    VECTOR<Scheduler::Wait> waits;
+    if (pComputeFluid->isAsync()) waits.push_back(pComputeFluid->getWait());
+    uint64_t frameValue = pSwapchain->submitFrame(cmdBuffer, waits);
+    
+    // The next step runs on the compute queue while this frame renders
+    if (runFluid && pComputeFluid->isAsync()) pComputeFluid->dispatchAsync(frameValue);
     pSwapchain->presentFrame();
 }
 
@@ -259,12 +466,32 @@ void App::update() {
     }
     if (settings->btnUpdateCubemap) {
         settings->btnUpdateCubemap = false;
-        createCubemap();
+        rebuildCubemap();
     }
+    m_pGraphicsScene->cleanRetired();
+    System::Scheduler()->update();
+    swapCubemap();
     if (settings->btnUpdateTexture) {
         settings->btnUpdateTexture = false;
         m_pGraphicsScene->updateTexture();
     }
+    m_pGraphicsScene->streamTexture();
+    if (settings->btnBenchmarkMipmap) {
+        settings->btnBenchmarkMipmap = false;
+        m_pBenchmark->runMipmap();
+    }
+    if (settings->btnBenchmarkMaterial) {
+        settings->btnBenchmarkMaterial = false;
+        m_pBenchmark->runMaterial();
+    }
+    if (settings->btnBenchmarkGeometry) {
+        settings->btnBenchmarkGeometry = false;
+        m_pBenchmark->runGeometry();
+    }
+    if (settings->btnBenchmarkPermutation) {
+        settings->btnBenchmarkPermutation = false;
+        m_pBenchmark->runPermutation(m_pGraphicsScene);
+    }
     
     m_pGraphicsScene->updateLightInput();
     m_pGraphicsScene->updateParamInput();
@@ -326,7 +553,9 @@ void App::loop() {
             pRenderTime->sleepIf(lockFps);
         }
     }
-    m_pDevice->waitIdle();
+    if (m_cubemapThread.joinable()) m_cubemapThread.join();
+    for (Image* pImage : m_pendingCubemaps) pImage->cleanup();
+    System::Scheduler()->waitIdle();
 }
 
 void App::checkResized() {
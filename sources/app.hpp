@@ -18,6 +18,9 @@
 #include "pipelines/graphics_equirect.hpp"
 #include "resources/camera.hpp"
 #include "resources/buffer.hpp"
+#include "resources/cubemap_cache.hpp"
+#include "benchmark.hpp"
+#include "task_graph.hpp"
 
 class App {
 public:
@@ -38,6 +41,11 @@ private:
     GraphicsScene* m_pGraphicsScene;
     
     ComputeFluid* m_pComputeFluid;
+    Benchmark*    m_pBenchmark;
+    
+    std::thread       m_cubemapThread;
+    std::atomic<bool> m_cubemapReady{false};
+    VECTOR<Image*>    m_pendingCubemaps;
     
     void cleanup();
     void setup();
@@ -48,17 +56,30 @@ private:
     void initWindow();
     void initDevice();
     void initCommander();
+    void initStagingArena();
+    void initTransferManager();
     
     void createSwapchain();
+    void initUniformRing();
+    void initFrameCommander();
+    void initPipelineCache();
+    void initTextureHeap();
+    void initDescriptorAllocator();
     void createGraphicsScreen();
     void createInterference();
     void createComputeFluid();
     void dispatchInterference();
-    void createGraphicsScene();
+    void createGraphicsScene(VECTOR<Mesh*> pMeshes);
     
     void createCubemap();
+    void rebuildCubemap();
+    void swapCubemap();
+    VECTOR<Image*> loadCubemap(STRING hdrPath, STRING envPath);
+    void buildCubemap(STRING hdrPath, STRING envPath, uint length, VkFormat hdrFormat,
+                      Image*& cubemap, Image*& envMap, Image*& reflMap, Image*& brdfMap);
     
     void createGUI();
+    void createBenchmark();
     
     void moveView(Window* pWindow);
     void moveViewLock(Window* pWindow);
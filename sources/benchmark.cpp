@@ -0,0 +1,246 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#include "benchmark.hpp"
+
+#include "system.hpp"
+#include "pipelines/compute_mipmap.hpp"
+#include "pipelines/graphics_fetch.hpp"
+#include "pipelines/graphics_geometry.hpp"
+
+#include <iomanip>
+#include <sstream>
+
+Benchmark::~Benchmark() {}
+Benchmark::Benchmark() : m_pDevice(System::Device()) {}
+
+void Benchmark::cleanup() { m_cleaner.flush("Benchmark"); }
+
+void Benchmark::create() {
+    LOG("Benchmark::create");
+    VkDevice device = m_pDevice->getDevice();
+    m_timestampPeriod = m_pDevice->getDeviceProperties().limits.timestampPeriod;
+    
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = 2;
+    VkResult result = vkCreateQueryPool(device, &queryPoolInfo, nullptr, &m_queryPool);
+    CHECK_VKRESULT(result, "failed to create timestamp query pool!");
+    m_cleaner.push([=](){ vkDestroyQueryPool(device, m_queryPool, nullptr); });
+}
+
+// Blit chain against ComputeMipmap on 2k and 4k images of every supported format
+void Benchmark::runMipmap() {
+    LOG("Benchmark::runMipmap");
+    VECTOR<uint>     sizes   = { 2048, 4096 };
+    VECTOR<VkFormat> formats = { VK_FORMAT_R8G8B8A8_SRGB,
+                                 VK_FORMAT_R16G16B16A16_SFLOAT,
+                                 VK_FORMAT_R32G32B32A32_SFLOAT };
+    VkClearColorValue clearColor = {{ .5f, .25f, .75f, 1.f }};
+    
+    for (VkFormat format : formats) {
+        for (uint size : sizes) {
+            Image* pImage = CreateMipmapImage(size, format);
+            VkImage image = pImage->getImage();
+            VkImageSubresourceRange baseLevel = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+            auto prepare = [=](VkCommandBuffer cmdBuffer){
+                pImage->cmdTransitionToTransferDst(cmdBuffer);
+                vkCmdClearColorImage(cmdBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                     &clearColor, 1, &baseLevel);
+            };
+            
+            float blitTime = -1.f;
+            try {
+                blitTime = measure(prepare, [=](VkCommandBuffer cmdBuffer){ pImage->cmdGenerateMipmaps(cmdBuffer); });
+            } catch (const std::exception& e) {
+                LOG("Benchmark::runMipmap blit " << e.what());
+            }
+            
+            ComputeMipmap* pComputeMipmap = new ComputeMipmap();
+            pComputeMipmap->setup(pImage);
+            float computeTime = measure(prepare, [=](VkCommandBuffer cmdBuffer){ pComputeMipmap->dispatch(cmdBuffer); });
+            pComputeMipmap->cleanup();
+            pImage->cleanup();
+            
+            std::stringstream stream;
+            stream << std::fixed << std::setprecision(3) << GetFormatName(format) << " " << size << "x" << size <<
+                " blit " << (blitTime < 0 ? STRING("n/a") : std::to_string(blitTime) + "ms") <<
+                " compute " << computeTime << "ms";
+            if (blitTime > 0) stream << " (" << blitTime / computeTime << "x)";
+            LOG("Benchmark::mipmap " << stream.str());
+        }
+    }
+}
+
+// Fetch cost of the five separate maps against albedo, normal and ORM on the
+// selected set at 1080p, plus the texture memory of both layouts over every set
+void Benchmark::runMaterial() {
+    LOG("Benchmark::runMaterial");
+    Files* pFiles     = System::Files();
+    uint   textureIdx = pFiles->m_textureIdx;
+    
+    VkDeviceSize unpackedSize = 0;
+    VkDeviceSize packedSize   = 0;
+    for (uint i = 0; i < pFiles->getTotalTexture(); i++) {
+        pFiles->setTextureIdx(i);
+        std::future<void> pack = pFiles->packTextureORM();
+        if (pack.valid()) pack.get();
+        unpackedSize += GetTextureSize(pFiles->getTextureUnpackedPaths());
+        packedSize   += GetTextureSize(pFiles->getTexturePBRPaths());
+    }
+    pFiles->setTextureIdx(textureIdx);
+    
+    VECTOR<float> fetchTimes;
+    for (VECTOR<STRING> paths : { pFiles->getTextureUnpackedPaths(), pFiles->getTexturePBRPaths() }) {
+        VECTOR<Image*> textures = LoadTextures(paths);
+        GraphicsFetch* pGraphicsFetch = new GraphicsFetch();
+        pGraphicsFetch->setup(textures, { 1920, 1080 });
+        fetchTimes.push_back(measure([](VkCommandBuffer){},
+                                     [=](VkCommandBuffer cmdBuffer){ pGraphicsFetch->render(cmdBuffer); }));
+        pGraphicsFetch->cleanup();
+        for (Image* pTexture : textures) pTexture->cleanup();
+    }
+    
+    std::stringstream stream;
+    stream << std::fixed << std::setprecision(3) <<
+        "fetch 5 maps " << fetchTimes[0] << "ms, 3 maps " << fetchTimes[1] << "ms" <<
+        " (" << fetchTimes[0] / fetchTimes[1] << "x)";
+    LOG("Benchmark::material " << stream.str());
+    
+    stream.str("");
+    stream << std::fixed << std::setprecision(1) <<
+        "memory " << pFiles->getTotalTexture() << " sets, 5 maps " << unpackedSize / 1048576.0 << "MB" <<
+        ", 3 maps " << packedSize / 1048576.0 << "MB" <<
+        ", saved " << (unpackedSize - packedSize) / 1048576.0 << "MB";
+    LOG("Benchmark::material " << stream.str());
+}
+
+// Vertex fetch of the 80k triangle scene sphere with its buffers in host
+// visible memory, as every buffer used to be, against device local memory
+void Benchmark::runGeometry() {
+    LOG("Benchmark::runGeometry");
+    uint instanceCount = 16;
+    Mesh* pMesh = new Mesh();
+    pMesh->createSphere(200, 200);
+    pMesh->createVertexStateInfo();
+    
+    VECTOR<float> drawTimes;
+    for (MemoryUsage memoryUsage : { MEMORY_UPLOAD, MEMORY_GPU_ONLY }) {
+        pMesh->createVertexBuffer(memoryUsage);
+        pMesh->createIndexBuffer(memoryUsage);
+        GraphicsGeometry* pGraphicsGeometry = new GraphicsGeometry();
+        pGraphicsGeometry->setup(pMesh, { 1024, 1024 });
+        drawTimes.push_back(measure([](VkCommandBuffer){},
+                                    [=](VkCommandBuffer cmdBuffer){ pGraphicsGeometry->render(cmdBuffer, instanceCount); }));
+        pGraphicsGeometry->cleanup();
+        pMesh->cleanup();
+    }
+    
+    // Vertices and indices read per draw, post-transform cache hits not counted
+    double gigabytes = double(pMesh->sizeofVertices() + pMesh->sizeofIndices()) * instanceCount / 1e9;
+    double triangles = double(pMesh->getIndexSize()) / 3 * instanceCount / 1e6;
+    std::stringstream stream;
+    stream << std::fixed << std::setprecision(3) << "sphere " << triangles / instanceCount << "M triangles x" <<
+        instanceCount << ", host visible " << drawTimes[0] << "ms " << gigabytes * 1e3 / drawTimes[0] << "GB/s" <<
+        ", device local " << drawTimes[1] << "ms " << gigabytes * 1e3 / drawTimes[1] << "GB/s" <<
+        " (" << drawTimes[0] / drawTimes[1] << "x)";
+    LOG("Benchmark::geometry " << stream.str());
+}
+
+// Mesh pass of the scene with each main1d.frag variant, at the scene's size
+// and with its current mesh, textures and constants. Relative to the variant
+// with every path on, which is what every fragment paid before the split.
+void Benchmark::runPermutation(GraphicsScene* pGraphicsScene) {
+    LOG("Benchmark::runPermutation");
+    uint full = GraphicsScene::PERMUTATION_TEXTURE | GraphicsScene::PERMUTATION_INTERFERENCE |
+                GraphicsScene::PERMUTATION_FLUID;
+    VECTOR<float> drawTimes(GraphicsScene::PERMUTATIONS, -1.f);
+    for (uint permutation = 0; permutation < GraphicsScene::PERMUTATIONS; permutation++) {
+        bool useFluid     = permutation & GraphicsScene::PERMUTATION_FLUID;
+        bool interference = permutation & GraphicsScene::PERMUTATION_INTERFERENCE;
+        if (useFluid && !interference) continue;
+        drawTimes[permutation] = measure([](VkCommandBuffer){}, [=](VkCommandBuffer cmdBuffer){
+            pGraphicsScene->renderPermutation(cmdBuffer, permutation);
+        });
+    }
+    
+    for (uint permutation = 0; permutation < GraphicsScene::PERMUTATIONS; permutation++) {
+        if (drawTimes[permutation] < 0) continue;
+        std::stringstream stream;
+        stream << std::fixed << std::setprecision(3) << GraphicsScene::GetPermutationName(permutation) <<
+            " " << drawTimes[permutation] << "ms (" << drawTimes[permutation] / drawTimes[full] << "x of full)";
+        LOG("Benchmark::permutation " << stream.str());
+    }
+}
+
+
+// Private ==================================================
+
+// Average GPU time of work over m_iterations submits, prepare runs outside the timestamps
+float Benchmark::measure(std::function<void(VkCommandBuffer)> prepare,
+                         std::function<void(VkCommandBuffer)> work) {
+    VkDevice    device    = m_pDevice->getDevice();
+    VkQueryPool queryPool = m_queryPool;
+    Commander*  pCommander = System::Commander();
+    
+    double total = 0;
+    for (uint i = 0; i < m_iterations; i++) {
+        VkCommandBuffer cmdBuffer = pCommander->createCommandBuffer();
+        pCommander->beginSingleTimeCommands(cmdBuffer);
+        vkCmdResetQueryPool(cmdBuffer, queryPool, 0, 2);
+        prepare(cmdBuffer);
+        vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 0);
+        work(cmdBuffer);
+        vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+        pCommander->endSingleTimeCommands(cmdBuffer);
+        
+        uint64_t timestamps[2];
+        vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+        total += double(timestamps[1] - timestamps[0]) * m_timestampPeriod;
+    }
+    return float(total / m_iterations / 1e6);
+}
+
+Image* Benchmark::CreateMipmapImage(uint size, VkFormat format) {
+    Image* pImage = new Image();
+    if (format == VK_FORMAT_R8G8B8A8_SRGB) pImage->setupForTexture({size, size});
+    else                                   pImage->setupForHDRTexture({size, size});
+    pImage->setImageFormat(format);
+    pImage->createWithSampler();
+    return pImage;
+}
+
+VECTOR<Image*> Benchmark::LoadTextures(VECTOR<STRING> paths) {
+    VECTOR<Image*> textures;
+    for (STRING path : paths) {
+        Image* pTexture = new Image();
+        pTexture->setupForTexture(path);
+        pTexture->createWithSampler();
+        pTexture->cmdCopyRawDataToImage();
+        pTexture->cmdTransitionToShaderR();
+        textures.push_back(pTexture);
+    }
+    return textures;
+}
+
+// Full mip chain size as uploaded, only the file headers are read
+VkDeviceSize Benchmark::GetTextureSize(VECTOR<STRING> paths) {
+    VkDeviceSize size = 0;
+    for (STRING path : paths) {
+        Image image;
+        image.setupForTextureInfo(path);
+        size += image.getMipChainSize();
+    }
+    return size;
+}
+
+STRING Benchmark::GetFormatName(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_R8G8B8A8_SRGB      : return "RGBA8_SRGB"; break;
+        case VK_FORMAT_R16G16B16A16_SFLOAT: return "RGBA16F"; break;
+        case VK_FORMAT_R32G32B32A32_SFLOAT: return "RGBA32F"; break;
+        default: return "UNKNOWN"; break;
+    }
+}
@@ -0,0 +1,41 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#pragma once
+
+#include "include.h"
+#include "renderer/device.hpp"
+#include "resources/image.hpp"
+#include "pipelines/graphics_scene.hpp"
+
+// GPU timings for comparing code paths, triggered from the Benchmark header
+// of the status window. Results go to the log.
+class Benchmark {
+public:
+    ~Benchmark();
+    Benchmark();
+    
+    void cleanup();
+    void create();
+    
+    void runMipmap();
+    void runMaterial();
+    void runGeometry();
+    void runPermutation(GraphicsScene* pGraphicsScene);
+    
+private:
+    Cleaner m_cleaner;
+    Device* m_pDevice;
+    
+    VkQueryPool m_queryPool = VK_NULL_HANDLE;
+    float m_timestampPeriod = 1.f;
+    uint  m_iterations = 10;
+    
+    float measure(std::function<void(VkCommandBuffer)> prepare,
+                  std::function<void(VkCommandBuffer)> work);
+    
+    static Image* CreateMipmapImage(uint size, VkFormat format);
+    static VECTOR<Image*> LoadTextures(VECTOR<STRING> paths);
+    static VkDeviceSize   GetTextureSize(VECTOR<STRING> paths);
+    static STRING GetFormatName(VkFormat format);
+};
@@ -0,0 +1,89 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#pragma once
+
+#include "include.h"
+
+#include <fstream>
+
+// Minimal KTX2 reader for the block compressed files written by
+// tools/compress_textures.sh: 2D, one layer, one face, no supercompression.
+class KTX2 {
+    
+    struct Header {
+        char     identifier[12];
+        uint32_t vkFormat;
+        uint32_t typeSize;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t layerCount;
+        uint32_t faceCount;
+        uint32_t levelCount;
+        uint32_t supercompressionScheme;
+        uint32_t dfdByteOffset;
+        uint32_t dfdByteLength;
+        uint32_t kvdByteOffset;
+        uint32_t kvdByteLength;
+        uint64_t sgdByteOffset;
+        uint64_t sgdByteLength;
+    };
+    
+public:
+    
+    struct Level {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;
+    };
+    
+    struct Info {
+        VkFormat format;
+        uint32_t width;
+        uint32_t height;
+        VECTOR<Level> levels;
+    };
+    
+    // Keeps the source extension, the albedo png and its jpg preview share a stem
+    static std::string GetPath(const std::string filename) {
+        return filename + ".ktx2";
+    }
+    
+    static bool LoadInfo(const std::string filename, Info* info) {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open()) return false;
+        
+        const char identifier[12] = { '\xAB', 'K', 'T', 'X', ' ', '2', '0', '\xBB', '\r', '\n', '\x1A', '\n' };
+        Header header{};
+        file.read(reinterpret_cast<char*>(&header), sizeof(Header));
+        if (!file || memcmp(header.identifier, identifier, 12) != 0 ||
+            header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1 ||
+            header.supercompressionScheme != 0) {
+            PRINTLN2("unsupported ktx2 file ", filename);
+            return false;
+        }
+        
+        info->format = VkFormat(header.vkFormat);
+        info->width  = header.pixelWidth;
+        info->height = header.pixelHeight;
+        info->levels.resize(std::max(header.levelCount, 1u));
+        file.read(reinterpret_cast<char*>(info->levels.data()), info->levels.size() * sizeof(Level));
+        return bool(file);
+    }
+    
+    // Level i lands at pDst + offsets[i], the file stores them smallest first
+    static bool LoadLevels(const std::string filename, const Info& info,
+                           unsigned char* pDst, VECTOR<VkDeviceSize> offsets) {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open()) return false;
+        for (uint i = 0; i < offsets.size(); i++) {
+            file.seekg(info.levels[i].byteOffset);
+            file.read(reinterpret_cast<char*>(pDst + offsets[i]), info.levels[i].byteLength);
+        }
+        if (file) return true;
+        PRINTLN2("failed to read ktx2 levels ", filename);
+        return false;
+    }
+    
+};
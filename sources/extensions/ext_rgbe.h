@@ -0,0 +1,135 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#pragma once
+
+#include "include.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Radiance .hdr reader that keeps pixels as packed RGBE, 4 bytes each, so the
+// float expansion can happen on the GPU. LoadInfo indexes every scanline, after
+// that any range of rows can be decoded independently.
+class RGBE {
+    
+public:
+    
+    struct Info {
+        uint32_t width;
+        uint32_t height;
+        bool     isFlat;
+        VECTOR<size_t> scanlines;
+    };
+    
+    static const unsigned char* MapFile(const std::string filename, size_t* size) {
+        int file = open(filename.c_str(), O_RDONLY);
+        if (file < 0) {
+            PRINTLN2("failed to open hdr image ", filename);
+            return nullptr;
+        }
+        struct stat fileStat;
+        void* pData = MAP_FAILED;
+        if (fstat(file, &fileStat) == 0 && fileStat.st_size > 0)
+            pData = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        close(file);
+        if (pData == MAP_FAILED) {
+            PRINTLN2("failed to map hdr image ", filename);
+            return nullptr;
+        }
+        *size = fileStat.st_size;
+        return static_cast<const unsigned char*>(pData);
+    }
+    
+    static void UnmapFile(const unsigned char* pData, size_t size) {
+        munmap(const_cast<unsigned char*>(pData), size);
+    }
+    
+    // Only the common "-Y h +X w" orientation in 32-bit_rle_rgbe is accepted
+    static bool LoadInfo(const unsigned char* pData, size_t size, Info* info) {
+        size_t offset = 0;
+        std::string line;
+        if (!ReadLine(pData, size, offset, line) || (line != "#?RADIANCE" && line != "#?RGBE")) return false;
+        while (ReadLine(pData, size, offset, line) && !line.empty()) {
+            if (line.compare(0, 7, "FORMAT=") == 0 && line != "FORMAT=32-bit_rle_rgbe") return false;
+        }
+        int width = 0, height = 0;
+        if (!ReadLine(pData, size, offset, line) ||
+            sscanf(line.c_str(), "-Y %d +X %d", &height, &width) != 2 || width <= 0 || height <= 0) return false;
+        
+        info->width  = width;
+        info->height = height;
+        info->scanlines.resize(height);
+        
+        // Flat files, and any width the RLE header can't hold, store raw RGBE rows
+        bool hasRLEHeader = offset + 4 <= size && pData[offset] == 2 && pData[offset + 1] == 2 &&
+                            ((pData[offset + 2] << 8) | pData[offset + 3]) == width;
+        info->isFlat = width < 8 || width > 0x7fff || !hasRLEHeader;
+        for (uint32_t y = 0; y < info->height; y++) {
+            info->scanlines[y] = offset;
+            offset = info->isFlat ? offset + size_t(width) * 4 : SkipScanline(pData, size, offset, width);
+            if (offset > size) return false;
+        }
+        return true;
+    }
+    
+    // Writes rows [first, first + count) to pDst + first * width * 4
+    static bool DecodeScanlines(const unsigned char* pData, size_t size, const Info& info,
+                                uint32_t first, uint32_t count, unsigned char* pDst) {
+        size_t rowSize = size_t(info.width) * 4;
+        for (uint32_t y = first; y < first + count; y++) {
+            const unsigned char* pSrc = pData + info.scanlines[y];
+            unsigned char*       pRow = pDst  + y * rowSize;
+            if (info.isFlat) {
+                memcpy(pRow, pSrc, rowSize);
+                continue;
+            }
+            // Each channel is run length encoded separately, planar in the file
+            size_t offset = info.scanlines[y] + 4;
+            for (uint32_t c = 0; c < 4; c++) {
+                uint32_t x = 0;
+                while (x < info.width) {
+                    if (offset >= size) return false;
+                    uint32_t code   = pData[offset++];
+                    bool     isRun  = code > 128;
+                    uint32_t length = isRun ? code - 128 : code;
+                    if (length == 0 || x + length > info.width || offset + (isRun ? 1 : length) > size) return false;
+                    for (uint32_t i = 0; i < length; i++, x++)
+                        pRow[x * 4 + c] = isRun ? pData[offset] : pData[offset + i];
+                    offset += isRun ? 1 : length;
+                }
+            }
+        }
+        return true;
+    }
+    
+private:
+    
+    static bool ReadLine(const unsigned char* pData, size_t size, size_t& offset, std::string& line) {
+        line.clear();
+        while (offset < size && pData[offset] != '\n') line += char(pData[offset++]);
+        return offset++ < size;
+    }
+    
+    // Walks the run lengths without writing, returns the offset of the next scanline
+    static size_t SkipScanline(const unsigned char* pData, size_t size, size_t offset, uint32_t width) {
+        if (offset + 4 > size || pData[offset] != 2 || pData[offset + 1] != 2) return SIZE_MAX;
+        offset += 4;
+        for (uint32_t c = 0; c < 4; c++) {
+            uint32_t x = 0;
+            while (x < width) {
+                if (offset >= size) return SIZE_MAX;
+                uint32_t code   = pData[offset++];
+                bool     isRun  = code > 128;
+                uint32_t length = isRun ? code - 128 : code;
+                if (length == 0 || x + length > width) return SIZE_MAX;
+                x      += length;
+                offset += isRun ? 1 : length;
+            }
+        }
+        return offset;
+    }
+    
+};
@@ -18,6 +18,30 @@ public:
         return nullptr;
     }
 
+    // stb always hands back its own allocation, so the pixels are copied into
+    // pDst and that allocation is released before returning
+    static bool LoadImageInto(const std::string filename, unsigned char* pDst, int width, int height) {
+        int w, h, c;
+        unsigned char *data = stbi_load(filename.c_str(), &w, &h, &c, STBI_rgb_alpha);
+        if (!data) {
+            PRINTLN2("failed to load image ", filename);
+            return false;
+        }
+        bool isMatching = w == width && h == height;
+        if (isMatching) memcpy(pDst, data, size_t(w) * h * STBI_rgb_alpha);
+        else            PRINTLN2("image size changed while loading ", filename);
+        stbi_image_free(data);
+        return isMatching;
+    }
+
+    static bool LoadInfo(const std::string filename, int* width, int* height, int* channels) {
+        if (stbi_info(filename.c_str(), width, height, channels)) return true;
+        PRINTLN2("failed to read image info ", filename);
+        return false;
+    }
+    
+    static void FreeImage(void* data) { stbi_image_free(data); }
+
     static float* LoadHDR(const std::string filename, int* width, int* height, int* channels) {
         float *data = stbi_loadf(filename.c_str(), width, height, channels, STBI_default);
         if (data) return data;
@@ -0,0 +1,45 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#pragma once
+
+#include "include.h"
+
+#include <fstream>
+
+// Uncompressed 32 bit TGA writer, enough for generated textures stb can read back
+class TGA {
+    
+public:
+    
+    static bool WriteImage(const std::string filename, int width, int height, const unsigned char* rgba) {
+        unsigned char header[18] = {};
+        header[2]  = 2;     // uncompressed true color
+        header[12] = width  & 0xff;
+        header[13] = (width  >> 8) & 0xff;
+        header[14] = height & 0xff;
+        header[15] = (height >> 8) & 0xff;
+        header[16] = 32;
+        header[17] = 0x28;  // 8 alpha bits, top left origin
+        
+        VECTOR<unsigned char> bgra(size_t(width) * height * 4);
+        for (size_t i = 0; i < bgra.size(); i += 4) {
+            bgra[i + 0] = rgba[i + 2];
+            bgra[i + 1] = rgba[i + 1];
+            bgra[i + 2] = rgba[i + 0];
+            bgra[i + 3] = rgba[i + 3];
+        }
+        
+        // Rename only a complete file so an interrupted write never looks valid
+        std::string temp = filename + ".tmp";
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(bgra.data()), bgra.size());
+        file.close();
+        if (file && std::rename(temp.c_str(), filename.c_str()) == 0) return true;
+        std::remove(temp.c_str());
+        PRINTLN2("failed to write image ", filename);
+        return false;
+    }
+    
+};
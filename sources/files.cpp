@@ -3,6 +3,8 @@
 
 #include "files.hpp"
 
+#include <sys/stat.h>
+
 Files::~Files() {}
 Files::Files() {}
 
@@ -53,7 +55,17 @@ STRING Files::getTextureAOPath()        { return PBR_PATH + getTextureName() + T
 STRING Files::getTextureMetallicPath()  { return PBR_PATH + getTextureName() + TEXTURE_METALLIC_PATH; }
 STRING Files::getTextureNormalPath()    { return PBR_PATH + getTextureName() + TEXTURE_NORMAL_PATH; }
 STRING Files::getTextureRoughnessPath() { return PBR_PATH + getTextureName() + TEXTURE_ROUGHNESS_PATH; }
+STRING Files::getTextureORMPath()       { return PBR_PATH + getTextureName() + TEXTURE_ORM_PATH; }
+
+// Binding order of set 2 in main1d.frag, call packTextureORM first
 VECTOR<STRING> Files::getTexturePBRPaths(){
+    return {
+        getTextureAlbedoPath(),
+        getTextureNormalPath(),
+        getTextureORMPath() };
+}
+
+VECTOR<STRING> Files::getTextureUnpackedPaths(){
     return {
         getTextureAlbedoPath(),
         getTextureAOPath(),
@@ -61,3 +73,28 @@ VECTOR<STRING> Files::getTexturePBRPaths(){
         getTextureNormalPath(),
         getTextureRoughnessPath() };
 }
+
+// AO, roughness and metallic go into r, g, b of one texture, the same order as glTF.
+// The packed file sits next to the sources and is rebuilt only when one of them changes.
+// Packs on the thread pool, the future is invalid when the file is already up to date.
+std::future<void> Files::packTextureORM() {
+    STRING ormPath = getTextureORMPath();
+    VECTOR<STRING> srcPaths = { getTextureAOPath(), getTextureRoughnessPath(), getTextureMetallicPath() };
+    if (IsUpToDate(ormPath, srcPaths)) return {};
+    
+    LOG("Files::packTextureORM " << ormPath);
+    return Image::PackChannels(srcPaths, ormPath);
+}
+
+
+// Private ==================================================
+
+bool Files::IsUpToDate(STRING path, VECTOR<STRING> srcPaths) {
+    struct stat fileStat;
+    if (stat(path.c_str(), &fileStat) != 0) return false;
+    for (STRING srcPath : srcPaths) {
+        struct stat srcStat;
+        if (stat(srcPath.c_str(), &srcStat) == 0 && srcStat.st_mtime > fileStat.st_mtime) return false;
+    }
+    return true;
+}
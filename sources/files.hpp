@@ -33,7 +33,10 @@ public:
     STRING getTextureMetallicPath();
     STRING getTextureNormalPath();
     STRING getTextureRoughnessPath();
+    STRING getTextureORMPath();
     VECTOR<STRING> getTexturePBRPaths();
+    VECTOR<STRING> getTextureUnpackedPaths();
+    std::future<void> packTextureORM();
     VECTOR<Image*> getTexturePreviews();
     
     uint   getTotalCubemap();
@@ -45,6 +48,8 @@ public:
 private:
     Cleaner m_cleaner;
     
+    static bool IsUpToDate(STRING path, VECTOR<STRING> srcPaths);
+    
     const VECTOR<STRING> CUBEMAP_NAMES = {"Arches_E_PineTree", "GravelPlaza", "Tokyo_BigSight", "Ueno-Shrine"};
     const STRING CUBEMAP_HDR_PATH = ".hdr";
     const STRING CUBEMAP_ENV_PATH = "_Env.hdr";
@@ -56,6 +61,7 @@ private:
     const STRING TEXTURE_METALLIC_PATH  = "_metallic.png";
     const STRING TEXTURE_NORMAL_PATH    = "_normal.png";
     const STRING TEXTURE_ROUGHNESS_PATH = "_roughness.png";
+    const STRING TEXTURE_ORM_PATH       = "_orm.tga";
     const STRING TEXTURE_PREV_PATH = "_albedo.jpg";
 };
 
@@ -24,6 +24,8 @@
 #include <map>
 #include <set>
 #include <unordered_map>
+#include <thread>
+#include <atomic>
 #include <unistd.h>
 
 #pragma clang diagnostic pop
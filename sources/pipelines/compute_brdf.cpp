@@ -29,7 +29,6 @@ void ComputeBRDF::createDescriptor() {
     m_pDescriptor->addLayoutBindings(S0, B0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
                                      VK_SHADER_STAGE_COMPUTE_BIT);
     m_pDescriptor->createLayout(S0);
-    m_pDescriptor->createPool();
 
     m_pDescriptor->allocate(S0);
     m_cleaner.push([=](){ m_pDescriptor->cleanup(); });
@@ -65,7 +64,7 @@ void ComputeBRDF::createPipeline() {
     m_pPipeline = new Pipeline();
     m_pPipeline->setPipelineLayout(pipelineLayout);
     m_pPipeline->setShaderStages({shaderStage});
-    m_pPipeline->createComputePipeline();
+    m_pPipeline->buildComputePipeline();
     m_cleaner.push([=](){ m_pPipeline->cleanup(); });
 }
 
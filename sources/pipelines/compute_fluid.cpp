@@ -14,6 +14,35 @@ ComputeFluid::ComputeFluid() : m_pDevice(System::Device()) {}
 
 void ComputeFluid::cleanup() { m_cleaner.flush("ComputeFluid"); }
 
+void ComputeFluid::setupQueue() {
+    if (!m_pDevice->hasComputeQueue()) {
+        LOG("ComputeFluid::setupQueue inline");
+        return;
+    }
+    LOG("ComputeFluid::setupQueue async");
+    VkDevice device = m_pDevice->getDevice();
+    m_outputCount = 2;
+    m_pScheduler  = new Scheduler();
+    m_pScheduler->create(m_pDevice->getComputeQueue());
+    m_cleaner.push([=](){ m_pScheduler->cleanup(); });
+    
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = m_pDevice->getComputeQueueIndex();
+    VkResult result = vkCreateCommandPool(device, &poolInfo, nullptr, &m_commandPool);
+    CHECK_VKRESULT(result, "failed to create compute command pool!");
+    m_cleaner.push([=](){ vkDestroyCommandPool(device, m_commandPool, nullptr); });
+    
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = m_commandPool;
+    allocInfo.commandBufferCount = m_outputCount;
+    result = vkAllocateCommandBuffers(device, &allocInfo, m_commandBuffers);
+    CHECK_VKRESULT(result, "failed to allocate compute command buffers!");
+}
+
 void ComputeFluid::setupShader() {
     LOG("ComputeFluid::setupShader");
     Shader* compShader = new Shader(SPIRV_PATH + "fluid.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
@@ -34,47 +63,37 @@ void ComputeFluid::updateInterferenceInput(Image* pInterferenceImage) {
 }
 
 void ComputeFluid::setupOutput() {
-    m_pSampledImage = new Image();
-    m_pSampledImage->setupForStorage(m_details.size);
-    m_pSampledImage->createWithSampler();
-    m_pSampledImage->cmdClearColorImage();
+    VECTOR<uint32_t> queueFamilies = { m_pDevice->getGraphicQueueIndex() };
+    if (isAsync() && m_pDevice->getComputeQueueIndex() != queueFamilies[0])
+        queueFamilies.push_back(m_pDevice->getComputeQueueIndex());
+    
+    m_pSampledImage = createOutput(queueFamilies);
     m_pSampledImage->cmdTransitionToShaderR();
     
-    m_pFluidImage = new Image();
-    m_pFluidImage->setupForStorage(m_details.size);
-    m_pFluidImage->createWithSampler();
-    m_pFluidImage->cmdClearColorImage();
-    m_pFluidImage->cmdTransitionToStorageW();
-    
-    m_pHeightImage = new Image();
-    m_pHeightImage->setupForStorage(m_details.size);
-    m_pHeightImage->createWithSampler();
-    m_pHeightImage->cmdClearColorImage();
-    m_pHeightImage->cmdTransitionToStorageW();
-    
-    m_pIridescentImage = new Image();
-    m_pIridescentImage->setupForStorage(m_details.size);
-    m_pIridescentImage->createWithSampler();
-    m_pIridescentImage->cmdClearColorImage();
-    m_pIridescentImage->cmdTransitionToStorageW();
-    
-    m_pDescriptor->setupPointerImage(S0, B0, m_pSampledImage->getDescriptorInfo());
-    m_pDescriptor->setupPointerImage(S0, B1, m_pFluidImage->getDescriptorInfo());
-    m_pDescriptor->setupPointerImage(S0, B2, m_pHeightImage->getDescriptorInfo());
-    m_pDescriptor->setupPointerImage(S0, B3, m_pIridescentImage->getDescriptorInfo());
-    m_pDescriptor->update(S0);
-    
-    m_cleaner.push([=](){ m_pSampledImage->cleanup(); });
-    m_cleaner.push([=](){ m_pFluidImage->cleanup(); });
-    m_cleaner.push([=](){ m_pHeightImage->cleanup(); });
-    m_cleaner.push([=](){ m_pIridescentImage->cleanup(); });
+    for (uint i = 0; i < m_outputCount; i++) {
+        m_pFluidImage[i]      = createOutput(queueFamilies);
+        m_pHeightImage[i]     = createOutput(queueFamilies);
+        m_pIridescentImage[i] = createOutput(queueFamilies);
+        m_pFluidImage[i]     ->cmdTransitionToStorageW();
+        m_pHeightImage[i]    ->cmdTransitionToStorageW();
+        m_pIridescentImage[i]->cmdTransitionToStorageW();
+        
+        m_pDescriptor->setupPointerImage(S0, i, B0, m_pSampledImage->getDescriptorInfo());
+        m_pDescriptor->setupPointerImage(S0, i, B1, m_pFluidImage[i]->getDescriptorInfo());
+        m_pDescriptor->setupPointerImage(S0, i, B2, m_pHeightImage[i]->getDescriptorInfo());
+        m_pDescriptor->setupPointerImage(S0, i, B3, m_pIridescentImage[i]->getDescriptorInfo());
+        m_pDescriptor->update(S0);
+    }
+    
+    // A step still in flight writes the outputs
+    m_cleaner.push([=](){ if (isAsync()) m_pScheduler->waitIdle(); });
 }
 
 void ComputeFluid::createDescriptor() {
     LOG("ComputeFluid::createDescriptor");
     m_pDescriptor = new Descriptor();
     
-    m_pDescriptor->setupLayout(S0);
+    m_pDescriptor->setupLayout(S0, m_outputCount);
     m_pDescriptor->addLayoutBindings(S0, B0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                                      VK_SHADER_STAGE_COMPUTE_BIT);
     m_pDescriptor->addLayoutBindings(S0, B1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
@@ -89,7 +108,6 @@ void ComputeFluid::createDescriptor() {
     m_pDescriptor->addLayoutBindings(S1, B0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                                      VK_SHADER_STAGE_COMPUTE_BIT);
     m_pDescriptor->createLayout(S1);
-    m_pDescriptor->createPool();
 
     m_pDescriptor->allocate(S0);
     m_pDescriptor->allocate(S1);
@@ -129,20 +147,70 @@ void ComputeFluid::createPipeline() {
     m_pPipeline = new Pipeline();
     m_pPipeline->setPipelineLayout(pipelineLayout);
     m_pPipeline->setShaderStages({shaderStage});
-    m_pPipeline->createComputePipeline();
+    m_pPipeline->buildComputePipeline();
     m_cleaner.push([=](){ m_pPipeline->cleanup(); });
 }
 
 void ComputeFluid::dispatch(VkCommandBuffer cmdBuffer) {
+    record(cmdBuffer, m_outputIdx, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
+
+void ComputeFluid::dispatchAsync(uint64_t frameValue) {
+    m_readValues[m_outputIdx] = frameValue;
+    uint idx = (m_outputIdx + 1) % m_outputCount;
+    // A set no frame has read yet still waits on the setup that cleared it, which the frame follows
+    uint64_t readValue = m_readValues[idx] ? m_readValues[idx] : frameValue;
+    
+    VkCommandBuffer cmdBuffer = m_commandBuffers[idx];
+    m_pScheduler->wait(m_stepValues[idx]);
+    vkResetCommandBuffer(cmdBuffer, 0);
+    
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(cmdBuffer, &beginInfo);
+    record(cmdBuffer, idx, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    vkEndCommandBuffer(cmdBuffer);
+    
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers    = &cmdBuffer;
+    m_stepValues[idx] = m_pScheduler->submit(submitInfo, {
+        { System::Scheduler(), readValue, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT }
+    });
+    m_outputIdx = idx;
+}
+
+bool ComputeFluid::isAsync       () { return m_pScheduler != nullptr; }
+uint ComputeFluid::getOutputIdx  () { return m_outputIdx; }
+uint ComputeFluid::getOutputCount() { return m_outputCount; }
+
+Scheduler::Wait ComputeFluid::getWait() {
+    return { m_pScheduler, m_stepValues[m_outputIdx], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT };
+}
+
+Image * ComputeFluid::getFluidImage     (uint idx) { return m_pFluidImage[idx];  }
+Image * ComputeFluid::getHeightImage    (uint idx) { return m_pHeightImage[idx]; }
+Image * ComputeFluid::getIridescentImage(uint idx) { return m_pIridescentImage[idx]; }
+
+
+// Private ==================================================
+
+// Compute-only queues take no graphics stages, so the caller names where the outputs are read next
+void ComputeFluid::record(VkCommandBuffer cmdBuffer, uint idx, VkPipelineStageFlags readStage) {
     VkPipelineLayout  pipelineLayout = m_pipelineLayout;
     VkPipeline        pipeline = m_pPipeline->get();
     PCMisc            details  = m_details;
-    VkDescriptorSet   outputDescSet = m_pDescriptor->getDescriptorSet(S0);
+    VkDescriptorSet   outputDescSet = m_pDescriptor->getDescriptorSets(S0)[idx];
     VkDescriptorSet   interferenceDescSet = m_pDescriptor->getDescriptorSet(S1);
+    Image* pFluidImage      = m_pFluidImage[idx];
+    Image* pHeightImage     = m_pHeightImage[idx];
+    Image* pIridescentImage = m_pIridescentImage[idx];
     
-    m_pFluidImage->cmdTransitionToStorageW(cmdBuffer);
-    m_pHeightImage->cmdTransitionToStorageW(cmdBuffer);
-    m_pIridescentImage->cmdTransitionToStorageW(cmdBuffer);
+    pFluidImage->cmdTransitionToStorageW(cmdBuffer);
+    pHeightImage->cmdTransitionToStorageW(cmdBuffer);
+    pIridescentImage->cmdTransitionToStorageW(cmdBuffer);
     
     vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,
                        0, sizeof(PCMisc), &details);
@@ -157,17 +225,26 @@ void ComputeFluid::dispatch(VkCommandBuffer cmdBuffer) {
                   details.size.width  / WORKGROUP_SIZE_X + 1,
                   details.size.height / WORKGROUP_SIZE_Y + 1, 1);
     
-    m_pFluidImage->cmdTransitionToTransferSrc(cmdBuffer);
+    pFluidImage->cmdTransitionToTransferSrc(cmdBuffer);
     m_pSampledImage->cmdTransitionToTransferDst(cmdBuffer);
     
-    m_pSampledImage->cmdCopyImageToImage(cmdBuffer, m_pFluidImage);
+    m_pSampledImage->cmdCopyImageToImage(cmdBuffer, pFluidImage);
     
-    m_pSampledImage->cmdTransitionToShaderR(cmdBuffer);
-    m_pFluidImage->cmdTransitionToShaderR(cmdBuffer);
-    m_pHeightImage->cmdTransitionToShaderR(cmdBuffer);
-    m_pIridescentImage->cmdTransitionToShaderR(cmdBuffer);
+    for (Image* pImage : { m_pSampledImage, pFluidImage, pHeightImage, pIridescentImage }) {
+        pImage->cmdChangeLayout(cmdBuffer,
+                                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                VK_ACCESS_SHADER_READ_BIT,
+                                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                readStage);
+    }
 }
 
-Image * ComputeFluid::getFluidImage     () { return m_pFluidImage;  }
-Image * ComputeFluid::getHeightImage    () { return m_pHeightImage; }
-Image * ComputeFluid::getIridescentImage() { return m_pIridescentImage; }
+Image* ComputeFluid::createOutput(VECTOR<uint32_t> queueFamilies) {
+    Image* pImage = new Image();
+    pImage->setupForStorage(m_details.size);
+    pImage->setQueueFamilies(queueFamilies);
+    pImage->createWithSampler();
+    pImage->cmdClearColorImage();
+    m_cleaner.push([=](){ pImage->cleanup(); });
+    return pImage;
+}
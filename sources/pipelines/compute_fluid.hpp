@@ -7,9 +7,15 @@
 #include "../renderer/device.hpp"
 #include "../renderer/pipeline.hpp"
 #include "../renderer/descriptor.hpp"
+#include "../renderer/scheduler.hpp"
 #include "../resources/image.hpp"
 #include "../resources/buffer.hpp"
 
+// With a separate compute queue the fluid step runs there, one frame ahead of
+// the graphics queue. The outputs are double buffered: a step writes one set
+// while the frame in flight reads the other, frames wait on the step's
+// timeline value and steps wait on the frame that last read their set.
+// Without one the step is recorded inline ahead of the scene as before.
 class ComputeFluid {
 
     struct PCMisc {
@@ -23,7 +29,10 @@ public:
     
     void cleanup();
     void dispatch(VkCommandBuffer cmdBuffer);
+    // Steps into the set the next frame reads, after the frame just submitted
+    void dispatchAsync(uint64_t frameValue);
     
+    void setupQueue();
     void setupShader();
     void setupInput();
     void setupOutput();
@@ -34,9 +43,15 @@ public:
     void createPipelineLayout();
     void createPipeline();
     
-    Image* getFluidImage();
-    Image* getHeightImage();
-    Image* getIridescentImage();
+    bool   isAsync();
+    uint   getOutputIdx();
+    uint   getOutputCount();
+    // What a frame reading the current output waits on
+    Scheduler::Wait getWait();
+    
+    Image* getFluidImage     (uint idx = 0);
+    Image* getHeightImage    (uint idx = 0);
+    Image* getIridescentImage(uint idx = 0);
     
 private:
     Cleaner m_cleaner;
@@ -45,9 +60,17 @@ private:
     Descriptor* m_pDescriptor;
     
     Image* m_pSampledImage;
-    Image* m_pFluidImage;
-    Image* m_pHeightImage;
-    Image* m_pIridescentImage;
+    Image* m_pFluidImage[2];
+    Image* m_pHeightImage[2];
+    Image* m_pIridescentImage[2];
+    
+    Scheduler*      m_pScheduler = nullptr;
+    VkCommandPool   m_commandPool;
+    VkCommandBuffer m_commandBuffers[2];
+    uint64_t        m_stepValues[2] = { 0, 0 };
+    uint64_t        m_readValues[2] = { 0, 0 };
+    uint            m_outputIdx   = 0;
+    uint            m_outputCount = 1;
     
     Image* m_pInterferenceImage;
     
@@ -57,4 +80,7 @@ private:
     
     VkPushConstantRange m_pushConstantRange;
     VkPipelineShaderStageCreateInfo m_shaderStage;
+    
+    void record(VkCommandBuffer cmdBuffer, uint idx, VkPipelineStageFlags readStage);
+    Image* createOutput(VECTOR<uint32_t> queueFamilies);
 };
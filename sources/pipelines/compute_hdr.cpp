@@ -5,6 +5,9 @@
 
 #include "../system.hpp"
 #include "../resources/shader.hpp"
+#include "compute_mipmap.hpp"
+
+#include "../extensions/ext_rgbe.h"
 
 #define WORKGROUP_SIZE_X 16
 #define WORKGROUP_SIZE_Y 16
@@ -14,9 +17,13 @@ ComputeHDR::ComputeHDR() {}
 
 void ComputeHDR::cleanup() { m_cleaner.flush("ComputeHDR"); }
 
+// R32G32B32A32_SFLOAT or R16G16B16A16_SFLOAT, set before setupShader
+void ComputeHDR::setOutputFormat(VkFormat format) { m_outputFormat = format; }
+
 void ComputeHDR::setupShader() {
     LOG("ComputeHDR::setupShader");
-    Shader* compShader = new Shader(SPIRV_PATH + "hdr.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+    STRING shaderName = m_outputFormat == VK_FORMAT_R16G16B16A16_SFLOAT ? "hdr_rgba16f.comp.spv" : "hdr_rgba32f.comp.spv";
+    Shader* compShader = new Shader(SPIRV_PATH + shaderName, VK_SHADER_STAGE_COMPUTE_BIT);
     m_shaderStage = compShader->getShaderStageInfo();
     m_cleaner.push([=](){ compShader->cleanup(); });
 }
@@ -24,23 +31,50 @@ void ComputeHDR::setupShader() {
 void ComputeHDR::cleanInputOutput() { m_pOutputImage->cleanup(); m_pInputBuffer->cleanup(); }
 void ComputeHDR::setupInputOutput(std::string hdrPath) {
     LOG("ComputeHDR::setupInputOutput");
+    size_t fileSize = 0;
+    const unsigned char* pFile = RGBE::MapFile(hdrPath, &fileSize);
+    CHECK_NULLPTR(pFile, "failed to map hdr file!");
+    RGBE::Info info;
+    bool isParsed = RGBE::LoadInfo(pFile, fileSize, &info);
+    if (!isParsed) RGBE::UnmapFile(pFile, fileSize);
+    CHECK_BOOL(isParsed, "unsupported hdr file!");
+    
+    UInt2D imageSize = { info.width, info.height };
     m_pOutputImage = new Image();
-    m_pOutputImage->setupForHDRTexture(hdrPath);
+    m_pOutputImage->setupForHDRTexture(imageSize);
+    m_pOutputImage->setImageFormat(m_outputFormat);
+    // Only mip 0 is written and copied out, the chain is built on the output
+    m_pOutputImage->setMipLevels(1);
+    m_pOutputImage->setTransient();
     m_pOutputImage->createWithSampler();
     m_pOutputImage->cmdTransitionToStorageW();
     m_cleaner.push([=](){ m_pOutputImage->cleanup(); });
     
-    float* imageData = m_pOutputImage->getRawHDR();
-    UInt2D imageSize = m_pOutputImage->getImageSize();
-    uint channelSize = m_pOutputImage->getRawChannel() * sizeof(float);
-    VkDeviceSize bufferSize = imageSize.width * imageSize.height * channelSize;
-    
+    // Texels stay packed RGBE, hdr.glsl expands them to float
+    VkDeviceSize bufferSize = VkDeviceSize(imageSize.width) * imageSize.height * 4;
     m_pInputBuffer = new Buffer();
-    m_pInputBuffer->setup(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    m_pInputBuffer->setup(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, MEMORY_UPLOAD);
     m_pInputBuffer->create();
-    m_pInputBuffer->fillBufferFull(imageData);
     m_cleaner.push([=](){ m_pInputBuffer->cleanup(); });
     
+    // Scanlines are indexed, so bands of rows decode in parallel straight into the buffer
+    unsigned char* pDst = static_cast<unsigned char*>(m_pInputBuffer->mapMemory(bufferSize));
+    ThreadPool* pThreadPool = System::ThreadPool();
+    uint bandCount = std::max(pThreadPool->getThreadCount(), 1u);
+    uint bandSize  = (info.height + bandCount - 1) / bandCount;
+    VECTOR<std::future<bool>> decodes;
+    for (uint y = 0; y < info.height; y += bandSize) {
+        uint count = std::min(bandSize, info.height - y);
+        decodes.push_back(pThreadPool->submit([=, &info](){
+            return RGBE::DecodeScanlines(pFile, fileSize, info, y, count, pDst);
+        }));
+    }
+    bool isDecoded = true;
+    for (std::future<bool>& decode : decodes) isDecoded &= decode.get();
+    m_pInputBuffer->flush();
+    RGBE::UnmapFile(pFile, fileSize);
+    CHECK_BOOL(isDecoded, "failed to decode hdr file!");
+    
     m_pDescriptor->setupPointerBuffer(S0, B0, m_pInputBuffer->getDescriptorInfo());
     m_pDescriptor->setupPointerImage(S0, B1, m_pOutputImage->getDescriptorInfo());
     m_pDescriptor->update(S0);
@@ -58,7 +92,6 @@ void ComputeHDR::createDescriptor() {
                                      VK_SHADER_STAGE_COMPUTE_BIT);
     m_pDescriptor->createLayout(S0);
     
-    m_pDescriptor->createPool();
     m_pDescriptor->allocate(S0);
     m_cleaner.push([=](){ m_pDescriptor->cleanup(); });
 }
@@ -93,7 +126,7 @@ void ComputeHDR::createPipeline() {
     m_pPipeline = new Pipeline();
     m_pPipeline->setPipelineLayout(pipelineLayout);
     m_pPipeline->setShaderStages({shaderStage});
-    m_pPipeline->createComputePipeline();
+    m_pPipeline->buildComputePipeline();
     m_cleaner.push([=](){ m_pPipeline->cleanup(); });
 }
 
@@ -101,20 +134,47 @@ Image* ComputeHDR::dispatch() {
     UInt2D imageSize = m_pOutputImage->getImageSize();
     Image* imageOutput = new Image();
     imageOutput->setupForHDRTexture(imageSize);
+    imageOutput->setImageFormat(m_outputFormat);
+    imageOutput->setTransient();
     imageOutput->createWithSampler();
     
+    ComputeMipmap* pComputeMipmap = nullptr;
+    if (ComputeMipmap::IsSupported(imageOutput)) {
+        pComputeMipmap = new ComputeMipmap();
+        pComputeMipmap->setup(imageOutput);
+    }
+    
     Commander* pCommander = System::Commander();
     VkCommandBuffer cmdBuffer = pCommander->createCommandBuffer();
     pCommander->beginSingleTimeCommands(cmdBuffer);
     dispatch(cmdBuffer);
     imageOutput->cmdTransitionToTransferDst(cmdBuffer);
     imageOutput->cmdCopyImageToImage(cmdBuffer, m_pOutputImage);
-    imageOutput->cmdGenerateMipmaps(cmdBuffer);
+    if (pComputeMipmap) pComputeMipmap->dispatch(cmdBuffer);
+    else                imageOutput->cmdGenerateMipmaps(cmdBuffer);
     pCommander->endSingleTimeCommands(cmdBuffer);
+    if (pComputeMipmap) pComputeMipmap->cleanup();
     
     return imageOutput;
 }
 
+// A BC6H .ktx2 next to the hdr skips the conversion and mip generation entirely
+// Only the cubemap precompute loads through here, so the result is transient too
+Image* ComputeHDR::load(std::string hdrPath) {
+    LOG("ComputeHDR::load");
+    Image* pImage = new Image();
+    if (pImage->setupForCompressed(hdrPath, true)) {
+        pImage->setTransient();
+        pImage->createWithSampler();
+        pImage->cmdCopyRawDataToImage();
+        return pImage;
+    }
+    setupInputOutput(hdrPath);
+    pImage = dispatch();
+    cleanInputOutput();
+    return pImage;
+}
+
 void ComputeHDR::dispatch(VkCommandBuffer cmdBuffer) {
     LOG("ComputeHDR::dispatch");
     VkPipelineLayout pipelineLayout = m_pipelineLayout;
@@ -22,7 +22,9 @@ public:
     void cleanup();
     void dispatch(VkCommandBuffer cmdBuffer);
     Image* dispatch();
+    Image* load(std::string hdrPath);
     
+    void setOutputFormat(VkFormat format);
     void setupShader();
     void setupInputOutput(std::string hdrPath);
     void cleanInputOutput();
@@ -44,6 +46,7 @@ private:
     Buffer* m_pInputBuffer;
     
     PCMisc m_misc;
+    VkFormat m_outputFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
     
     uint m_textureIdx = 2;
     
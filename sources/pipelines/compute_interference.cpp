@@ -45,7 +45,6 @@ void ComputeInterference::createDescriptor() {
     m_pDescriptor->addLayoutBindings(S0, B0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
                                      VK_SHADER_STAGE_COMPUTE_BIT);
     m_pDescriptor->createLayout(S0);
-    m_pDescriptor->createPool();
 
     m_pDescriptor->allocate(S0);
     m_cleaner.push([=](){ m_pDescriptor->cleanup(); });
@@ -111,10 +110,18 @@ void ComputeInterference::dispatch(VkCommandBuffer cmdBuffer) {
     m_pOutputImage->cmdTransitionToTransferSrc(cmdBuffer);
 }
 
+// The fluid step may read the copy on the async compute queue, so it is shared
+// with that family instead of being handed over with ownership barriers
 Image* ComputeInterference::copyOutputImage() {
+    Device* pDevice = System::Device();
+    VECTOR<uint32_t> queueFamilies = { pDevice->getGraphicQueueIndex() };
+    if (pDevice->hasComputeQueue() && pDevice->getComputeQueueIndex() != queueFamilies[0])
+        queueFamilies.push_back(pDevice->getComputeQueueIndex());
+    
     UInt2D imageSize = m_pOutputImage->getImageSize();
     Image* imageCopy = new Image();
     imageCopy->setupForStorage(imageSize);
+    imageCopy->setQueueFamilies(queueFamilies);
     imageCopy->createWithSampler();
     
     Commander* pCommander = System::Commander();
@@ -0,0 +1,213 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#include "compute_mipmap.hpp"
+
+#include "../system.hpp"
+#include "../resources/shader.hpp"
+
+#define TILE_SIZE 64
+
+ComputeMipmap::~ComputeMipmap() {}
+ComputeMipmap::ComputeMipmap() : m_pDevice(System::Device()) {}
+
+void ComputeMipmap::cleanup() { m_cleaner.flush("ComputeMipmap"); }
+
+void ComputeMipmap::setup(Image* pImage) {
+    LOG("ComputeMipmap::setup");
+    CHECK_BOOL(IsSupported(pImage), "image not supported by the mipmap compute shader!");
+    m_pImage = pImage;
+    setupShader();
+    createDescriptor();
+    createPipelineLayout();
+    createPipeline();
+    setupInput();
+}
+
+void ComputeMipmap::setupShader() {
+    LOG("ComputeMipmap::setupShader");
+    STRING shaderName = GetShaderName(m_pImage->getImageInfo().format);
+    Shader* compShader = new Shader(SPIRV_PATH + shaderName, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_shaderStage = compShader->getShaderStageInfo();
+    m_cleaner.push([=](){ compShader->cleanup(); });
+}
+
+// One single level view per mip, unused array slots repeat the last level
+void ComputeMipmap::setupInput() {
+    LOG("ComputeMipmap::setupInput");
+    VkDevice          device    = m_pDevice->getDevice();
+    VkImageCreateInfo imageInfo = m_pImage->getImageInfo();
+    
+    VkImageViewCreateInfo viewInfo = m_pImage->getImageViewInfo();
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    viewInfo.format   = GetStorageFormat(imageInfo.format);
+    viewInfo.subresourceRange.levelCount     = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount     = imageInfo.arrayLayers;
+    
+    m_storageViews.resize(imageInfo.mipLevels);
+    for (uint i = 0; i < imageInfo.mipLevels; i++) {
+        viewInfo.subresourceRange.baseMipLevel = i;
+        VkResult result = vkCreateImageView(device, &viewInfo, nullptr, &m_storageViews[i]);
+        CHECK_VKRESULT(result, "failed to create mipmap storage view!");
+    }
+    m_cleaner.push([=](){ for (VkImageView view : m_storageViews) vkDestroyImageView(device, view, nullptr); });
+    
+    m_storageInfos.resize(MAX_MIPS);
+    for (uint i = 0; i < MAX_MIPS; i++) {
+        m_storageInfos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        m_storageInfos[i].imageView   = m_storageViews[std::min(i, imageInfo.mipLevels - 1)];
+        m_storageInfos[i].sampler     = VK_NULL_HANDLE;
+    }
+    
+    m_pCounterBuffer = new Buffer();
+    m_pCounterBuffer->setup(imageInfo.arrayLayers * sizeof(uint32_t),
+                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, MEMORY_GPU_ONLY);
+    m_pCounterBuffer->create();
+    m_cleaner.push([=](){ m_pCounterBuffer->cleanup(); });
+    
+    m_pDescriptor->setupPointerBuffer(S0, B0, m_pCounterBuffer->getDescriptorInfo());
+    m_pDescriptor->setupPointerImage(S0, B1, m_storageInfos.data());
+    m_pDescriptor->update(S0);
+    
+    m_misc.size     = { imageInfo.extent.width, imageInfo.extent.height };
+    m_misc.mipCount = imageInfo.mipLevels;
+    m_misc.isSRGB   = imageInfo.format == VK_FORMAT_R8G8B8A8_SRGB;
+}
+
+void ComputeMipmap::createDescriptor() {
+    LOG("ComputeMipmap::createDescriptor");
+    m_pDescriptor = new Descriptor();
+    m_pDescriptor->setupLayout(S0);
+    m_pDescriptor->addLayoutBindings(S0, B0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                     VK_SHADER_STAGE_COMPUTE_BIT);
+    m_pDescriptor->addLayoutBindings(S0, B1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                                     VK_SHADER_STAGE_COMPUTE_BIT, MAX_MIPS);
+    m_pDescriptor->createLayout(S0);
+    
+    m_pDescriptor->allocate(S0);
+    m_cleaner.push([=](){ m_pDescriptor->cleanup(); });
+}
+
+void ComputeMipmap::createPipelineLayout() {
+    LOG("ComputeMipmap::createPipelineLayout");
+    VkDevice device = m_pDevice->getDevice();
+    VkDescriptorSetLayout descSetLayout = m_pDescriptor->getDescriptorLayout(S0);
+    
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.size = sizeof(PCMisc);
+    pushConstantRange.offset = 0;
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts    = &descSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges    = &pushConstantRange;
+    
+    VkResult result = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout);
+    CHECK_VKRESULT(result, "failed to create pipeline layout!");
+    m_cleaner.push([=](){ vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr); });
+}
+
+void ComputeMipmap::createPipeline() {
+    LOG("ComputeMipmap::createPipeline");
+    VkPipelineLayout pipelineLayout = m_pipelineLayout;
+    VkPipelineShaderStageCreateInfo shaderStage = m_shaderStage;
+    
+    m_pPipeline = new Pipeline();
+    m_pPipeline->setPipelineLayout(pipelineLayout);
+    m_pPipeline->setShaderStages({shaderStage});
+    m_pPipeline->createComputePipeline();
+    m_cleaner.push([=](){ m_pPipeline->cleanup(); });
+}
+
+void ComputeMipmap::dispatch(VkCommandBuffer cmdBuffer) {
+    LOG("ComputeMipmap::dispatch");
+    VkPipelineLayout pipelineLayout = m_pipelineLayout;
+    VkPipeline       pipeline = m_pPipeline->get();
+    VkDescriptorSet  descSet  = m_pDescriptor->getDescriptorSet(S0);
+    VkBuffer         counter  = m_pCounterBuffer->get();
+    VkImageCreateInfo imageInfo = m_pImage->getImageInfo();
+    PCMisc           misc     = m_misc;
+    
+    VkImageMemoryBarrier imageBarrier{};
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image         = m_pImage->getImage();
+    imageBarrier.oldLayout     = m_pImage->getImageLayout();
+    imageBarrier.newLayout     = VK_IMAGE_LAYOUT_GENERAL;
+    imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, imageInfo.mipLevels, 0, imageInfo.arrayLayers };
+    m_pImage->setImageLayout(VK_IMAGE_LAYOUT_GENERAL);
+    
+    vkCmdFillBuffer(cmdBuffer, counter, 0, VK_WHOLE_SIZE, 0);
+    VkBufferMemoryBarrier bufferBarrier{};
+    bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.buffer        = counter;
+    bufferBarrier.size          = VK_WHOLE_SIZE;
+    bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    
+    vkCmdPipelineBarrier(cmdBuffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                         0, nullptr,
+                         1, &bufferBarrier,
+                         1, &imageBarrier);
+    
+    vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,
+                       0, sizeof(PCMisc), &misc);
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            pipelineLayout, 0, 1, &descSet, 0, nullptr);
+    
+    vkCmdDispatch(cmdBuffer,
+                  (misc.size.width  + TILE_SIZE - 1) / TILE_SIZE,
+                  (misc.size.height + TILE_SIZE - 1) / TILE_SIZE,
+                  imageInfo.arrayLayers);
+    
+    // Later passes sample the chain or copy it out
+    imageBarrier.oldLayout     = VK_IMAGE_LAYOUT_GENERAL;
+    imageBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuffer,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, nullptr,
+                         0, nullptr,
+                         1, &imageBarrier);
+}
+
+// Level 0 is reduced by at most two 64x64 tile passes, which covers 4096 texels
+bool ComputeMipmap::IsSupported(Image* pImage) {
+    VkImageCreateInfo imageInfo = pImage->getImageInfo();
+    bool hasStorage = imageInfo.usage & VK_IMAGE_USAGE_STORAGE_BIT;
+    bool isMutable  = imageInfo.format != VK_FORMAT_R8G8B8A8_SRGB ||
+                      imageInfo.flags & VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT;
+    return hasStorage && isMutable && imageInfo.mipLevels <= MAX_MIPS &&
+           !GetShaderName(imageInfo.format).empty();
+}
+
+
+// Private ==================================================
+
+STRING ComputeMipmap::GetShaderName(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_R8G8B8A8_SRGB      : return "mipmap_rgba8.comp.spv"; break;
+        case VK_FORMAT_R8G8B8A8_UNORM     : return "mipmap_rgba8.comp.spv"; break;
+        case VK_FORMAT_R16G16B16A16_SFLOAT: return "mipmap_rgba16f.comp.spv"; break;
+        case VK_FORMAT_R32G32B32A32_SFLOAT: return "mipmap_rgba32f.comp.spv"; break;
+        default: return ""; break;
+    }
+}
+
+// sRGB formats can't be storage images, the shader encodes through a UNORM view
+VkFormat ComputeMipmap::GetStorageFormat(VkFormat format) {
+    return format == VK_FORMAT_R8G8B8A8_SRGB ? VK_FORMAT_R8G8B8A8_UNORM : format;
+}
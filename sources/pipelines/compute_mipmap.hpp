@@ -0,0 +1,59 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#pragma once
+
+#include "../include.h"
+#include "../renderer/pipeline.hpp"
+#include "../renderer/descriptor.hpp"
+#include "../resources/image.hpp"
+#include "../resources/buffer.hpp"
+
+// Builds a whole mip chain from level 0 in one dispatch, replacing the blit
+// chain of Image::cmdGenerateMipmaps. Level 0 must be in TRANSFER_DST, every
+// level is left in GENERAL.
+class ComputeMipmap {
+    
+    struct PCMisc {
+        UInt2D size;
+        uint mipCount;
+        uint isSRGB;
+    };
+    
+public:
+    ~ComputeMipmap();
+    ComputeMipmap();
+    
+    void cleanup();
+    void setup(Image* pImage);
+    void dispatch(VkCommandBuffer cmdBuffer);
+    
+    void setupShader();
+    void setupInput();
+    
+    void createDescriptor();
+    void createPipelineLayout();
+    void createPipeline();
+    
+    static bool IsSupported(Image* pImage);
+    static const uint MAX_MIPS = 13;
+    
+private:
+    Cleaner m_cleaner;
+    Device* m_pDevice;
+    Pipeline* m_pPipeline;
+    Descriptor* m_pDescriptor;
+    
+    Image*  m_pImage;
+    Buffer* m_pCounterBuffer;
+    VECTOR<VkImageView> m_storageViews;
+    VECTOR<VkDescriptorImageInfo> m_storageInfos;
+    
+    PCMisc m_misc;
+    
+    VkPipelineLayout m_pipelineLayout;
+    VkPipelineShaderStageCreateInfo m_shaderStage;
+    
+    static STRING   GetShaderName  (VkFormat format);
+    static VkFormat GetStorageFormat(VkFormat format);
+};
@@ -111,7 +111,6 @@ void GraphicsEquirect::createDescriptor() {
     m_pDescriptor->addLayoutBindings(S0, B0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                                      VK_SHADER_STAGE_FRAGMENT_BIT);
     m_pDescriptor->createLayout(S0);
-    m_pDescriptor->createPool();
     m_pDescriptor->allocate(S0);
     m_cleaner.push([=](){ m_pDescriptor->cleanup(); });
 }
@@ -169,7 +168,7 @@ void GraphicsEquirect::createPipeline() {
     
     m_pPipeline->setupDynamicInfo();
 
-    m_pPipeline->createGraphicsPipeline();
+    m_pPipeline->buildGraphicsPipeline();
     m_cleaner.push([=](){ m_pPipeline->cleanup(); });
 }
 
@@ -0,0 +1,159 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#include "graphics_fetch.hpp"
+
+#include "../system.hpp"
+#include "../resources/shader.hpp"
+
+GraphicsFetch::~GraphicsFetch() {}
+GraphicsFetch::GraphicsFetch() : m_pDevice(System::Device()) {}
+
+void GraphicsFetch::cleanup() { m_cleaner.flush("GraphicsFetch"); }
+
+// Five textures take the unpacked shader, three the packed one
+void GraphicsFetch::setup(VECTOR<Image*> textures, UInt2D size) {
+    LOG("GraphicsFetch::setup");
+    CHECK_BOOL((textures.size() == 5 || textures.size() == 3), "fetch pass takes 5 or 3 textures!");
+    m_textures = textures;
+    setupShader();
+    createDescriptor();
+    createRenderpass();
+    createPipelineLayout();
+    createPipeline();
+    createFrame(size);
+    setupInput();
+}
+
+void GraphicsFetch::render(VkCommandBuffer cmdBuffer) {
+    VkPipelineLayout pipelineLayout = m_pipelineLayout;
+    VkPipeline       pipeline       = m_pPipeline->get();
+    VkRenderPass     renderpass     = m_pRenderpass->get();
+    VkFramebuffer    framebuffer    = m_pFrame->getFramebuffer();
+    VkRect2D         scissor        = m_scissor;
+    VkViewport       viewport       = m_viewport;
+    VkDescriptorSet  descSet        = m_pDescriptor->getDescriptorSet(S0);
+    
+    VkClearValue clearValue{ VEC4_BLACK };
+    
+    VkRenderPassBeginInfo renderBeginInfo{};
+    renderBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderBeginInfo.clearValueCount = 1;
+    renderBeginInfo.pClearValues    = &clearValue;
+    renderBeginInfo.renderPass      = renderpass;
+    renderBeginInfo.framebuffer     = framebuffer;
+    renderBeginInfo.renderArea      = scissor;
+    
+    vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+    
+    vkCmdBeginRenderPass(cmdBuffer, &renderBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipelineLayout, S0, 1, &descSet, 0, nullptr);
+    vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
+    vkCmdEndRenderPass(cmdBuffer);
+}
+
+void GraphicsFetch::setupShader() {
+    LOG("GraphicsFetch::setupShader");
+    STRING fragName = m_textures.size() == 5 ? "fetch_unpacked.frag.spv" : "fetch_packed.frag.spv";
+    Shader* vertShader = new Shader(SPIRV_PATH + "fetch.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+    Shader* fragShader = new Shader(SPIRV_PATH + fragName, VK_SHADER_STAGE_FRAGMENT_BIT);
+    m_shaderStages = { vertShader->getShaderStageInfo(), fragShader->getShaderStageInfo() };
+    m_cleaner.push([=](){ vertShader->cleanup(); fragShader->cleanup(); });
+}
+
+void GraphicsFetch::setupInput() {
+    LOG("GraphicsFetch::setupInput");
+    for (uint i = 0; i < m_textures.size(); i++)
+        m_pDescriptor->setupPointerImage(S0, B0 + i, m_textures[i]->getDescriptorInfo());
+    m_pDescriptor->update(S0);
+}
+
+void GraphicsFetch::createDescriptor() {
+    LOG("GraphicsFetch::createDescriptor");
+    m_pDescriptor = new Descriptor();
+    m_pDescriptor->setupLayout(S0);
+    for (uint i = 0; i < m_textures.size(); i++) {
+        m_pDescriptor->addLayoutBindings(S0, B0 + i, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                         VK_SHADER_STAGE_FRAGMENT_BIT);
+    }
+    m_pDescriptor->createLayout(S0);
+    m_pDescriptor->allocate(S0);
+    m_cleaner.push([=](){ m_pDescriptor->cleanup(); });
+}
+
+void GraphicsFetch::createRenderpass() {
+    m_pRenderpass = new Renderpass();
+    m_pRenderpass->setupColorAttachment(VK_FORMAT_R8G8B8A8_UNORM);
+    m_pRenderpass->setup();
+    m_pRenderpass->create();
+    m_cleaner.push([=](){ m_pRenderpass->cleanup(); });
+}
+
+void GraphicsFetch::createPipelineLayout() {
+    LOG("GraphicsFetch::createPipelineLayout");
+    VkDevice device = m_pDevice->getDevice();
+    VkDescriptorSetLayout descSetLayout = m_pDescriptor->getDescriptorLayout(S0);
+    
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts    = &descSetLayout;
+    
+    VkResult result = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout);
+    CHECK_VKRESULT(result, "failed to create pipeline layout!");
+    m_cleaner.push([=](){ vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr); });
+}
+
+void GraphicsFetch::createPipeline() {
+    LOG("GraphicsFetch::createPipeline");
+    VkRenderPass renderpass = m_pRenderpass->get();
+    VkPipelineLayout pipelineLayout = m_pipelineLayout;
+    VECTOR<VkPipelineShaderStageCreateInfo> shaderStages = m_shaderStages;
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+    
+    m_pPipeline = new Pipeline();
+    m_pPipeline->setRenderpass(renderpass);
+    m_pPipeline->setPipelineLayout(pipelineLayout);
+    m_pPipeline->setShaderStages(shaderStages);
+    m_pPipeline->setVertexInputInfo(vertexInputInfo);
+    
+    m_pPipeline->setupViewportInfo();
+    m_pPipeline->setupInputAssemblyInfo();
+    m_pPipeline->setupRasterizationInfo();
+    m_pPipeline->setupMultisampleInfo();
+    
+    m_pPipeline->setupBlendAttachment(VK_FALSE);
+    m_pPipeline->setupColorBlendInfo();
+    
+    m_pPipeline->setupDynamicInfo();
+    
+    m_pPipeline->createGraphicsPipeline();
+    m_cleaner.push([=](){ m_pPipeline->cleanup(); });
+}
+
+void GraphicsFetch::createFrame(UInt2D size) {
+    LOG("GraphicsFetch::createFrame");
+    m_pFrame = new Frame(size);
+    m_pFrame->createImageResource();
+    m_pFrame->createFramebuffer(m_pRenderpass);
+    m_cleaner.push([=](){ m_pFrame->cleanup(); });
+    updateViewportScissor();
+}
+
+
+// Private ==================================================
+
+void GraphicsFetch::updateViewportScissor() {
+    UInt2D extent = m_pFrame->getSize();
+    m_viewport.x = 0.f;
+    m_viewport.y = 0.f;
+    m_viewport.width  = extent.width;
+    m_viewport.height = extent.height;
+    m_viewport.minDepth = 0.f;
+    m_viewport.maxDepth = 1.f;
+    m_scissor.offset = {0, 0};
+    m_scissor.extent = extent;
+}
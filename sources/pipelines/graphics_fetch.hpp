@@ -0,0 +1,51 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#pragma once
+
+#include "../include.h"
+#include "../renderer/pipeline.hpp"
+#include "../renderer/renderpass.hpp"
+#include "../renderer/descriptor.hpp"
+#include "../resources/frame.hpp"
+#include "../resources/image.hpp"
+
+// Full screen pass doing only the material fetches of main1d.frag, with either
+// the five separate maps or albedo, normal and ORM. Used by Benchmark::runMaterial.
+class GraphicsFetch {
+    
+public:
+    ~GraphicsFetch();
+    GraphicsFetch();
+    
+    void cleanup();
+    void setup(VECTOR<Image*> textures, UInt2D size);
+    void render(VkCommandBuffer cmdBuffer);
+    
+    void setupShader();
+    void setupInput();
+    
+    void createDescriptor();
+    void createRenderpass();
+    void createPipelineLayout();
+    void createPipeline();
+    void createFrame(UInt2D size);
+    
+private:
+    Cleaner m_cleaner;
+    Device* m_pDevice;
+    Pipeline* m_pPipeline;
+    Renderpass* m_pRenderpass;
+    Descriptor* m_pDescriptor;
+    
+    Frame* m_pFrame;
+    VECTOR<Image*> m_textures;
+    
+    VkViewport m_viewport{};
+    VkRect2D   m_scissor{};
+    
+    VkPipelineLayout m_pipelineLayout;
+    VECTOR<VkPipelineShaderStageCreateInfo> m_shaderStages;
+    
+    void updateViewportScissor();
+};
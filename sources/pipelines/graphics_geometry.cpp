@@ -0,0 +1,135 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#include "graphics_geometry.hpp"
+
+#include "../system.hpp"
+#include "../resources/shader.hpp"
+
+GraphicsGeometry::~GraphicsGeometry() {}
+GraphicsGeometry::GraphicsGeometry() : m_pDevice(System::Device()) {}
+
+void GraphicsGeometry::cleanup() { m_cleaner.flush("GraphicsGeometry"); }
+
+// The mesh keeps its buffers, only the vertex layout is read here
+void GraphicsGeometry::setup(Mesh* pMesh, UInt2D size) {
+    LOG("GraphicsGeometry::setup");
+    m_pMesh = pMesh;
+    setupShader();
+    createRenderpass();
+    createPipelineLayout();
+    createPipeline();
+    createFrame(size);
+}
+
+void GraphicsGeometry::render(VkCommandBuffer cmdBuffer, uint instanceCount) {
+    VkPipeline    pipeline     = m_pPipeline->get();
+    VkRenderPass  renderpass   = m_pRenderpass->get();
+    VkFramebuffer framebuffer  = m_pFrame->getFramebuffer();
+    VkRect2D      scissor      = m_scissor;
+    VkViewport    viewport     = m_viewport;
+    
+    VkDeviceSize offsets      = 0;
+    VkBuffer     vertexBuffer = m_pMesh->getVertexBuffer()->get();
+    VkBuffer     indexBuffer  = m_pMesh->getIndexBuffer()->get();
+    uint32_t     indexSize    = m_pMesh->getIndexSize();
+    
+    VkClearValue clearValue{ VEC4_BLACK };
+    
+    VkRenderPassBeginInfo renderBeginInfo{};
+    renderBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderBeginInfo.clearValueCount = 1;
+    renderBeginInfo.pClearValues    = &clearValue;
+    renderBeginInfo.renderPass      = renderpass;
+    renderBeginInfo.framebuffer     = framebuffer;
+    renderBeginInfo.renderArea      = scissor;
+    
+    vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+    
+    vkCmdBeginRenderPass(cmdBuffer, &renderBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vertexBuffer, &offsets);
+    vkCmdBindIndexBuffer(cmdBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    vkCmdDrawIndexed(cmdBuffer, indexSize, instanceCount, 0, 0, 0);
+    vkCmdEndRenderPass(cmdBuffer);
+}
+
+void GraphicsGeometry::setupShader() {
+    LOG("GraphicsGeometry::setupShader");
+    Shader* vertShader = new Shader(SPIRV_PATH + "geometry.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+    Shader* fragShader = new Shader(SPIRV_PATH + "geometry.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+    m_shaderStages = { vertShader->getShaderStageInfo(), fragShader->getShaderStageInfo() };
+    m_cleaner.push([=](){ vertShader->cleanup(); fragShader->cleanup(); });
+}
+
+void GraphicsGeometry::createRenderpass() {
+    m_pRenderpass = new Renderpass();
+    m_pRenderpass->setupColorAttachment(VK_FORMAT_R8G8B8A8_UNORM);
+    m_pRenderpass->setup();
+    m_pRenderpass->create();
+    m_cleaner.push([=](){ m_pRenderpass->cleanup(); });
+}
+
+void GraphicsGeometry::createPipelineLayout() {
+    LOG("GraphicsGeometry::createPipelineLayout");
+    VkDevice device = m_pDevice->getDevice();
+    
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    
+    VkResult result = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout);
+    CHECK_VKRESULT(result, "failed to create pipeline layout!");
+    m_cleaner.push([=](){ vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr); });
+}
+
+void GraphicsGeometry::createPipeline() {
+    LOG("GraphicsGeometry::createPipeline");
+    VkRenderPass renderpass = m_pRenderpass->get();
+    VkPipelineLayout pipelineLayout = m_pipelineLayout;
+    VECTOR<VkPipelineShaderStageCreateInfo> shaderStages = m_shaderStages;
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = m_pMesh->getVertexStateInfo();
+    
+    m_pPipeline = new Pipeline();
+    m_pPipeline->setRenderpass(renderpass);
+    m_pPipeline->setPipelineLayout(pipelineLayout);
+    m_pPipeline->setShaderStages(shaderStages);
+    m_pPipeline->setVertexInputInfo(vertexInputInfo);
+    
+    m_pPipeline->setupViewportInfo();
+    m_pPipeline->setupInputAssemblyInfo();
+    m_pPipeline->setupRasterizationInfo();
+    m_pPipeline->setupMultisampleInfo();
+    
+    m_pPipeline->setupBlendAttachment(VK_FALSE);
+    m_pPipeline->setupColorBlendInfo();
+    
+    m_pPipeline->setupDynamicInfo();
+    
+    m_pPipeline->createGraphicsPipeline();
+    m_cleaner.push([=](){ m_pPipeline->cleanup(); });
+}
+
+void GraphicsGeometry::createFrame(UInt2D size) {
+    LOG("GraphicsGeometry::createFrame");
+    m_pFrame = new Frame(size);
+    m_pFrame->createImageResource();
+    m_pFrame->createFramebuffer(m_pRenderpass);
+    m_cleaner.push([=](){ m_pFrame->cleanup(); });
+    updateViewportScissor();
+}
+
+
+// Private ==================================================
+
+void GraphicsGeometry::updateViewportScissor() {
+    UInt2D extent = m_pFrame->getSize();
+    m_viewport.x = 0.f;
+    m_viewport.y = 0.f;
+    m_viewport.width  = extent.width;
+    m_viewport.height = extent.height;
+    m_viewport.minDepth = 0.f;
+    m_viewport.maxDepth = 1.f;
+    m_scissor.offset = {0, 0};
+    m_scissor.extent = extent;
+}
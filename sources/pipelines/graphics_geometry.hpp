@@ -0,0 +1,47 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#pragma once
+
+#include "../include.h"
+#include "../renderer/pipeline.hpp"
+#include "../renderer/renderpass.hpp"
+#include "../resources/frame.hpp"
+#include "../resources/mesh.hpp"
+
+// Draws instances of a mesh with the vertex layout of main1d.vert and a flat
+// fragment shader, so the GPU time follows vertex fetch. Used by Benchmark::runGeometry.
+class GraphicsGeometry {
+    
+public:
+    ~GraphicsGeometry();
+    GraphicsGeometry();
+    
+    void cleanup();
+    void setup(Mesh* pMesh, UInt2D size);
+    void render(VkCommandBuffer cmdBuffer, uint instanceCount);
+    
+    void setupShader();
+    
+    void createRenderpass();
+    void createPipelineLayout();
+    void createPipeline();
+    void createFrame(UInt2D size);
+    
+private:
+    Cleaner m_cleaner;
+    Device* m_pDevice;
+    Pipeline* m_pPipeline;
+    Renderpass* m_pRenderpass;
+    
+    Frame* m_pFrame;
+    Mesh*  m_pMesh;
+    
+    VkViewport m_viewport{};
+    VkRect2D   m_scissor{};
+    
+    VkPipelineLayout m_pipelineLayout;
+    VECTOR<VkPipelineShaderStageCreateInfo> m_shaderStages;
+    
+    void updateViewportScissor();
+};
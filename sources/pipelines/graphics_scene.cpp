@@ -14,54 +14,36 @@ void GraphicsScene::cleanup() { m_cleaner.flush("GraphicsScene"); }
 void GraphicsScene::render(VkCommandBuffer cmdBuffer) {
     Settings* settings = System::Settings();
     VkPipelineLayout pipelineLayout  = m_pipelineLayout;
-    VkPipeline       meshPipeline    = m_pMeshPipeline->get();
+    VkPipeline       meshPipeline    = m_pMeshPipelines[GetPermutation()]->get();
+    VkPipeline       lightPipeline   = m_pLightPipeline->get();
     VkPipeline       cubemapPipeline = m_pCubemapPipeline->get();
-    VkRenderPass     renderpass      = m_pRenderpass->get();
-    VkFramebuffer    framebuffer     = m_pFrame->getFramebuffer();
-    VkRect2D         scissor         = m_scissor;
-    VkViewport       viewport        = m_viewport;
     Mesh *mesh = m_pMesh[settings->Shapes];
     
     VkDeviceSize offsets  = 0;
-    VkBuffer meshVertexBuffer = mesh->getVertexBuffer()->get();
-    VkBuffer meshIndexBuffer  = mesh->getIndexBuffer()->get();
     uint32_t meshIndexSize    = mesh->getIndexSize();
     VkBuffer cubeVertexBuffer = m_pCube->getVertexBuffer()->get();
     VkBuffer cubeIndexBuffer  = m_pCube->getIndexBuffer()->get();
     uint32_t cubeIndexSize    = m_pCube->getIndexSize();
     
     
-    VkDescriptorSet cameraDescSet  = m_pDescriptor->getDescriptorSet(S0);
-    VkDescriptorSet miscDescSet = m_pDescriptor->getDescriptorSet(S1);
-    VkDescriptorSet textureDescSet = m_pDescriptor->getDescriptorSet(S2);
-    VkDescriptorSet heightmapDescSet = m_pDescriptor->getDescriptorSet(S3);
-    VkDescriptorSet interferenceDescSet = m_pDescriptor->getDescriptorSet(S4);
-    VkDescriptorSet cubemapDescSet = m_pDescriptor->getDescriptorSet(S5);
-    
-    std::array<VkClearValue, 2> clearValues{};
-    clearValues[0].color = System::Settings()->ClearColor;
-    clearValues[1].depthStencil = System::Settings()->ClearDepth;
+    // The frame's last submit has completed, so its ring slot is free to write
+    UniformRing* pUniformRing = System::UniformRing();
+    m_cameraOffset   = pUniformRing->push(m_camera);
+    m_miscOffsets[0] = pUniformRing->push(m_lights);
+    m_miscOffsets[1] = pUniformRing->push(m_param);
     
-    VkRenderPassBeginInfo renderBeginInfo{};
-    renderBeginInfo.sType       = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderBeginInfo.clearValueCount = UINT32(clearValues.size());
-    renderBeginInfo.pClearValues    = clearValues.data();
-    renderBeginInfo.renderPass      = renderpass;
-    renderBeginInfo.framebuffer     = framebuffer;
-    renderBeginInfo.renderArea      = scissor;
+    VkDescriptorSet cameraDescSet  = m_pDescriptor->getDescriptorSet(S0);
+    VkDescriptorSet cubemapDescSet = m_pDescriptor->getDescriptorSets(S5)[m_cubemapSet.idx];
     
     Buffer* pMarkBuffer = m_pMarkBuffer;
     pMarkBuffer->cmdClearBuffer(cmdBuffer, 0.5);
     
-    vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
-    vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
-    
-    vkCmdBeginRenderPass(cmdBuffer, &renderBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    beginRenderpass(cmdBuffer);
     
     vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, cubemapPipeline);
     
     vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                            pipelineLayout, S0, 1, &cameraDescSet, 0, nullptr);
+                            pipelineLayout, S0, 1, &cameraDescSet, 1, &m_cameraOffset);
     vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
                             pipelineLayout, S5, 1, &cubemapDescSet, 0, nullptr);
     
@@ -70,30 +52,10 @@ void GraphicsScene::render(VkCommandBuffer cmdBuffer) {
     
     vkCmdDrawIndexed(cmdBuffer, cubeIndexSize, 1, 0, 0, 0);
     
-    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipeline);
-    
-    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                            pipelineLayout, S0, 1, &cameraDescSet, 0, nullptr);
-    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                            pipelineLayout, S1, 1, &miscDescSet, 0, nullptr);
-    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                            pipelineLayout, S2, 1, &textureDescSet, 0, nullptr);
-    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                            pipelineLayout, S3, 1, &heightmapDescSet, 0, nullptr);
-    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                            pipelineLayout, S4, 1, &interferenceDescSet, 0, nullptr);
-    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                            pipelineLayout, S5, 1, &cubemapDescSet, 0, nullptr);
-    
-    vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &meshVertexBuffer, &offsets);
-    vkCmdBindIndexBuffer  (cmdBuffer, meshIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
-    
-    m_misc.model = mesh->getMatrix();
-    m_misc.isLight = 0;
-    vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PCMisc), &m_misc);
-    
-    vkCmdDrawIndexed(cmdBuffer, meshIndexSize, 1, 0, 0, 0);
+    drawMesh(cmdBuffer, meshPipeline);
     
+    // Same layout, so the sets and buffers bound for the mesh carry over
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, lightPipeline);
     m_misc.isLight = 1;
     for (int i = 0; i < m_lights.total; i++) {
         m_misc.model = glm::translate(glm::mat4(1.0), glm::vec3(m_lights.position[i]));
@@ -106,6 +68,15 @@ void GraphicsScene::render(VkCommandBuffer cmdBuffer) {
     vkCmdEndRenderPass(cmdBuffer);
 }
 
+// The ring slot of the last render is only reused frames in flight later, so
+// between frames its offsets still point at valid constants
+void GraphicsScene::renderPermutation(VkCommandBuffer cmdBuffer, uint permutation) {
+    VkPipeline pipeline = m_pMeshPipelines[permutation]->get();
+    beginRenderpass(cmdBuffer);
+    drawMesh(cmdBuffer, pipeline);
+    vkCmdEndRenderPass(cmdBuffer);
+}
+
 void GraphicsScene::setupShader() {
     LOG("GraphicsScene::setupShader");
     Shader* vertShader = new Shader(SPIRV_PATH + "main1d.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
@@ -120,92 +91,100 @@ void GraphicsScene::setupInput() {
     LOG("GraphicsScene::setupInput");
     m_lights.total = System::Settings()->TotalLight;
     
-    m_pCameraBuffer = new Buffer();
-    m_pCameraBuffer->setup(sizeof(UBCamera), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
-    m_pCameraBuffer->create();
-    m_cleaner.push([=](){ m_pCameraBuffer->cleanup(); });
-    
-    m_pLightBuffer = new Buffer();
-    m_pLightBuffer->setup(sizeof(UBLights), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
-    m_pLightBuffer->create();
-    m_cleaner.push([=](){ m_pLightBuffer->cleanup(); });
-    
-    m_pParamBuffer = new Buffer();
-    m_pParamBuffer->setup(sizeof(UBParam), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
-    m_pParamBuffer->create();
-    m_cleaner.push([=](){ m_pParamBuffer->cleanup(); });
-    
-    m_pDescriptor->setupPointerBuffer(S0, B0, m_pCameraBuffer->getDescriptorInfo());
-    m_pDescriptor->setupPointerBuffer(S1, B0, m_pLightBuffer->getDescriptorInfo());
-    m_pDescriptor->setupPointerBuffer(S1, B1, m_pParamBuffer->getDescriptorInfo());
+    // Constants live in the uniform ring, render picks this frame's copy by offset
+    UniformRing* pUniformRing = System::UniformRing();
+    m_pDescriptor->setupPointerBuffer(S0, B0, pUniformRing->getDescriptorInfo(sizeof(UBCamera)));
+    m_pDescriptor->setupPointerBuffer(S1, B0, pUniformRing->getDescriptorInfo(sizeof(UBLights)));
+    m_pDescriptor->setupPointerBuffer(S1, B1, pUniformRing->getDescriptorInfo(sizeof(UBParam)));
     
     m_pDescriptor->update(S0);
     m_pDescriptor->update(S1);
+}
+
+// Uploads the meshes from LoadMeshes, render picks them by Settings::Shapes
+void GraphicsScene::setupMesh(VECTOR<Mesh*> pMeshes) {
+    LOG("GraphicsScene::setupMesh");
+    for (Mesh* pMesh : pMeshes) {
+        pMesh->createVertexBuffer();
+        pMesh->createIndexBuffer();
+        pMesh->createVertexStateInfo();
+        m_cleaner.push([=](){ pMesh->cleanup(); });
+    }
+    m_pMesh = pMeshes;
+    m_pCube = pMeshes[1];
+}
+
+uint GraphicsScene::GetPermutation() {
+    Settings* settings = System::Settings();
+    uint permutation = 0;
+    if (settings->UseTexture)   permutation |= PERMUTATION_TEXTURE;
+    if (settings->Interference) permutation |= PERMUTATION_INTERFERENCE;
+    if (settings->Interference && settings->UseFluid) permutation |= PERMUTATION_FLUID;
+    return permutation;
+}
+
+STRING GraphicsScene::GetPermutationName(uint permutation) {
+    STRING name = permutation & PERMUTATION_TEXTURE ? "texture" : "plain";
+    if (permutation & PERMUTATION_INTERFERENCE) name += "+interference";
+    if (permutation & PERMUTATION_FLUID)        name += "+fluid";
+    return name;
+}
+
+// CPU only so it can run on a worker: sphere, cube and bunny in Shapes order
+VECTOR<Mesh*> GraphicsScene::LoadMeshes() {
+    LOG("GraphicsScene::LoadMeshes");
+    Mesh* sphere = new Mesh();
+    sphere->createSphere(200, 200);
     
     Mesh* cube = new Mesh();
     cube->createCube();
-    cube->createVertexBuffer();
-    cube->createIndexBuffer();
-    cube->createVertexStateInfo();
-    m_cleaner.push([=](){ cube->cleanup(); });
-    
-    Mesh* sphere = new Mesh();
-    sphere->createSphere(200, 200);
-    sphere->createVertexBuffer();
-    sphere->createIndexBuffer();
-    sphere->createVertexStateInfo();
-    m_cleaner.push([=](){ sphere->cleanup(); });
     
     Mesh* model = new Mesh();
     model->loadModel((MODEL_PATH + "bunny/bunny.obj").c_str());
-    model->createVertexBuffer();
-    model->createIndexBuffer();
-    model->createVertexStateInfo();
     model->translate({.2, -.6, 0.});
-    m_cleaner.push([=](){ model->cleanup(); });
-    
-    m_pMesh.push_back(sphere);
-    m_pMesh.push_back(cube);
-    m_pMesh.push_back(model);
-    m_pCube = cube;
+    return { sphere, cube, model };
 }
 
+// Starts packing and decoding on the thread pool, streamTexture binds the result as it arrives
 void GraphicsScene::updateTexture() {
-    System::Device()->waitIdle();
-    VECTOR<STRING> pbrPaths = System::Files()->getTexturePBRPaths();
-    bool hasImage = m_pTextures.size() > 0;
-    m_pTextures.resize(pbrPaths.size());
-    for (uint i = 0; i < pbrPaths.size(); i++) {
-        if (hasImage) m_pTextures[i]->cleanup();
-        m_pTextures[i] = new Image();
-        m_pTextures[i]->setupForTexture(pbrPaths[i]);
-        m_pTextures[i]->createWithSampler();
-        m_pTextures[i]->cmdCopyRawDataToImage();
-        m_pTextures[i]->cmdTransitionToShaderR();
-        m_cleaner.push([=](){ m_pTextures[i]->cleanup(); });
-        m_pDescriptor->setupPointerImage(S2, i, m_pTextures[i]->getDescriptorInfo());
+    LOG("GraphicsScene::updateTexture");
+    if (m_pTextureStreamer->isBusy()) {
+        LOG("GraphicsScene::updateTexture ignored, previous textures still streaming");
+        return;
     }
-    m_pDescriptor->update(S2);
+    Files* pFiles = System::Files();
+    m_pTextureStreamer->load(pFiles->getTexturePBRPaths(), pFiles->packTextureORM());
+}
+
+// Call at a frame boundary. Binds each finer level once the streamer reports it resident.
+void GraphicsScene::streamTexture(bool wait) {
+    TextureStreamer* pTextureStreamer = m_pTextureStreamer;
+    pTextureStreamer->update(wait);
+    
+    VECTOR<Image*> pTextures   = pTextureStreamer->getTextures();
+    uint           residentMip = pTextureStreamer->getResidentMip();
+    bool           isNewBatch  = pTextures != m_textureSet.images;
+    if (residentMip == TextureStreamer::NOT_RESIDENT) return;
+    if (!isNewBatch && residentMip >= m_textureSet.baseMip) return;
+    
+    LOG("GraphicsScene::streamTexture mip " << residentMip);
+    swapTextures(pTextures, residentMip);
 }
 
 void GraphicsScene::updateCubemap(Image* cubemap, Image* envMap, Image* reflMap, Image* brdfMap) {
-    m_pCubemap = cubemap;
-    m_pEnvMap = envMap;
-    m_pReflMap = reflMap;
-    m_pBrdfMap = brdfMap;
-    m_pCubemap->cmdTransitionToShaderR();
-    m_pEnvMap->cmdTransitionToShaderR();
-    m_pReflMap->cmdTransitionToShaderR();
-    m_pBrdfMap->cmdTransitionToShaderR();
-    m_pDescriptor->setupPointerImage(S5, B0, m_pCubemap->getDescriptorInfo());
-    m_pDescriptor->setupPointerImage(S5, B1, m_pEnvMap->getDescriptorInfo());
-    m_pDescriptor->setupPointerImage(S5, B2, m_pReflMap->getDescriptorInfo());
-    m_pDescriptor->setupPointerImage(S5, B3, m_pBrdfMap->getDescriptorInfo());
-    m_pDescriptor->update(S5);
-    m_cleaner.push([=](){ m_pCubemap->cleanup(); });
-    m_cleaner.push([=](){ m_pEnvMap->cleanup(); });
-    m_cleaner.push([=](){ m_pReflMap->cleanup(); });
-    m_cleaner.push([=](){ m_pBrdfMap->cleanup(); });
+    LOG("GraphicsScene::updateCubemap");
+    isSwapSetIdle(m_cubemapSet, true);
+    VECTOR<Image*> cubemaps = { cubemap, envMap, reflMap, brdfMap };
+    for (Image* pImage : cubemaps) {
+        if (pImage->getImageLayout() != VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+            pImage->cmdTransitionToShaderR();
+    }
+    swapImages(S5, m_cubemapSet, cubemaps, 0);
+}
+
+void GraphicsScene::cleanRetired() {
+    isSwapSetIdle(m_textureSet, false);
+    isSwapSetIdle(m_cubemapSet, false);
 }
 
 void GraphicsScene::updateLightInput() {
@@ -221,7 +200,6 @@ void GraphicsScene::updateLightInput() {
         m_lights.position[i].x = sin(m_iteration / 100.f + i * interval) * distance.y;
         m_lights.position[i].y = cos(m_iteration / 100.f + i * interval) * distance.y;
     }
-    m_pLightBuffer->fillBuffer(&m_lights, sizeof(UBLights));
 }
 
 void GraphicsScene::updateParamInput() {
@@ -238,7 +216,6 @@ void GraphicsScene::updateParamInput() {
     m_param.refractiveIndex  = settings->RefractiveIndex;
     m_param.reflectanceValue = settings->ReflectanceValue;
     m_param.opdSample        = settings->OPDSample;
-    m_pParamBuffer->fillBuffer(&m_param, sizeof(UBParam));
 }
 
 void GraphicsScene::updateCameraInput(Camera* pCamera) {
@@ -246,16 +223,16 @@ void GraphicsScene::updateCameraInput(Camera* pCamera) {
     m_misc.viewPosition = pCamera->getPosition();
     m_camera.view = pCamera->getViewMatrix();
     m_camera.proj = pCamera->getProjection((float) size.width / size.height);
-    m_pCameraBuffer->fillBuffer(&m_camera, sizeof(UBCamera));
 }
 
-void GraphicsScene::updateHeightmapInput(Image *pHeightmapImage) {
-    m_pHeightmap = pHeightmapImage;
-    m_pHeightmap->cmdTransitionToShaderR();
-    m_pDescriptor->setupPointerImage(S3, B0, m_pHeightmap->getDescriptorInfo());
+void GraphicsScene::updateHeightmapInput(Image *pHeightmapImage, uint idx) {
+    pHeightmapImage->cmdTransitionToShaderR();
+    m_pDescriptor->setupPointerImage(S3, idx, B0, pHeightmapImage->getDescriptorInfo());
     m_pDescriptor->update(S3);
 }
 
+void GraphicsScene::setHeightmapIdx(uint idx) { m_heightmapIdx = idx; }
+
 void GraphicsScene::updateInterferenceInput(Image* pInterferenceImage) {
     m_pInterference = pInterferenceImage;
     m_pInterference->cmdTransitionToShaderR();
@@ -263,7 +240,8 @@ void GraphicsScene::updateInterferenceInput(Image* pInterferenceImage) {
     
     uint bufferSize = m_pInterference->getImageSize().width * sizeof(float);
     m_pMarkBuffer = new Buffer();
-    m_pMarkBuffer->setup(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    m_pMarkBuffer->setup(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         MEMORY_GPU_ONLY);
     m_pMarkBuffer->create();
     m_pDescriptor->setupPointerBuffer(S4, B1, m_pMarkBuffer->getDescriptorInfo());
     
@@ -274,25 +252,21 @@ void GraphicsScene::createDescriptor() {
     LOG("GraphicsScene::createDescriptor");
     m_pDescriptor = new Descriptor();
     m_pDescriptor->setupLayout(S0);
-    m_pDescriptor->addLayoutBindings(S0, B0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+    m_pDescriptor->addLayoutBindings(S0, B0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
                                      VK_SHADER_STAGE_VERTEX_BIT);
     m_pDescriptor->createLayout(S0);
     
     m_pDescriptor->setupLayout(S1);
-    m_pDescriptor->addLayoutBindings(S1, B0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+    m_pDescriptor->addLayoutBindings(S1, B0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
                                      VK_SHADER_STAGE_FRAGMENT_BIT);
-    m_pDescriptor->addLayoutBindings(S1, B1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+    m_pDescriptor->addLayoutBindings(S1, B1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
                                      VK_SHADER_STAGE_FRAGMENT_BIT);
     m_pDescriptor->createLayout(S1);
     
-    m_pDescriptor->setupLayout(S2);
-    for (uint i = 0; i < 5; i++) {
-        m_pDescriptor->addLayoutBindings(S2, i, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                                       VK_SHADER_STAGE_FRAGMENT_BIT);
-    }
-    m_pDescriptor->createLayout(S2);
+    // S2 is the texture heap, materials are picked by slot in the push constants
     
-    m_pDescriptor->setupLayout(S3);
+    // Two sets so the heightmap can be written on the compute queue while a frame reads the other
+    m_pDescriptor->setupLayout(S3, 2);
     m_pDescriptor->addLayoutBindings(S3, B0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                                    VK_SHADER_STAGE_FRAGMENT_BIT);
     m_pDescriptor->createLayout(S3);
@@ -304,7 +278,8 @@ void GraphicsScene::createDescriptor() {
                                    VK_SHADER_STAGE_FRAGMENT_BIT);
     m_pDescriptor->createLayout(S4);
     
-    m_pDescriptor->setupLayout(S5);
+    // Two sets so a new environment can be written while the old one is in flight
+    m_pDescriptor->setupLayout(S5, 2);
     m_pDescriptor->addLayoutBindings(S5, B0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                                    VK_SHADER_STAGE_FRAGMENT_BIT);
     m_pDescriptor->addLayoutBindings(S5, B1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
@@ -315,14 +290,26 @@ void GraphicsScene::createDescriptor() {
                                    VK_SHADER_STAGE_FRAGMENT_BIT);
     m_pDescriptor->createLayout(S5);
     
-    m_pDescriptor->createPool();
     m_pDescriptor->allocate(S0);
     m_pDescriptor->allocate(S1);
-    m_pDescriptor->allocate(S2);
     m_pDescriptor->allocate(S3);
     m_pDescriptor->allocate(S4);
     m_pDescriptor->allocate(S5);
     m_cleaner.push([=](){ m_pDescriptor->cleanup(); });
+    
+    createSwapSet(m_textureSet);
+    createSwapSet(m_cubemapSet);
+    
+    m_pTextureStreamer = new TextureStreamer();
+    m_pTextureStreamer->create();
+    m_cleaner.push([=](){
+        // Images of a batch that never got bound are still owned by the streamer's caller
+        m_pTextureStreamer->cleanup();
+        for (Image* pImage : m_pTextureStreamer->getTextures()) {
+            VECTOR<Image*> bound = m_textureSet.images;
+            if (std::find(bound.begin(), bound.end(), pImage) == bound.end()) pImage->cleanup();
+        }
+    });
 }
 
 void GraphicsScene::createRenderpass() {
@@ -340,7 +327,7 @@ void GraphicsScene::createPipelineLayout() {
     VECTOR<VkDescriptorSetLayout> descSetLayouts = {
         m_pDescriptor->getDescriptorLayout(S0),
         m_pDescriptor->getDescriptorLayout(S1),
-        m_pDescriptor->getDescriptorLayout(S2),
+        System::TextureHeap()->getLayout(),
         m_pDescriptor->getDescriptorLayout(S3),
         m_pDescriptor->getDescriptorLayout(S4),
         m_pDescriptor->getDescriptorLayout(S5)
@@ -363,33 +350,25 @@ void GraphicsScene::createPipelineLayout() {
     m_cleaner.push([=](){ vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr); });
 }
 
+// Every variant is queued ahead of time, they compile on the pool through the
+// pipeline cache and switching Settings only picks another one
 void GraphicsScene::createPipeline() {
     LOG("GraphicsScene::createPipeline");
     VkRenderPass renderpass = m_pRenderpass->get();
     VkPipelineLayout pipelineLayout = m_pipelineLayout;
     VECTOR<VkPipelineShaderStageCreateInfo> shaderStages = m_shaderStages;
     VkPipelineVertexInputStateCreateInfo cubeVertexInfo = m_pCube->getVertexStateInfo();
-    VkPipelineVertexInputStateCreateInfo meshVertexInfo = m_pCube->getVertexStateInfo();
     
-    m_pMeshPipeline = new Pipeline();
-    m_pMeshPipeline->setRenderpass(renderpass);
-    m_pMeshPipeline->setPipelineLayout(pipelineLayout);
-    m_pMeshPipeline->setShaderStages({shaderStages[0], shaderStages[1]});
-    m_pMeshPipeline->setVertexInputInfo(meshVertexInfo);
-    
-    m_pMeshPipeline->setupViewportInfo();
-    m_pMeshPipeline->setupInputAssemblyInfo();
-    m_pMeshPipeline->setupRasterizationInfo();
-    m_pMeshPipeline->setupMultisampleInfo();
-    
-    m_pMeshPipeline->setupBlendAttachment();
-    m_pMeshPipeline->setupColorBlendInfo();
-    
-    m_pMeshPipeline->setupDynamicInfo();
-    m_pMeshPipeline->setupDepthStencilInfo();
-
-    m_pMeshPipeline->createGraphicsPipeline();
-    m_cleaner.push([=](){ m_pMeshPipeline->cleanup(); });
+    // Fluid only matters with interference, that variant is never picked
+    m_pMeshPipelines.resize(PERMUTATIONS, nullptr);
+    for (uint permutation = 0; permutation < PERMUTATIONS; permutation++) {
+        bool useTexture   = permutation & PERMUTATION_TEXTURE;
+        bool interference = permutation & PERMUTATION_INTERFERENCE;
+        bool useFluid     = permutation & PERMUTATION_FLUID;
+        if (useFluid && !interference) continue;
+        m_pMeshPipelines[permutation] = createMeshPipeline({ useTexture, interference, useFluid, VK_FALSE });
+    }
+    m_pLightPipeline = createMeshPipeline({ VK_FALSE, VK_FALSE, VK_FALSE, VK_TRUE });
     
     m_pCubemapPipeline = new Pipeline();
     m_pCubemapPipeline->setRenderpass(renderpass);
@@ -408,7 +387,7 @@ void GraphicsScene::createPipeline() {
     m_pCubemapPipeline->setupDynamicInfo();
     m_pCubemapPipeline->setupDepthStencilInfo(VK_FALSE);
 
-    m_pCubemapPipeline->createGraphicsPipeline();
+    m_pCubemapPipeline->buildGraphicsPipeline();
     m_cleaner.push([=](){ m_pCubemapPipeline->cleanup(); });
 }
 
@@ -444,6 +423,160 @@ void GraphicsScene::updateViewportScissor() {
     m_scissor.extent = extent;
 }
 
+// Mesh and light pipelines differ only in their constants
+Pipeline* GraphicsScene::createMeshPipeline(VECTOR<uint32_t> constants) {
+    VkPipelineVertexInputStateCreateInfo meshVertexInfo = m_pCube->getVertexStateInfo();
+    Pipeline* pPipeline = new Pipeline();
+    pPipeline->setRenderpass(m_pRenderpass->get());
+    pPipeline->setPipelineLayout(m_pipelineLayout);
+    pPipeline->setShaderStages({m_shaderStages[0], m_shaderStages[1]});
+    pPipeline->setSpecialization(constants);
+    pPipeline->setVertexInputInfo(meshVertexInfo);
+    
+    pPipeline->setupViewportInfo();
+    pPipeline->setupInputAssemblyInfo();
+    pPipeline->setupRasterizationInfo();
+    pPipeline->setupMultisampleInfo();
+    
+    pPipeline->setupBlendAttachment();
+    pPipeline->setupColorBlendInfo();
+    
+    pPipeline->setupDynamicInfo();
+    pPipeline->setupDepthStencilInfo();
+    
+    pPipeline->buildGraphicsPipeline();
+    m_cleaner.push([=](){ pPipeline->cleanup(); });
+    return pPipeline;
+}
+
+void GraphicsScene::beginRenderpass(VkCommandBuffer cmdBuffer) {
+    std::array<VkClearValue, 2> clearValues{};
+    clearValues[0].color = System::Settings()->ClearColor;
+    clearValues[1].depthStencil = System::Settings()->ClearDepth;
+    
+    VkRenderPassBeginInfo renderBeginInfo{};
+    renderBeginInfo.sType       = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderBeginInfo.clearValueCount = UINT32(clearValues.size());
+    renderBeginInfo.pClearValues    = clearValues.data();
+    renderBeginInfo.renderPass      = m_pRenderpass->get();
+    renderBeginInfo.framebuffer     = m_pFrame->getFramebuffer();
+    renderBeginInfo.renderArea      = m_scissor;
+    
+    vkCmdSetViewport(cmdBuffer, 0, 1, &m_viewport);
+    vkCmdSetScissor(cmdBuffer, 0, 1, &m_scissor);
+    
+    vkCmdBeginRenderPass(cmdBuffer, &renderBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+}
+
+void GraphicsScene::drawMesh(VkCommandBuffer cmdBuffer, VkPipeline pipeline) {
+    VkPipelineLayout pipelineLayout = m_pipelineLayout;
+    Mesh *mesh = m_pMesh[System::Settings()->Shapes];
+    
+    VkDeviceSize offsets  = 0;
+    VkBuffer meshVertexBuffer = mesh->getVertexBuffer()->get();
+    VkBuffer meshIndexBuffer  = mesh->getIndexBuffer()->get();
+    uint32_t meshIndexSize    = mesh->getIndexSize();
+    
+    VkDescriptorSet cameraDescSet  = m_pDescriptor->getDescriptorSet(S0);
+    VkDescriptorSet miscDescSet = m_pDescriptor->getDescriptorSet(S1);
+    VkDescriptorSet textureDescSet = System::TextureHeap()->getDescriptorSet();
+    VkDescriptorSet heightmapDescSet = m_pDescriptor->getDescriptorSets(S3)[m_heightmapIdx];
+    VkDescriptorSet interferenceDescSet = m_pDescriptor->getDescriptorSet(S4);
+    VkDescriptorSet cubemapDescSet = m_pDescriptor->getDescriptorSets(S5)[m_cubemapSet.idx];
+    
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipelineLayout, S0, 1, &cameraDescSet, 1, &m_cameraOffset);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipelineLayout, S1, 1, &miscDescSet, 2, m_miscOffsets);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipelineLayout, S2, 1, &textureDescSet, 0, nullptr);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipelineLayout, S3, 1, &heightmapDescSet, 0, nullptr);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipelineLayout, S4, 1, &interferenceDescSet, 0, nullptr);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipelineLayout, S5, 1, &cubemapDescSet, 0, nullptr);
+    
+    vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &meshVertexBuffer, &offsets);
+    vkCmdBindIndexBuffer  (cmdBuffer, meshIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    
+    VECTOR<uint>& slots = m_textureSet.slots;
+    m_misc.model = mesh->getMatrix();
+    m_misc.isLight = 0;
+    m_misc.albedoIdx = slots.size() == 3 ? slots[0] : 0;
+    m_misc.normalIdx = slots.size() == 3 ? slots[1] : 0;
+    m_misc.ormIdx    = slots.size() == 3 ? slots[2] : 0;
+    vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PCMisc), &m_misc);
+    
+    vkCmdDrawIndexed(cmdBuffer, meshIndexSize, 1, 0, 0, 0);
+}
+
+void GraphicsScene::createSwapSet(SwapSet& swapSet) {
+    m_cleaner.push([=, &swapSet](){
+        for (Image* pImage : swapSet.retired) pImage->cleanup();
+        for (Image* pImage : swapSet.images)  pImage->cleanup();
+    });
+}
+
+// True once no frame recorded before the last swap is still reading the idle set.
+// Images replaced by that swap are released here.
+bool GraphicsScene::isSwapSetIdle(SwapSet& swapSet, bool wait) {
+    Scheduler* pScheduler = System::Scheduler();
+    if (wait) pScheduler->wait(swapSet.lastUse);
+    if (!pScheduler->isComplete(swapSet.lastUse)) return false;
+    for (Image* pImage : swapSet.retired) pImage->cleanup();
+    swapSet.retired.clear();
+    return true;
+}
+
+// Writes the idle set, then switches to it. Call at a frame boundary after isSwapSetIdle.
+void GraphicsScene::swapImages(uint set, SwapSet& swapSet, VECTOR<Image*> images, uint baseMip) {
+    bool isFirst = swapSet.images.empty();
+    uint setIdx  = isFirst ? swapSet.idx : (swapSet.idx + 1) % 2;
+    for (uint i = 0; i < images.size(); i++) {
+        uint mip = std::min(baseMip, images[i]->getMipLevels() - 1);
+        m_pDescriptor->setupPointerImage(set, setIdx, B0 + i, images[i]->getDescriptorInfo() + mip);
+    }
+    m_pDescriptor->update(set);
+    
+    if (!isFirst) {
+        // At a frame boundary every frame recorded with the old set has been submitted
+        swapSet.lastUse = System::Scheduler()->getSubmittedValue();
+        for (Image* pImage : swapSet.images) {
+            if (std::find(images.begin(), images.end(), pImage) == images.end())
+                swapSet.retired.push_back(pImage);
+        }
+    }
+    swapSet.images  = images;
+    swapSet.baseMip = baseMip;
+    swapSet.idx     = setIdx;
+}
+
+// New views take new slots, nothing a frame in flight reads is rewritten. The old
+// slots and the images they leave behind go once the frames submitted so far complete.
+void GraphicsScene::swapTextures(VECTOR<Image*> images, uint baseMip) {
+    TextureHeap* pTextureHeap = System::TextureHeap();
+    VECTOR<uint> slots;
+    for (Image* pImage : images) {
+        uint mip = std::min(baseMip, pImage->getMipLevels() - 1);
+        slots.push_back(pTextureHeap->add(pImage->getDescriptorInfo() + mip));
+    }
+    for (uint slot : m_textureSet.slots) pTextureHeap->remove(slot);
+    
+    if (!m_textureSet.images.empty()) {
+        m_textureSet.lastUse = System::Scheduler()->getSubmittedValue();
+        for (Image* pImage : m_textureSet.images) {
+            if (std::find(images.begin(), images.end(), pImage) == images.end())
+                m_textureSet.retired.push_back(pImage);
+        }
+    }
+    m_textureSet.images  = images;
+    m_textureSet.baseMip = baseMip;
+    m_textureSet.slots   = slots;
+}
+
 Frame* GraphicsScene::getFrame() { return m_pFrame; }
 Mesh * GraphicsScene::getMesh () { return m_pMesh[System::Settings()->Shapes]; }
 
@@ -12,14 +12,31 @@
 #include "../resources/frame.hpp"
 #include "../resources/mesh.hpp"
 #include "../resources/camera.hpp"
+#include "../resources/texture_streamer.hpp"
 
 
 class GraphicsScene {
     
+    // Two descriptor sets of one layout, the idle one is rewritten and swapped in
+    // while frames in flight keep reading the other. Textures take heap slots
+    // instead, a swap only writes new slots.
+    struct SwapSet {
+        uint idx = 0;
+        uint baseMip = 0;
+        uint64_t lastUse = 0;
+        VECTOR<Image*> images;
+        VECTOR<Image*> retired;
+        VECTOR<uint>   slots;
+    };
+    
+    // Texture indexes are TextureHeap slots of albedo, normal and ORM
     struct PCMisc {
         glm::mat4 model;
         glm::vec3 viewPosition;
         uint isLight;
+        uint albedoIdx;
+        uint normalIdx;
+        uint ormIdx;
     };
     
     struct UBCamera {
@@ -52,21 +69,34 @@ class GraphicsScene {
     
     
 public:
+    // Mesh pipeline variants, one bit per specialization constant of main1d.frag
+    static const uint PERMUTATION_TEXTURE      = 1;
+    static const uint PERMUTATION_INTERFERENCE = 2;
+    static const uint PERMUTATION_FLUID        = 4;
+    static const uint PERMUTATIONS             = 8;
+    
     ~GraphicsScene();
     GraphicsScene();
     
     void cleanup();
     void render(VkCommandBuffer cmdBuffer);
+    // Only the mesh with the given variant, uniforms are the last render's
+    void renderPermutation(VkCommandBuffer cmdBuffer, uint permutation);
     
     void setupShader();
     void setupInput();
+    void setupMesh(VECTOR<Mesh*> pMeshes);
     void updateTexture();
+    void streamTexture(bool wait = false);
     void updateCubemap(Image* cubemap, Image* envMap, Image* reflMap, Image* brdfMap);
+    void cleanRetired();
+    // Only update the CPU copies, render pushes them into the uniform ring
     void updateLightInput();
     void updateParamInput();
     void updateCameraInput(Camera* pCamera);
     void updateInterferenceInput(Image* pInterferenceImage);
-    void updateHeightmapInput(Image* pHeightmapImage);
+    void updateHeightmapInput(Image* pHeightmapImage, uint idx = 0);
+    void setHeightmapIdx(uint idx);
     
     void createDescriptor();
     void createPipelineLayout();
@@ -75,37 +105,41 @@ public:
     void createFrame(UInt2D size);
     void recreateFrame(UInt2D size);
     
+    static VECTOR<Mesh*> LoadMeshes();
+    // The variant for the current Settings
+    static uint   GetPermutation();
+    static STRING GetPermutationName(uint permutation);
+    
     Frame* getFrame();
     Mesh * getMesh();
     
 private:
     Cleaner m_cleaner;
     Device* m_pDevice;
-    Pipeline* m_pMeshPipeline;
+    VECTOR<Pipeline*> m_pMeshPipelines;
+    Pipeline* m_pLightPipeline;
     Pipeline* m_pCubemapPipeline;
     Renderpass* m_pRenderpass;
     Descriptor* m_pDescriptor;
     
-    Buffer* m_pLightBuffer;
-    Buffer* m_pParamBuffer;
-    Buffer* m_pCameraBuffer;
     Buffer* m_pMarkBuffer;
     Frame*  m_pFrame;
     
     Mesh*   m_pCube;
     VECTOR<Mesh*> m_pMesh;
-    Image*  m_pCubemap;
-    Image*  m_pEnvMap;
-    Image*  m_pReflMap;
-    Image*  m_pBrdfMap;
-    Image*  m_pHeightmap;
+    uint    m_heightmapIdx = 0;
     Image*  m_pInterference;
-    VECTOR<Image*> m_pTextures;
+    TextureStreamer* m_pTextureStreamer;
+    
+    SwapSet m_textureSet;
+    SwapSet m_cubemapSet;
     
     PCMisc   m_misc{};
     UBLights m_lights{};
     UBCamera m_camera{};
     UBParam  m_param{};
+    uint32_t m_cameraOffset = 0;
+    uint32_t m_miscOffsets[2] = { 0, 0 };
     
     VkViewport m_viewport{};
     VkRect2D   m_scissor{};
@@ -120,4 +154,13 @@ private:
     
     void updateViewportScissor();
     
+    Pipeline* createMeshPipeline(VECTOR<uint32_t> constants);
+    void beginRenderpass(VkCommandBuffer cmdBuffer);
+    void drawMesh(VkCommandBuffer cmdBuffer, VkPipeline pipeline);
+    
+    void createSwapSet(SwapSet& swapSet);
+    bool isSwapSetIdle(SwapSet& swapSet, bool wait);
+    void swapImages(uint set, SwapSet& swapSet, VECTOR<Image*> images, uint baseMip);
+    void swapTextures(VECTOR<Image*> images, uint baseMip);
+    
 };
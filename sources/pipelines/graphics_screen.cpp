@@ -81,7 +81,6 @@ void GraphicsScreen::createDescriptor() {
                                    VK_SHADER_STAGE_FRAGMENT_BIT);
     m_pDescriptor->createLayout(S0);
     
-    m_pDescriptor->createPool();
     m_pDescriptor->allocate(S0);
     m_cleaner.push([=](){ m_pDescriptor->cleanup(); });
 }
@@ -134,7 +133,7 @@ void GraphicsScreen::createPipeline() {
     
     m_pPipeline->setupDynamicInfo();
 
-    m_pPipeline->createGraphicsPipeline();
+    m_pPipeline->buildGraphicsPipeline();
     m_cleaner.push([=](){ m_pPipeline->cleanup(); });
 }
 
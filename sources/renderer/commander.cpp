@@ -14,6 +14,16 @@ void Commander::setupPool() {
     m_poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     m_poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
     m_poolInfo.queueFamilyIndex = m_pDevice->getGraphicQueueIndex();
+    m_queue = m_pDevice->getGraphicQueue();
+    m_pScheduler = System::Scheduler();
+}
+
+// Pool on the graphics family that submits to another queue of that family,
+// that queue gets a timeline of its own
+void Commander::setupPool(VkQueue queue) {
+    setupPool();
+    m_queue = queue;
+    m_pScheduler = nullptr;
 }
 
 void Commander::createPool() {
@@ -22,6 +32,12 @@ void Commander::createPool() {
     VkResult result = vkCreateCommandPool(device, &m_poolInfo, nullptr, &m_commandPool);
     CHECK_VKRESULT(result, "failed to create command pool!");
     m_cleaner.push([=](){ vkDestroyCommandPool(device, m_commandPool, nullptr); });
+    if (m_pScheduler) return;
+    
+    Scheduler* pScheduler = new Scheduler();
+    pScheduler->create(m_queue);
+    m_pScheduler = pScheduler;
+    m_cleaner.push([=](){ pScheduler->cleanup(); });
 }
 
 VkCommandBuffer Commander::createCommandBuffer() {
@@ -67,21 +83,53 @@ void Commander::beginSingleTimeCommands(VkCommandBuffer commandBuffer) {
     vkBeginCommandBuffer(commandBuffer, &beginInfo);
 }
 
+// Waits for this submit alone rather than the whole queue
 void Commander::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
     LOG("Commander::endSingleTimeCommands");
     VkDevice      device      = m_pDevice->getDevice();
-    VkQueue       queue       = m_pDevice->getGraphicQueue();
     VkCommandPool commandPool = m_commandPool;
     
     vkEndCommandBuffer(commandBuffer);
+    submitTransfers();
     
     VkSubmitInfo submitInfo{};
     submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers    = &commandBuffer;
     
-    vkQueueSubmit  (queue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(queue);
+    m_pScheduler->wait(m_pScheduler->submit(submitInfo));
     
     vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 }
+
+// Returns right after the submit, the buffer must be freed once the returned
+// value is reached on getScheduler
+uint64_t Commander::submitSingleTimeCommands(VkCommandBuffer commandBuffer) {
+    LOG("Commander::submitSingleTimeCommands");
+    vkEndCommandBuffer(commandBuffer);
+    submitTransfers();
+    
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers    = &commandBuffer;
+    
+    return m_pScheduler->submit(submitInfo);
+}
+
+void Commander::freeCommandBuffer(VkCommandBuffer commandBuffer) {
+    VkDevice device = m_pDevice->getDevice();
+    vkFreeCommandBuffers(device, m_commandPool, 1, &commandBuffer);
+}
+
+Scheduler* Commander::getScheduler() { return m_pScheduler; }
+
+
+// Private ==================================================
+
+// Batched uploads on the render queue may be what this submit depends on
+void Commander::submitTransfers() {
+    TransferManager* pTransferManager = System::TransferManager();
+    if (pTransferManager == nullptr || m_queue != m_pDevice->getGraphicQueue()) return;
+    if (pTransferManager->canRecord()) pTransferManager->submit();
+}
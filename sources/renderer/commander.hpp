@@ -5,6 +5,7 @@
 
 #include "../include.h"
 #include "device.hpp"
+#include "scheduler.hpp"
 
 class Commander {
     
@@ -16,13 +17,18 @@ public:
     void cleanup();
     
     void setupPool();
+    void setupPool(VkQueue queue);
     void createPool();
     
     VkCommandBuffer              createCommandBuffer();
     std::vector<VkCommandBuffer> createCommandBuffers(uint32_t count);
     
     void beginSingleTimeCommands(VkCommandBuffer commandBuffer);
-    void endSingleTimeCommands  (VkCommandBuffer commandBuffer);
+    void     endSingleTimeCommands   (VkCommandBuffer commandBuffer);
+    uint64_t submitSingleTimeCommands(VkCommandBuffer commandBuffer);
+    void freeCommandBuffer      (VkCommandBuffer commandBuffer);
+    
+    Scheduler* getScheduler();
     
     VkCommandPoolCreateInfo m_poolInfo{};
     
@@ -31,8 +37,10 @@ private:
     Cleaner m_cleaner;
     
     VkCommandPool m_commandPool = VK_NULL_HANDLE;
+    VkQueue       m_queue       = VK_NULL_HANDLE;
+    Scheduler*    m_pScheduler  = nullptr;
     
-    
+    void submitTransfers();
 };
 
 
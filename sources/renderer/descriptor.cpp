@@ -15,11 +15,9 @@ void Descriptor::setupLayout(uint set, uint count) {
     m_dataMap[set] = DescriptorSetData{ .set = set, .count = count };
 }
 
-void Descriptor::addLayoutBindings(uint set, uint binding, VkDescriptorType type, VkShaderStageFlags flags) {
+// count > 1 declares an array binding, its pointer must then hold count infos
+void Descriptor::addLayoutBindings(uint set, uint binding, VkDescriptorType type, VkShaderStageFlags flags, uint count) {
     if (!m_dataMap.count(set)) setupLayout(set);
-    if (!m_poolSizesMap.count(type)) m_poolSizesMap[type] = VkDescriptorPoolSize{ type, 0 };
-    
-    uint count = 1;
     
     VkDescriptorSetLayoutBinding layoutBinding{};
     layoutBinding.binding         = binding;
@@ -37,44 +35,13 @@ void Descriptor::addLayoutBindings(uint set, uint binding, VkDescriptorType type
     
     m_dataMap[set].layoutBindings.push_back(layoutBinding);
     m_dataMap[set].writeSets.push_back(writeSet);
-    m_poolSizesMap[type].descriptorCount += m_dataMap[set].count;
 }
 
+// Layouts are owned by the allocator's cache, nothing to destroy here
 void Descriptor::createLayout(uint set) {
     LOG("Descriptor::createLayout");
-    VkDevice device = m_pDevice->getDevice();
-    DescriptorSetData data = m_dataMap[set];
-    
-    VkDescriptorSetLayoutCreateInfo layoutInfo{};
-    layoutInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = UINT32(data.layoutBindings.size());
-    layoutInfo.pBindings    = data.layoutBindings.data();
-    
-    VkResult result = vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &data.layout);
-    CHECK_VKRESULT(result, "failed to create descriptor set layout!");
-    m_cleaner.push([=](){ vkDestroyDescriptorSetLayout(device, data.layout, nullptr); });
-        
-    m_dataMap[set] = data;
-}
-
-void Descriptor::createPool() {
-    LOG("Descriptor::createPool");
-    VkDevice device = m_pDevice->getDevice();
-    DescriptorSetDataMap descDataMap = m_dataMap;
-    VECTOR<VkDescriptorPoolSize> poolSizes = getPoolSizes();
-    
-    VkDescriptorPoolCreateInfo poolInfo{};
-    poolInfo.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.maxSets       = getTotalDecriptorSets();
-    poolInfo.poolSizeCount = UINT32(poolSizes.size());
-    poolInfo.pPoolSizes    = poolSizes.data();
-
-    VkDescriptorPool pool;
-    VkResult result = vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool);
-    CHECK_VKRESULT(result, "failed to create descriptor pool!");
-    m_cleaner.push([=](){ vkDestroyDescriptorPool(device, pool, nullptr); });
-    
-    m_pool = pool;
+    DescriptorSetData& data = m_dataMap[set];
+    data.layout = System::DescriptorAllocator()->getLayout(data.layoutBindings);
 }
 
 void Descriptor::allocate(uint set) {
@@ -131,40 +98,14 @@ VECTOR<VkDescriptorSet> Descriptor::getDescriptorSets(uint set) {
 // Private ==================================================
 
 
+// Sets go back to the shared pool on cleanup, the owner has waited for its last use by then
 void Descriptor::allocateDescriptorSet(DescriptorSetData* data) {
     LOG("Descriptor::allocateData");
-    VkDevice device = m_pDevice->getDevice();
-    VkDescriptorPool pool = m_pool;
-    
-    VECTOR<VkDescriptorSetLayout> layouts(data->count, data->layout);
-    
-    VkDescriptorSetAllocateInfo allocInfo{};
-    allocInfo.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool     = pool;
-    allocInfo.descriptorSetCount = data->count;
-    allocInfo.pSetLayouts        = layouts.data();
-    
-    data->descriptorSets.resize(data->count);
-    VkResult result = vkAllocateDescriptorSets(device, &allocInfo, data->descriptorSets.data());
-    CHECK_VKRESULT(result, "failed to allocate descriptor set!");
-}
-
-uint Descriptor::getTotalDecriptorSets() {
-    uint total = 0;
-    DescriptorSetDataMap map = m_dataMap;
-    DescriptorSetDataMap::iterator it;
-    for (it = map.begin(); it != map.end(); ++it )
-        total += (it->second).count;
-    return total;
-}
-
-VECTOR<VkDescriptorPoolSize> Descriptor::getPoolSizes() {
-    VECTOR<VkDescriptorPoolSize> vec;
-    DescriptorPoolSizeMap map = m_poolSizesMap;
-    DescriptorPoolSizeMap::iterator it;
-    for (it = map.begin(); it != map.end(); ++it )
-        vec.push_back(it->second);
-    return vec;
+    DescriptorAllocator* pAllocator = System::DescriptorAllocator();
+    VkDescriptorPool pool;
+    data->descriptorSets = pAllocator->allocate(data->layout, data->count, &pool);
+    VECTOR<VkDescriptorSet> descriptorSets = data->descriptorSets;
+    m_cleaner.push([=](){ pAllocator->free(pool, descriptorSets); });
 }
 
 int Descriptor::findWriteSetIdx(uint set, uint binding) {
@@ -20,9 +20,7 @@ public:
     
     void setupLayout(uint layoutId, uint count = 1);
     void createLayout(uint layoutId);
-    void addLayoutBindings(uint layoutId, uint binding, VkDescriptorType type, VkShaderStageFlags flags);
-    
-    void createPool();
+    void addLayoutBindings(uint layoutId, uint binding, VkDescriptorType type, VkShaderStageFlags flags, uint count = 1);
     
     void allocate(uint layoutId);
     void allocateAll();
@@ -48,21 +46,14 @@ private:
         VECTOR<VkWriteDescriptorSet> writeSets;
     };
     
-    typedef std::map<VkDescriptorType, VkDescriptorPoolSize> DescriptorPoolSizeMap;
-    typedef std::map<uint            , DescriptorSetData   > DescriptorSetDataMap;
+    typedef std::map<uint, DescriptorSetData> DescriptorSetDataMap;
     
     Cleaner m_cleaner;
     Device* m_pDevice;
     
-    VkDescriptorPool m_pool = VK_NULL_HANDLE;
-    
-    DescriptorPoolSizeMap m_poolSizesMap;
-    DescriptorSetDataMap  m_dataMap;
+    DescriptorSetDataMap m_dataMap;
     
     void allocateDescriptorSet(DescriptorSetData* data);
     
-    uint getTotalDecriptorSets();
-    VECTOR<VkDescriptorPoolSize> getPoolSizes();
-    
     int findWriteSetIdx(uint id, uint binding);
 };
@@ -0,0 +1,136 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#include "descriptor_allocator.hpp"
+
+#include "../system.hpp"
+
+#include <algorithm>
+
+DescriptorAllocator::~DescriptorAllocator() {}
+DescriptorAllocator::DescriptorAllocator() : m_pDevice(System::Device()) {}
+
+void DescriptorAllocator::cleanup() { m_cleaner.flush("DescriptorAllocator"); }
+
+void DescriptorAllocator::create() {
+    LOG("DescriptorAllocator::create");
+    VkDevice device = m_pDevice->getDevice();
+    m_cleaner.push([=](){
+        for (std::pair<const VECTOR<uint32_t>, VkDescriptorSetLayout>& layout : m_layouts)
+            vkDestroyDescriptorSetLayout(device, layout.second, nullptr);
+        for (VkDescriptorPool pool : m_pools) vkDestroyDescriptorPool(device, pool, nullptr);
+        LOG("DescriptorAllocator::cleanup " << m_layouts.size() << " layouts, " << m_pools.size() << " pools");
+        m_layouts.clear();
+        m_layoutSizes.clear();
+        m_pools.clear();
+        m_poolSets = DESCRIPTOR_POOL_SETS;
+    });
+}
+
+// The signature is every binding's number, type, count and stages in binding order
+VkDescriptorSetLayout DescriptorAllocator::getLayout(VECTOR<VkDescriptorSetLayoutBinding> bindings) {
+    std::sort(bindings.begin(), bindings.end(), [](const VkDescriptorSetLayoutBinding& a,
+                                                   const VkDescriptorSetLayoutBinding& b){
+        return a.binding < b.binding;
+    });
+    VECTOR<uint32_t> signature;
+    std::map<VkDescriptorType, uint32_t> typeCounts;
+    for (VkDescriptorSetLayoutBinding& binding : bindings) {
+        signature.insert(signature.end(), { binding.binding, uint32_t(binding.descriptorType),
+                                            binding.descriptorCount, binding.stageFlags });
+        typeCounts[binding.descriptorType] += binding.descriptorCount;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    LayoutMap::iterator it = m_layouts.find(signature);
+    if (it != m_layouts.end()) return it->second;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = UINT32(bindings.size());
+    layoutInfo.pBindings    = bindings.data();
+
+    VkDescriptorSetLayout layout;
+    VkResult result = vkCreateDescriptorSetLayout(m_pDevice->getDevice(), &layoutInfo, nullptr, &layout);
+    CHECK_VKRESULT(result, "failed to create descriptor set layout!");
+    LOG("DescriptorAllocator::getLayout create " << m_layouts.size() + 1);
+
+    VECTOR<VkDescriptorPoolSize> sizes;
+    for (std::pair<const VkDescriptorType, uint32_t>& typeCount : typeCounts)
+        sizes.push_back({ typeCount.first, typeCount.second });
+    m_layouts[signature] = layout;
+    m_layoutSizes[layout] = sizes;
+    return layout;
+}
+
+// Newest pools first, older ones only have room where sets were freed
+VECTOR<VkDescriptorSet> DescriptorAllocator::allocate(VkDescriptorSetLayout layout, uint count, VkDescriptorPool* pPool) {
+    VECTOR<VkDescriptorSet> descriptorSets(count);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (VECTOR<VkDescriptorPool>::reverse_iterator it = m_pools.rbegin(); it != m_pools.rend(); ++it) {
+        if (allocateFrom(*it, layout, count, descriptorSets.data()) != VK_SUCCESS) continue;
+        *pPool = *it;
+        return descriptorSets;
+    }
+
+    VkDescriptorPool pool = createPool(layout, count);
+    VkResult result = allocateFrom(pool, layout, count, descriptorSets.data());
+    CHECK_VKRESULT(result, "failed to allocate descriptor set!");
+    *pPool = pool;
+    return descriptorSets;
+}
+
+void DescriptorAllocator::free(VkDescriptorPool pool, VECTOR<VkDescriptorSet> descriptorSets) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    vkFreeDescriptorSets(m_pDevice->getDevice(), pool, UINT32(descriptorSets.size()), descriptorSets.data());
+}
+
+
+// Private ==================================================
+
+// Room for m_poolSets sets of typical bindings, and at least for the request that did not fit
+VkDescriptorPool DescriptorAllocator::createPool(VkDescriptorSetLayout layout, uint count) {
+    uint poolSets = std::max(m_poolSets, count);
+    std::map<VkDescriptorType, uint32_t> typeCounts = {
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, poolSets     },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         poolSets     },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          poolSets * 2 },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, poolSets * 4 },
+    };
+    for (VkDescriptorPoolSize& size : m_layoutSizes[layout])
+        typeCounts[size.type] = std::max(typeCounts[size.type], size.descriptorCount * count);
+
+    VECTOR<VkDescriptorPoolSize> poolSizes;
+    for (std::pair<const VkDescriptorType, uint32_t>& typeCount : typeCounts)
+        poolSizes.push_back({ typeCount.first, typeCount.second });
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags         = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    poolInfo.maxSets       = poolSets;
+    poolInfo.poolSizeCount = UINT32(poolSizes.size());
+    poolInfo.pPoolSizes    = poolSizes.data();
+
+    VkDescriptorPool pool;
+    VkResult result = vkCreateDescriptorPool(m_pDevice->getDevice(), &poolInfo, nullptr, &pool);
+    CHECK_VKRESULT(result, "failed to create descriptor pool!");
+    LOG("DescriptorAllocator::createPool " << poolSets << " sets, pool " << m_pools.size() + 1);
+    m_pools.push_back(pool);
+    m_poolSets = std::min(m_poolSets * 2, DESCRIPTOR_POOL_SETS * 16);
+    return pool;
+}
+
+// Out of memory and fragmented only mean this pool is full, anything else is an error
+VkResult DescriptorAllocator::allocateFrom(VkDescriptorPool pool, VkDescriptorSetLayout layout, uint count,
+                                           VkDescriptorSet* pSets) {
+    VECTOR<VkDescriptorSetLayout> layouts(count, layout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool     = pool;
+    allocInfo.descriptorSetCount = count;
+    allocInfo.pSetLayouts        = layouts.data();
+    VkResult result = vkAllocateDescriptorSets(m_pDevice->getDevice(), &allocInfo, pSets);
+    bool isFull = result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL;
+    if (!isFull) CHECK_VKRESULT(result, "failed to allocate descriptor set!");
+    return result;
+}
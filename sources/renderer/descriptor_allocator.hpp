@@ -0,0 +1,49 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#pragma once
+
+#include "../include.h"
+#include "device.hpp"
+
+#include <mutex>
+
+const uint DESCRIPTOR_POOL_SETS = 64;
+
+// Descriptor sets for every pipeline come from shared pools instead of one
+// pool sized per owner, and are freed back to their pool. A pool that runs
+// out is followed by a new one sized for twice the sets. Layouts are cached
+// by their bindings, so owners that declare the same set share one layout.
+// Every set lives until its owner frees it, there are no per-frame pools since
+// the sets that change per frame are swap sets also bound outside the frame loop.
+class DescriptorAllocator {
+
+public:
+    ~DescriptorAllocator();
+    DescriptorAllocator();
+
+    void cleanup();
+    void create();
+
+    VkDescriptorSetLayout getLayout(VECTOR<VkDescriptorSetLayoutBinding> bindings);
+
+    // The pool is written to pPool, free gives the sets back to it
+    VECTOR<VkDescriptorSet> allocate(VkDescriptorSetLayout layout, uint count, VkDescriptorPool* pPool);
+    void free(VkDescriptorPool pool, VECTOR<VkDescriptorSet> descriptorSets);
+
+private:
+    typedef std::map<VECTOR<uint32_t>, VkDescriptorSetLayout> LayoutMap;
+    typedef std::map<VkDescriptorSetLayout, VECTOR<VkDescriptorPoolSize>> LayoutSizeMap;
+
+    Cleaner m_cleaner;
+    Device* m_pDevice;
+
+    LayoutMap                m_layouts;
+    LayoutSizeMap            m_layoutSizes;
+    VECTOR<VkDescriptorPool> m_pools;
+    uint                     m_poolSets = DESCRIPTOR_POOL_SETS;
+    std::mutex               m_mutex;
+
+    VkDescriptorPool createPool(VkDescriptorSetLayout layout, uint count);
+    VkResult allocateFrom(VkDescriptorPool pool, VkDescriptorSetLayout layout, uint count, VkDescriptorSet* pSets);
+};
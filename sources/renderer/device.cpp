@@ -34,11 +34,13 @@ void Device::setup() {
     deviceFeatures.samplerAnisotropy = VK_TRUE;
     deviceFeatures.multiViewport     = VK_TRUE;
     deviceFeatures.fragmentStoresAndAtomics = VK_TRUE;
+    deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
     
     VECTOR<const char*> instanceExtensions = GetGLFWInstanceExtensions();
     instanceExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 
-    VECTOR<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_KHR_PORTABILITY_SUBSET_EXTENSION_NAME, VK_EXT_SHADER_VIEWPORT_INDEX_LAYER_EXTENSION_NAME };
+    VECTOR<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_KHR_PORTABILITY_SUBSET_EXTENSION_NAME, VK_EXT_SHADER_VIEWPORT_INDEX_LAYER_EXTENSION_NAME,
+                                             VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME };
     VECTOR<const char*> validationLayers = { "VK_LAYER_KHRONOS_validation" };
     bool result = CheckLayerSupport(validationLayers);
     CHECK_BOOL(result, "validation layers requested, but not available!");
@@ -98,6 +100,7 @@ void Device::selectPhysicalDevice() {
     
     int graphicQueueIndex = 0;
     int presentQueueIndex = 0;
+    bool isSuitable = false;
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     
     VECTOR<VkSurfaceFormatKHR> formats;
@@ -120,15 +123,27 @@ void Device::selectPhysicalDevice() {
         bool hasFamilyIndex     = graphicQueueIndex > -1 && presentQueueIndex > -1;
         bool featureSupported   = CheckFeatureSupport(tempDevice, deviceFeatures);
         bool extensionSupported = CheckDeviceExtensionSupport(tempDevice, deviceExtensions);
+        // The extension structs may only be queried once the extensions are known to exist
+        bool timelineSupported  = extensionSupported && CheckTimelineSupport(tempDevice);
+        bool indexingSupported  = extensionSupported && CheckIndexingSupport(tempDevice);
         
-        if (swapchainAdequate && hasFamilyIndex && extensionSupported && featureSupported) break;
+        isSuitable = swapchainAdequate && hasFamilyIndex && extensionSupported && featureSupported &&
+                     timelineSupported && indexingSupported;
+        if (isSuitable) break;
     }
+    CHECK_BOOL(isSuitable, "failed to find a suitable GPU!");
     
     m_surfaceFormat     = FindSufraceFormat(formats);
     m_presentMode       = FindPresentMode(modes);
     m_physicalDevice    = physicalDevice;
     m_graphicQueueIndex = graphicQueueIndex;
     m_presentQueueIndex = presentQueueIndex;
+    
+    int transferQueueIndex = FindTransferQueueIndex(m_physicalDevice);
+    if (transferQueueIndex > -1) m_transferQueueIndex = transferQueueIndex;
+    
+    int computeQueueIndex = FindComputeQueueIndex(m_physicalDevice);
+    if (computeQueueIndex > -1) m_computeQueueIndex = computeQueueIndex;
 }
 
 void Device::createLogicalDevice() {
@@ -138,20 +153,52 @@ void Device::createLogicalDevice() {
     VECTOR<const char*> deviceExtensions  = m_vDeviceExtensions;
     VECTOR<const char*> validationLayers  = m_vValidationLayers;
     std::set<uint32_t> queueFamilyIndices = {m_graphicQueueIndex, m_presentQueueIndex};
+    if (m_transferQueueIndex != UINT32_MAX) queueFamilyIndices.insert(m_transferQueueIndex);
+    if (m_computeQueueIndex  != UINT32_MAX) queueFamilyIndices.insert(m_computeQueueIndex);
+    
+    // BC is optional, textures fall back to the uncompressed path without it
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+    deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
     
-    float queuePriority = 1.f;
+    // A second graphics queue lets background work submit without locking the render queue,
+    // without a compute-only family a third one stands in as the async compute queue
+    VECTOR<VkQueueFamilyProperties> queueFamilies = GetQueueFamilyProperties(physicalDevice);
+    uint32_t graphicQueueCount = std::min(queueFamilies[m_graphicQueueIndex].queueCount, 2u);
+    if (m_computeQueueIndex == UINT32_MAX && queueFamilies[m_graphicQueueIndex].queueCount > 2) {
+        m_computeQueueIndex = m_graphicQueueIndex;
+        graphicQueueCount   = 3;
+    }
+    
+    float queuePriorities[] = { 1.f, .5f, 1.f };
     VECTOR<VkDeviceQueueCreateInfo> queueInfos;
     for (uint32_t familyIndex : queueFamilyIndices) {
         VkDeviceQueueCreateInfo queueInfo{};
         queueInfo.sType             = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
         queueInfo.queueFamilyIndex  = familyIndex;
-        queueInfo.queueCount        = 1;
-        queueInfo.pQueuePriorities  = &queuePriority;
+        queueInfo.queueCount        = familyIndex == m_graphicQueueIndex ? graphicQueueCount : 1;
+        queueInfo.pQueuePriorities  = queuePriorities;
         queueInfos.push_back(queueInfo);
     }
     
+    // Every queue is synchronized through a timeline, see Scheduler
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{};
+    timelineFeatures.sType             = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+    timelineFeatures.timelineSemaphore = VK_TRUE;
+    
+    // Textures are read from one bindless array, see TextureHeap
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    indexingFeatures.runtimeDescriptorArray                       = VK_TRUE;
+    indexingFeatures.descriptorBindingPartiallyBound              = VK_TRUE;
+    indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    indexingFeatures.descriptorBindingUpdateUnusedWhilePending    = VK_TRUE;
+    indexingFeatures.descriptorBindingVariableDescriptorCount     = VK_TRUE;
+    timelineFeatures.pNext = &indexingFeatures;
+    
     VkDeviceCreateInfo deviceInfo{};
     deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    deviceInfo.pNext = &timelineFeatures;
     deviceInfo.queueCreateInfoCount     = UINT32(queueInfos.size());
     deviceInfo.pQueueCreateInfos        = queueInfos.data();
     deviceInfo.pEnabledFeatures         = &deviceFeatures;
@@ -165,8 +212,15 @@ void Device::createLogicalDevice() {
     CHECK_VKRESULT(result, "failed to create logical device");
     
     m_device = device;
+    m_deviceFeatures = deviceFeatures;
     vkGetDeviceQueue(device, m_graphicQueueIndex, 0, &m_graphicQueue);
     vkGetDeviceQueue(device, m_presentQueueIndex, 0, &m_presentQueue);
+    if (graphicQueueCount > 1)
+        vkGetDeviceQueue(device, m_graphicQueueIndex, 1, &m_backgroundQueue);
+    if (m_transferQueueIndex != UINT32_MAX)
+        vkGetDeviceQueue(device, m_transferQueueIndex, 0, &m_transferQueue);
+    if (m_computeQueueIndex != UINT32_MAX)
+        vkGetDeviceQueue(device, m_computeQueueIndex, m_computeQueueIndex == m_graphicQueueIndex ? 2 : 0, &m_computeQueue);
     m_cleaner.push([=](){ vkDestroyDevice(m_device, nullptr); });
 }
 
@@ -191,21 +245,28 @@ VkSurfaceCapabilitiesKHR Device::getSurfaceCapabilities() {
     return capabilities;
 }
 
-void Device::waitIdle() { vkDeviceWaitIdle(m_device); }
-void Device::waitAllQueueIdle() { vkQueueWaitIdle(m_presentQueue); }
-
 VkInstance         Device::getInstance()       { return m_instance; }
 VkSurfaceKHR       Device::getSurface()        { return m_surface; }
 VkPhysicalDevice   Device::getPhysicalDevice() { return m_physicalDevice; }
 VkDevice           Device::getDevice()         { return m_device; }
+VkPhysicalDeviceProperties Device::getDeviceProperties() { return m_deviceProperties; }
 
 VkQueue            Device::getGraphicQueue()   { return m_graphicQueue; }
 VkQueue            Device::getPresentQueue()   { return m_presentQueue; }
+VkQueue            Device::getBackgroundQueue(){ return m_backgroundQueue; }
+bool               Device::hasBackgroundQueue(){ return m_backgroundQueue != VK_NULL_HANDLE; }
+VkQueue            Device::getTransferQueue()  { return m_transferQueue; }
+bool               Device::hasTransferQueue()  { return m_transferQueue != VK_NULL_HANDLE; }
+VkQueue            Device::getComputeQueue()   { return m_computeQueue; }
+bool               Device::hasComputeQueue()   { return m_computeQueue != VK_NULL_HANDLE; }
+bool               Device::hasTextureCompressionBC(){ return m_deviceFeatures.textureCompressionBC; }
 VkSurfaceFormatKHR Device::getSurfaceFormat()  { return m_surfaceFormat; }
 VkPresentModeKHR   Device::getPresentMode()    { return m_presentMode;}
 
 uint32_t Device::getGraphicQueueIndex() { return m_graphicQueueIndex; }
 uint32_t Device::getPresentQueueIndex() { return m_presentQueueIndex; }
+uint32_t Device::getTransferQueueIndex(){ return m_transferQueueIndex; }
+uint32_t Device::getComputeQueueIndex() { return m_computeQueueIndex; }
 
 
 // Private ==================================================
@@ -286,6 +347,25 @@ int Device::FindPresentQueueIndex(VkPhysicalDevice physicalDevice, VkSurfaceKHR
     return -1;
 }
 
+// Only a family without graphics or compute counts, those are the copy engines
+int Device::FindTransferQueueIndex(VkPhysicalDevice physicalDevice) {
+    VECTOR<VkQueueFamilyProperties> queueFamilies = GetQueueFamilyProperties(physicalDevice);
+    VkQueueFlags otherFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+    for (int i = 0; i < queueFamilies.size(); i++) {
+        if ((queueFamilies[i].queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamilies[i].queueFlags & otherFlags)) return i;
+    }
+    return -1;
+}
+
+// A compute family without graphics runs beside the render queue instead of time slicing it
+int Device::FindComputeQueueIndex(VkPhysicalDevice physicalDevice) {
+    VECTOR<VkQueueFamilyProperties> queueFamilies = GetQueueFamilyProperties(physicalDevice);
+    for (int i = 0; i < queueFamilies.size(); i++) {
+        if ((queueFamilies[i].queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) return i;
+    }
+    return -1;
+}
+
 bool Device::CheckLayerSupport(VECTOR<const char*> layers) {
     uint32_t count;
     vkEnumerateInstanceLayerProperties(&count, nullptr);
@@ -315,6 +395,44 @@ bool Device::CheckFeatureSupport(VkPhysicalDevice device, VkPhysicalDeviceFeatur
 }
 
 
+// Scheduler keeps every queue on a timeline semaphore
+bool Device::CheckTimelineSupport(VkPhysicalDevice device) {
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &timelineFeatures;
+    vkGetPhysicalDeviceFeatures2(device, &features);
+    
+    if (!timelineFeatures.timelineSemaphore) LOG("Device::CheckTimelineSupport missing timelineSemaphore");
+    return timelineFeatures.timelineSemaphore;
+}
+
+// Every feature createLogicalDevice enables for TextureHeap
+bool Device::CheckIndexingSupport(VkPhysicalDevice device) {
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &indexingFeatures;
+    vkGetPhysicalDeviceFeatures2(device, &features);
+    
+    std::pair<const char*, VkBool32> required[] = {
+        { "runtimeDescriptorArray",                       indexingFeatures.runtimeDescriptorArray                       },
+        { "descriptorBindingPartiallyBound",              indexingFeatures.descriptorBindingPartiallyBound              },
+        { "descriptorBindingSampledImageUpdateAfterBind", indexingFeatures.descriptorBindingSampledImageUpdateAfterBind },
+        { "descriptorBindingUpdateUnusedWhilePending",    indexingFeatures.descriptorBindingUpdateUnusedWhilePending    },
+        { "descriptorBindingVariableDescriptorCount",     indexingFeatures.descriptorBindingVariableDescriptorCount     },
+    };
+    bool supported = true;
+    for (std::pair<const char*, VkBool32>& feature : required) {
+        if (feature.second) continue;
+        LOG("Device::CheckIndexingSupport missing " << feature.first);
+        supported = false;
+    }
+    return supported;
+}
+
 bool Device::CheckDeviceExtensionSupport(VkPhysicalDevice physicalDevice, VECTOR<const char*> extensions) {
     uint32_t count;
     vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, nullptr);
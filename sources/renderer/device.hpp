@@ -19,21 +19,29 @@ public:
     void createDebugMessenger();
     void selectPhysicalDevice();
     void createLogicalDevice();
-    void waitIdle();
-    void waitAllQueueIdle();
     
     VkInstance         getInstance();
     VkSurfaceKHR       getSurface();
     VkPhysicalDevice   getPhysicalDevice();
     VkDevice           getDevice();
+    VkPhysicalDeviceProperties getDeviceProperties();
     
     VkQueue            getGraphicQueue();
     VkQueue            getPresentQueue();
+    VkQueue            getBackgroundQueue();
+    bool               hasBackgroundQueue();
+    VkQueue            getTransferQueue();
+    bool               hasTransferQueue();
+    VkQueue            getComputeQueue();
+    bool               hasComputeQueue();
+    bool               hasTextureCompressionBC();
     VkSurfaceFormatKHR getSurfaceFormat();
     VkPresentModeKHR   getPresentMode();
     
     uint32_t getGraphicQueueIndex();
     uint32_t getPresentQueueIndex();
+    uint32_t getTransferQueueIndex();
+    uint32_t getComputeQueueIndex();
     uint32_t findMemoryTypeIndex(uint32_t typeFilter, VkMemoryPropertyFlags properties);
     
     VkSurfaceCapabilitiesKHR getSurfaceCapabilities();
@@ -62,9 +70,14 @@ private:
     
     uint32_t m_graphicQueueIndex = 0;
     uint32_t m_presentQueueIndex = 0;
+    uint32_t m_transferQueueIndex = UINT32_MAX;
+    uint32_t m_computeQueueIndex  = UINT32_MAX;
 
     VkQueue m_graphicQueue;
     VkQueue m_presentQueue;
+    VkQueue m_backgroundQueue = VK_NULL_HANDLE;
+    VkQueue m_transferQueue   = VK_NULL_HANDLE;
+    VkQueue m_computeQueue    = VK_NULL_HANDLE;
 
     static VkSurfaceFormatKHR FindSufraceFormat(VECTOR<VkSurfaceFormatKHR> surfaceFormats);
     static VkPresentModeKHR   FindPresentMode  (VECTOR<VkPresentModeKHR>   presentModes);
@@ -77,11 +90,15 @@ private:
     
     static int FindGraphicQueueIndex(VkPhysicalDevice physicalDevice);
     static int FindPresentQueueIndex(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface);
+    static int FindTransferQueueIndex(VkPhysicalDevice physicalDevice);
+    static int FindComputeQueueIndex(VkPhysicalDevice physicalDevice);
 
     
     static bool CheckLayerSupport(VECTOR<const char*> layers);
     static bool CheckDeviceExtensionSupport(VkPhysicalDevice device, VECTOR<const char*> extensions);
     static bool CheckFeatureSupport(VkPhysicalDevice device, VkPhysicalDeviceFeatures features);
+    static bool CheckTimelineSupport(VkPhysicalDevice device);
+    static bool CheckIndexingSupport(VkPhysicalDevice device);
 
     static VkResult CreateDebugUtilsMessengerEXT(VkInstance instance,
                                           const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo,
@@ -0,0 +1,84 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#include "frame_commander.hpp"
+
+#include "../system.hpp"
+
+FrameCommander::~FrameCommander() {}
+FrameCommander::FrameCommander() : m_pDevice(System::Device()) {}
+
+void FrameCommander::cleanup() { m_cleaner.flush("FrameCommander"); }
+
+void FrameCommander::create(uint frameCount) {
+    LOG("FrameCommander::create " << frameCount);
+    VkDevice device = m_pDevice->getDevice();
+    m_pools.resize(frameCount);
+    m_cleaner.push([=](){
+        for (PoolMap& pools : m_pools) {
+            for (std::pair<const std::thread::id, Pool*>& pool : pools) {
+                vkDestroyCommandPool(device, pool.second->commandPool, nullptr);
+                delete pool.second;
+            }
+            pools.clear();
+        }
+    });
+}
+
+// Resetting the pool resets all of its buffers, nothing goes back to the driver
+void FrameCommander::beginFrame(uint frameIdx) {
+    CHECK_BOOL((frameIdx < m_pools.size()), "frame commander has no slot for this frame!");
+    VkDevice device = m_pDevice->getDevice();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (std::pair<const std::thread::id, Pool*>& pool : m_pools[frameIdx]) {
+        vkResetCommandPool(device, pool.second->commandPool, 0);
+        pool.second->used[0] = 0;
+        pool.second->used[1] = 0;
+    }
+    m_frameIdx = frameIdx;
+}
+
+VkCommandBuffer FrameCommander::getCommandBuffer(VkCommandBufferLevel level) {
+    Pool* pPool = getPool();
+    uint  idx   = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY ? 0 : 1;
+    VECTOR<VkCommandBuffer>& commandBuffers = pPool->commandBuffers[idx];
+    if (pPool->used[idx] < commandBuffers.size()) return commandBuffers[pPool->used[idx]++];
+
+    LOG("FrameCommander::getCommandBuffer allocate " << commandBuffers.size() + 1);
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level       = level;
+    allocInfo.commandPool = pPool->commandPool;
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    VkResult result = vkAllocateCommandBuffers(m_pDevice->getDevice(), &allocInfo, &commandBuffer);
+    CHECK_VKRESULT(result, "failed to allocate frame command buffer!");
+    commandBuffers.push_back(commandBuffer);
+    pPool->used[idx]++;
+    return commandBuffer;
+}
+
+
+// Private ==================================================
+
+// Only the map lookup is locked, each pool is touched by its own thread alone
+FrameCommander::Pool* FrameCommander::getPool() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    PoolMap& pools = m_pools[m_frameIdx];
+    std::thread::id threadId = std::this_thread::get_id();
+    PoolMap::iterator it = pools.find(threadId);
+    if (it != pools.end()) return it->second;
+
+    LOG("FrameCommander::getPool create for frame " << m_frameIdx);
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = m_pDevice->getGraphicQueueIndex();
+
+    Pool* pPool = new Pool();
+    VkResult result = vkCreateCommandPool(m_pDevice->getDevice(), &poolInfo, nullptr, &pPool->commandPool);
+    CHECK_VKRESULT(result, "failed to create frame command pool!");
+    pools[threadId] = pPool;
+    return pPool;
+}
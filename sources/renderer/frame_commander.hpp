@@ -0,0 +1,45 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#pragma once
+
+#include "../include.h"
+#include "device.hpp"
+
+#include <mutex>
+
+// Command buffers that live for one frame. Every frame slot has a transient
+// pool per recording thread, reset as a whole by beginFrame once the slot's
+// last submit has completed. Buffers handed out are kept and reused in order, so
+// after the first frames recording allocates nothing. Threads may record for
+// the current frame between beginFrame and the frame's submit.
+class FrameCommander {
+
+public:
+    ~FrameCommander();
+    FrameCommander();
+
+    void cleanup();
+    void create(uint frameCount);
+
+    void beginFrame(uint frameIdx);
+    // Handed out reset, the caller begins it with whatever inheritance it needs
+    VkCommandBuffer getCommandBuffer(VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+private:
+    struct Pool {
+        VkCommandPool           commandPool = VK_NULL_HANDLE;
+        VECTOR<VkCommandBuffer> commandBuffers[2];
+        uint                    used[2] = { 0, 0 };
+    };
+    typedef std::unordered_map<std::thread::id, Pool*> PoolMap;
+
+    Cleaner m_cleaner;
+    Device* m_pDevice;
+
+    VECTOR<PoolMap>   m_pools;
+    std::atomic<uint> m_frameIdx{0};
+    std::mutex        m_mutex;
+
+    Pool* getPool();
+};
@@ -0,0 +1,452 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#include "memory_allocator.hpp"
+
+#include "../system.hpp"
+
+#include <algorithm>
+
+#define TLSF_GRANULARITY_SHIFT 8
+#define TLSF_GRANULARITY       (VkDeviceSize(1) << TLSF_GRANULARITY_SHIFT)
+
+VkDeviceSize TLSF::AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+void TLSF::create(VkDeviceSize size) {
+    m_nodes.clear();
+    m_unusedNodes.clear();
+    m_flBitmap = 0;
+    for (uint32_t fl = 0; fl < FL_COUNT; fl++) {
+        m_slBitmap[fl] = 0;
+        for (uint32_t sl = 0; sl < SL_COUNT; sl++) m_heads[fl][sl] = NONE;
+    }
+    insertFree(createNode(0, size & ~(TLSF_GRANULARITY - 1)));
+}
+
+// Alignments above the granularity are met by asking for the worst case
+// padding and giving the front of the block back as its own free node
+bool TLSF::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* pOffset, uint32_t* pNode) {
+    size      = AlignUp(std::max(size, VkDeviceSize(1)), TLSF_GRANULARITY);
+    alignment = std::max(alignment, TLSF_GRANULARITY);
+    uint32_t node = findFree(size + alignment - TLSF_GRANULARITY);
+    if (node == NONE) return false;
+    removeFree(node);
+
+    VkDeviceSize padding = AlignUp(m_nodes[node].offset, alignment) - m_nodes[node].offset;
+    if (padding > 0) {
+        uint32_t front = node;
+        node = split(front, padding);
+        insertFree(front);
+    }
+    if (m_nodes[node].size > size) insertFree(split(node, size));
+
+    m_nodes[node].isFree = false;
+    *pOffset = m_nodes[node].offset;
+    *pNode   = node;
+    return true;
+}
+
+void TLSF::free(uint32_t node) {
+    uint32_t prev = m_nodes[node].prevPhysical;
+    if (prev != NONE && m_nodes[prev].isFree) {
+        removeFree(prev);
+        merge(prev, node);
+        node = prev;
+    }
+    uint32_t next = m_nodes[node].nextPhysical;
+    if (next != NONE && m_nodes[next].isFree) {
+        removeFree(next);
+        merge(node, next);
+    }
+    insertFree(node);
+}
+
+
+// Private ==================================================
+
+uint32_t TLSF::createNode(VkDeviceSize offset, VkDeviceSize size) {
+    Node newNode = { offset, size, NONE, NONE, NONE, NONE, false };
+    if (m_unusedNodes.empty()) {
+        m_nodes.push_back(newNode);
+        return UINT32(m_nodes.size() - 1);
+    }
+    uint32_t node = m_unusedNodes.back();
+    m_unusedNodes.pop_back();
+    m_nodes[node] = newNode;
+    return node;
+}
+
+void TLSF::releaseNode(uint32_t node) { m_unusedNodes.push_back(node); }
+
+void TLSF::insertFree(uint32_t node) {
+    uint32_t fl, sl;
+    Mapping(m_nodes[node].size, &fl, &sl);
+    uint32_t head = m_heads[fl][sl];
+    m_nodes[node].isFree   = true;
+    m_nodes[node].prevFree = NONE;
+    m_nodes[node].nextFree = head;
+    if (head != NONE) m_nodes[head].prevFree = node;
+    m_heads[fl][sl] = node;
+    m_flBitmap     |= 1u << fl;
+    m_slBitmap[fl] |= 1u << sl;
+}
+
+void TLSF::removeFree(uint32_t node) {
+    uint32_t fl, sl;
+    Mapping(m_nodes[node].size, &fl, &sl);
+    uint32_t prev = m_nodes[node].prevFree;
+    uint32_t next = m_nodes[node].nextFree;
+    if (prev != NONE) m_nodes[prev].nextFree = next;
+    if (next != NONE) m_nodes[next].prevFree = prev;
+    if (m_heads[fl][sl] != node) return;
+
+    m_heads[fl][sl] = next;
+    if (next != NONE) return;
+    m_slBitmap[fl] &= ~(1u << sl);
+    if (m_slBitmap[fl] == 0) m_flBitmap &= ~(1u << fl);
+}
+
+// Rounds the request up to the next class so any node in the list found fits
+uint32_t TLSF::findFree(VkDeviceSize size) {
+    VkDeviceSize units = size >> TLSF_GRANULARITY_SHIFT;
+    if (units >= SL_COUNT) units += (VkDeviceSize(1) << (MostSignificantBit(units) - SL_BITS)) - 1;
+    uint32_t fl, sl;
+    Mapping(units << TLSF_GRANULARITY_SHIFT, &fl, &sl);
+    if (fl >= FL_COUNT) return NONE;
+
+    uint32_t slMap = m_slBitmap[fl] & (~0u << sl);
+    if (slMap == 0) {
+        uint32_t flMap = fl + 1 < FL_COUNT ? m_flBitmap & (~0u << (fl + 1)) : 0;
+        if (flMap == 0) return NONE;
+        fl    = __builtin_ctz(flMap);
+        slMap = m_slBitmap[fl];
+    }
+    return m_heads[fl][__builtin_ctz(slMap)];
+}
+
+// Keeps the first size bytes in node, returns the remainder as a new node
+uint32_t TLSF::split(uint32_t node, VkDeviceSize size) {
+    uint32_t back = createNode(m_nodes[node].offset + size, m_nodes[node].size - size);
+    uint32_t next = m_nodes[node].nextPhysical;
+    m_nodes[back].prevPhysical = node;
+    m_nodes[back].nextPhysical = next;
+    if (next != NONE) m_nodes[next].prevPhysical = back;
+    m_nodes[node].nextPhysical = back;
+    m_nodes[node].size = size;
+    return back;
+}
+
+void TLSF::merge(uint32_t node, uint32_t nextNode) {
+    uint32_t next = m_nodes[nextNode].nextPhysical;
+    m_nodes[node].size += m_nodes[nextNode].size;
+    m_nodes[node].nextPhysical = next;
+    if (next != NONE) m_nodes[next].prevPhysical = node;
+    releaseNode(nextNode);
+}
+
+// Classes below SL_COUNT units are exact, above that each power of two is
+// split into SL_COUNT equal steps
+void TLSF::Mapping(VkDeviceSize size, uint32_t* pFl, uint32_t* pSl) {
+    VkDeviceSize units = size >> TLSF_GRANULARITY_SHIFT;
+    if (units < SL_COUNT) {
+        *pFl = 0;
+        *pSl = UINT32(units);
+        return;
+    }
+    uint32_t msb = MostSignificantBit(units);
+    *pSl = UINT32(units >> (msb - SL_BITS)) - SL_COUNT;
+    *pFl = msb - SL_BITS + 1;
+}
+
+uint32_t TLSF::MostSignificantBit(VkDeviceSize value) { return 63 - __builtin_clzll(value); }
+
+
+MemoryAllocator::~MemoryAllocator() {}
+MemoryAllocator::MemoryAllocator() : m_pDevice(System::Device()) {}
+
+void MemoryAllocator::cleanup() { m_cleaner.flush("MemoryAllocator"); }
+
+void MemoryAllocator::create() {
+    LOG("MemoryAllocator::create");
+    vkGetPhysicalDeviceMemoryProperties(m_pDevice->getPhysicalDevice(), &m_memoryProperties);
+    m_atomSize = m_pDevice->getDeviceProperties().limits.nonCoherentAtomSize;
+    
+    // Without resizable BAR the host visible part of VRAM is a 256MB window
+    VkPhysicalDeviceMemoryProperties properties = m_memoryProperties;
+    VkMemoryPropertyFlags barFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    for (uint32_t i = 0; i < properties.memoryTypeCount; i++) {
+        if ((properties.memoryTypes[i].propertyFlags & barFlags) != barFlags) continue;
+        m_isResizableBAR |= properties.memoryHeaps[properties.memoryTypes[i].heapIndex].size > BAR_WINDOW_SIZE;
+    }
+    LOG("MemoryAllocator::create resizable BAR " << (m_isResizableBAR ? "on" : "off"));
+    m_cleaner.push([=](){
+        logStats();
+        while (!m_blocks.empty()) destroyBlock(m_blocks.back());
+    });
+}
+
+// Memory types are tried in order of preference, a full heap moves on to the next
+MemoryAllocator::Allocation MemoryAllocator::allocate(VkMemoryRequirements requirements, MemoryUsage usage,
+                                                      bool isImage, bool isTransient) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    VECTOR<uint32_t> memoryTypes = getMemoryTypes(requirements, usage);
+    CHECK_BOOL(!memoryTypes.empty(), "failed to find suitable memory type!");
+    
+    Allocation allocation;
+    for (uint32_t memoryTypeIndex : memoryTypes) {
+        // Non-coherent ranges are flushed in whole atoms, which must not reach into a neighbour
+        VkMemoryRequirements typeRequirements = requirements;
+        VkMemoryPropertyFlags flags = m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+        if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+            typeRequirements.alignment = std::max(requirements.alignment, m_atomSize);
+            typeRequirements.size      = TLSF::AlignUp(requirements.size, m_atomSize);
+        }
+        if (allocateType(memoryTypeIndex, typeRequirements, isImage, isTransient, &allocation)) return allocation;
+        LOG("MemoryAllocator::allocate type " << memoryTypeIndex << " full, falling back");
+    }
+    RUNTIME_ERROR("failed to allocate memory!");
+}
+
+// One empty block per pool is kept so switching textures doesn't go back to the driver
+void MemoryAllocator::free(Allocation allocation) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Block* pBlock = allocation.pBlock;
+    if (pBlock == nullptr) return;
+    if (pBlock->kind == GENERAL) pBlock->tlsf.free(allocation.node);
+    pBlock->used -= allocation.size;
+    pBlock->allocationCount--;
+    if (pBlock->allocationCount > 0) return;
+
+    pBlock->head = 0;
+    bool hasSpare = false;
+    for (Block* pOther : m_blocks) {
+        hasSpare |= pOther != pBlock && pOther->allocationCount == 0 && pOther->kind == pBlock->kind &&
+                    pOther->memoryTypeIndex == pBlock->memoryTypeIndex && pOther->isImage == pBlock->isImage;
+    }
+    if (pBlock->kind == DEDICATED || hasSpare) destroyBlock(pBlock);
+}
+
+void MemoryAllocator::flush(Allocation allocation, VkDeviceSize offset, VkDeviceSize size) {
+    if (allocation.pBlock == nullptr || allocation.pBlock->isCoherent) return;
+    VkMappedMemoryRange range = getMappedRange(allocation, offset, size);
+    vkFlushMappedMemoryRanges(m_pDevice->getDevice(), 1, &range);
+}
+
+void MemoryAllocator::invalidate(Allocation allocation, VkDeviceSize offset, VkDeviceSize size) {
+    if (allocation.pBlock == nullptr || allocation.pBlock->isCoherent) return;
+    VkMappedMemoryRange range = getMappedRange(allocation, offset, size);
+    vkInvalidateMappedMemoryRanges(m_pDevice->getDevice(), 1, &range);
+}
+
+VECTOR<MemoryAllocator::HeapStats> MemoryAllocator::getHeapStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    VkPhysicalDeviceMemoryProperties properties = m_memoryProperties;
+    VECTOR<HeapStats> heapStats(properties.memoryHeapCount);
+    for (uint i = 0; i < properties.memoryHeapCount; i++) {
+        heapStats[i].heapSize      = properties.memoryHeaps[i].size;
+        heapStats[i].isDeviceLocal = properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+    }
+    for (Block* pBlock : m_blocks) {
+        HeapStats& stats = heapStats[properties.memoryTypes[pBlock->memoryTypeIndex].heapIndex];
+        stats.blockBytes      += pBlock->size;
+        stats.usedBytes       += pBlock->used;
+        stats.blockCount      += 1;
+        stats.allocationCount += pBlock->allocationCount;
+    }
+    return heapStats;
+}
+
+VkDeviceSize MemoryAllocator::getDeviceBytes() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_deviceBytes;
+}
+
+VkDeviceSize MemoryAllocator::getPeakDeviceBytes() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_peakDeviceBytes;
+}
+
+void MemoryAllocator::resetPeakDeviceBytes() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_peakDeviceBytes = m_deviceBytes;
+}
+
+void MemoryAllocator::logStats() {
+    VECTOR<HeapStats> heapStats = getHeapStats();
+    for (uint i = 0; i < heapStats.size(); i++) {
+        LOG("MemoryAllocator::heap " << i << (heapStats[i].isDeviceLocal ? " device" : " host") <<
+            " used "   << heapStats[i].usedBytes  / (1 << 20) << "MB" <<
+            " of "     << heapStats[i].blockBytes / (1 << 20) << "MB in " << heapStats[i].blockCount << " blocks, " <<
+            heapStats[i].allocationCount << " allocations, heap " << heapStats[i].heapSize / (1 << 20) << "MB");
+    }
+}
+
+
+// Private ==================================================
+
+MemoryAllocator::Block* MemoryAllocator::createBlock(VkDeviceSize size, uint32_t memoryTypeIndex, Kind kind, bool isImage) {
+    LOG("MemoryAllocator::createBlock " << size << " type " << memoryTypeIndex);
+    VkDevice device = m_pDevice->getDevice();
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize  = size;
+    allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+    // Running out is not fatal, allocate tries the next memory type
+    VkDeviceMemory memory;
+    VkResult result = vkAllocateMemory(device, &allocInfo, nullptr, &memory);
+    if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY || result == VK_ERROR_OUT_OF_HOST_MEMORY) return nullptr;
+    CHECK_VKRESULT(result, "failed to allocate memory block!");
+
+    Block* pBlock = new Block();
+    pBlock->memory  = memory;
+    pBlock->size    = size;
+    pBlock->memoryTypeIndex = memoryTypeIndex;
+    pBlock->kind    = kind;
+    pBlock->isImage = isImage;
+    if (kind == GENERAL) pBlock->tlsf.create(size);
+
+    VkMemoryPropertyFlags flags = m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+    if (flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) {
+        m_deviceBytes    += size;
+        m_peakDeviceBytes = std::max(m_peakDeviceBytes, m_deviceBytes);
+    }
+    if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        void* pMapped;
+        result = vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &pMapped);
+        CHECK_VKRESULT(result, "failed to map memory block!");
+        pBlock->pMapped = static_cast<unsigned char*>(pMapped);
+        pBlock->isCoherent = flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    }
+    m_blocks.push_back(pBlock);
+    return pBlock;
+}
+
+void MemoryAllocator::destroyBlock(Block* pBlock) {
+    VkDevice device = m_pDevice->getDevice();
+    VkMemoryPropertyFlags flags = m_memoryProperties.memoryTypes[pBlock->memoryTypeIndex].propertyFlags;
+    if (flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) m_deviceBytes -= pBlock->size;
+    vkFreeMemory(device, pBlock->memory, nullptr);
+    m_blocks.erase(std::find(m_blocks.begin(), m_blocks.end(), pBlock));
+    delete pBlock;
+}
+
+bool MemoryAllocator::allocateFrom(Block* pBlock, VkMemoryRequirements requirements, Allocation* pAllocation) {
+    VkDeviceSize offset = 0;
+    uint32_t     node   = TLSF::NONE;
+    switch (pBlock->kind) {
+        case GENERAL:
+            if (!pBlock->tlsf.allocate(requirements.size, requirements.alignment, &offset, &node)) return false;
+            break;
+        case LINEAR:
+            offset = TLSF::AlignUp(pBlock->head, requirements.alignment);
+            if (offset + requirements.size > pBlock->size) return false;
+            pBlock->head = offset + requirements.size;
+            break;
+        case DEDICATED:
+            if (pBlock->allocationCount > 0) return false;
+            break;
+    }
+    pBlock->used += requirements.size;
+    pBlock->allocationCount++;
+
+    pAllocation->memory  = pBlock->memory;
+    pAllocation->offset  = offset;
+    pAllocation->size    = requirements.size;
+    pAllocation->pMapped = pBlock->pMapped ? pBlock->pMapped + offset : nullptr;
+    pAllocation->pBlock  = pBlock;
+    pAllocation->node    = node;
+    return true;
+}
+
+bool MemoryAllocator::allocateType(uint32_t memoryTypeIndex, VkMemoryRequirements requirements, bool isImage,
+                                   bool isTransient, Allocation* pAllocation) {
+    Kind kind = isTransient ? LINEAR : GENERAL;
+    VkDeviceSize blockSize = getBlockSize(memoryTypeIndex, kind);
+    
+    if (requirements.size > blockSize / 2) {
+        Block* pBlock = createBlock(requirements.size, memoryTypeIndex, DEDICATED, isImage);
+        return pBlock && allocateFrom(pBlock, requirements, pAllocation);
+    }
+    for (Block* pBlock : m_blocks) {
+        if (pBlock->kind != kind || pBlock->memoryTypeIndex != memoryTypeIndex || pBlock->isImage != isImage) continue;
+        if (allocateFrom(pBlock, requirements, pAllocation)) return true;
+    }
+    Block* pBlock = createBlock(blockSize, memoryTypeIndex, kind, isImage);
+    if (pBlock == nullptr) return false;
+    CHECK_BOOL(allocateFrom(pBlock, requirements, pAllocation), "failed to sub-allocate memory!");
+    return true;
+}
+
+// Every type holding the required flags, fewest missing preferred and present
+// avoided flags first. Device local host visible memory is only preferred for
+// DYNAMIC, and in a plain BAR window only for allocations well below its size.
+VECTOR<uint32_t> MemoryAllocator::getMemoryTypes(VkMemoryRequirements requirements, MemoryUsage usage) {
+    VkMemoryPropertyFlags required  = 0;
+    VkMemoryPropertyFlags preferred = 0;
+    VkMemoryPropertyFlags avoided   = 0;
+    switch (usage) {
+        case MEMORY_GPU_ONLY:
+            preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            avoided   = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            break;
+        case MEMORY_UPLOAD:
+            required  = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            preferred = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            avoided   = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+            break;
+        case MEMORY_READBACK:
+            required  = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            break;
+        case MEMORY_DYNAMIC:
+            required  = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            avoided   = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+            break;
+    }
+    
+    VkPhysicalDeviceMemoryProperties properties = m_memoryProperties;
+    VkMemoryPropertyFlags barFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    bool isLarge = requirements.size > BAR_WINDOW_SIZE / 16;
+    VECTOR<std::pair<uint32_t, uint32_t>> candidates;
+    for (uint32_t i = 0; i < properties.memoryTypeCount; i++) {
+        VkMemoryPropertyFlags flags = properties.memoryTypes[i].propertyFlags;
+        if (!(requirements.memoryTypeBits & (1 << i)) || (flags & required) != required) continue;
+        uint32_t cost = __builtin_popcount(preferred & ~flags) + __builtin_popcount(avoided & flags);
+        if ((flags & barFlags) == barFlags && !m_isResizableBAR && isLarge) cost += 4;
+        candidates.push_back({ cost, i });
+    }
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](std::pair<uint32_t, uint32_t> a, std::pair<uint32_t, uint32_t> b){ return a.first < b.first; });
+    
+    VECTOR<uint32_t> memoryTypes;
+    for (std::pair<uint32_t, uint32_t> candidate : candidates) memoryTypes.push_back(candidate.second);
+    return memoryTypes;
+}
+
+// Small heaps such as the 256MB BAR window get proportionally smaller blocks
+VkDeviceSize MemoryAllocator::getBlockSize(uint32_t memoryTypeIndex, Kind kind) {
+    VkDeviceSize heapSize  = m_memoryProperties.memoryHeaps[m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+    VkDeviceSize blockSize = kind == LINEAR ? LINEAR_BLOCK_SIZE : GENERAL_BLOCK_SIZE;
+    return std::max(std::min(blockSize, heapSize / 8), TLSF_GRANULARITY << 4) & ~(TLSF_GRANULARITY - 1);
+}
+
+// Whole atoms around the range, clamped to the block
+VkMappedMemoryRange MemoryAllocator::getMappedRange(Allocation allocation, VkDeviceSize offset, VkDeviceSize size) {
+    VkDeviceSize atomSize = m_atomSize;
+    VkDeviceSize start = allocation.offset + offset;
+    VkDeviceSize end   = size == VK_WHOLE_SIZE ? allocation.offset + allocation.size : start + size;
+    start = start / atomSize * atomSize;
+    end   = std::min(TLSF::AlignUp(end, atomSize), allocation.pBlock->size);
+    
+    VkMappedMemoryRange range{};
+    range.sType  = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = allocation.memory;
+    range.offset = start;
+    range.size   = end - start;
+    return range;
+}
@@ -0,0 +1,152 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#pragma once
+
+#include "../include.h"
+#include "device.hpp"
+
+#include <mutex>
+
+// Two level segregated fit over one block of memory. Offsets and sizes are
+// kept in TLSF_GRANULARITY units so every class boundary is a valid offset.
+class TLSF {
+
+    struct Node {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        uint32_t prevPhysical;
+        uint32_t nextPhysical;
+        uint32_t prevFree;
+        uint32_t nextFree;
+        bool     isFree;
+    };
+
+public:
+    static const uint32_t NONE = UINT32_MAX;
+
+    static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment);
+
+    void create(VkDeviceSize size);
+    bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* pOffset, uint32_t* pNode);
+    void free(uint32_t node);
+
+private:
+    static const uint32_t SL_BITS  = 4;
+    static const uint32_t SL_COUNT = 1 << SL_BITS;
+    static const uint32_t FL_COUNT = 32;
+
+    VECTOR<Node>     m_nodes;
+    VECTOR<uint32_t> m_unusedNodes;
+
+    uint32_t m_flBitmap = 0;
+    uint32_t m_slBitmap[FL_COUNT] = {};
+    uint32_t m_heads[FL_COUNT][SL_COUNT];
+
+    uint32_t createNode(VkDeviceSize offset, VkDeviceSize size);
+    void     releaseNode(uint32_t node);
+    void     insertFree(uint32_t node);
+    void     removeFree(uint32_t node);
+    uint32_t findFree(VkDeviceSize size);
+    uint32_t split(uint32_t node, VkDeviceSize size);
+    void     merge(uint32_t node, uint32_t nextNode);
+
+    static void     Mapping(VkDeviceSize size, uint32_t* pFl, uint32_t* pSl);
+    static uint32_t MostSignificantBit(VkDeviceSize value);
+};
+
+// What the CPU does with a resource, each maps to a preferred memory type
+// with fallbacks. GPU_ONLY is never mapped, UPLOAD is written once and read
+// by copies, READBACK is read by the CPU after the GPU wrote it and DYNAMIC
+// is rewritten often and read directly by shaders.
+enum MemoryUsage { MEMORY_GPU_ONLY, MEMORY_UPLOAD, MEMORY_READBACK, MEMORY_DYNAMIC };
+
+// Owns large VkDeviceMemory blocks per memory type and hands out aligned
+// ranges of them. Long-lived resources go through TLSF, pure transfer buffers
+// through a linear block that rewinds once it is empty, and anything larger
+// than half a block gets memory of its own. Buffers and optimal images never
+// share a block, which keeps them bufferImageGranularity apart. Host visible
+// blocks stay mapped for their whole lifetime.
+class MemoryAllocator {
+
+public:
+    enum Kind { GENERAL, LINEAR, DEDICATED };
+
+    struct Block {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize   size   = 0;
+        uint32_t       memoryTypeIndex = 0;
+        unsigned char* pMapped = nullptr;
+        Kind kind    = GENERAL;
+        bool isImage = false;
+        bool isCoherent = true;
+        TLSF tlsf;
+        VkDeviceSize head = 0;
+        VkDeviceSize used = 0;
+        uint allocationCount = 0;
+    };
+
+    struct Allocation {
+        VkDeviceMemory memory  = VK_NULL_HANDLE;
+        VkDeviceSize   offset  = 0;
+        VkDeviceSize   size    = 0;
+        void*          pMapped = nullptr;
+        Block*         pBlock  = nullptr;
+        uint32_t       node    = TLSF::NONE;
+    };
+
+    struct HeapStats {
+        VkDeviceSize heapSize        = 0;
+        VkDeviceSize blockBytes      = 0;
+        VkDeviceSize usedBytes       = 0;
+        uint         blockCount      = 0;
+        uint         allocationCount = 0;
+        bool         isDeviceLocal   = false;
+    };
+
+    ~MemoryAllocator();
+    MemoryAllocator();
+
+    void cleanup();
+    void create();
+
+    Allocation allocate(VkMemoryRequirements requirements, MemoryUsage usage, bool isImage, bool isTransient = false);
+    void free(Allocation allocation);
+    
+    // No-ops on coherent memory, offset and size are relative to the allocation
+    void flush     (Allocation allocation, VkDeviceSize offset, VkDeviceSize size);
+    void invalidate(Allocation allocation, VkDeviceSize offset, VkDeviceSize size);
+
+    VECTOR<HeapStats> getHeapStats();
+    void logStats();
+    
+    // Bytes of device local blocks held from the driver, the peak since the last reset
+    VkDeviceSize getDeviceBytes();
+    VkDeviceSize getPeakDeviceBytes();
+    void         resetPeakDeviceBytes();
+
+private:
+    Cleaner m_cleaner;
+    Device* m_pDevice;
+
+    VkPhysicalDeviceMemoryProperties m_memoryProperties{};
+    VECTOR<Block*> m_blocks;
+    bool           m_isResizableBAR = false;
+    VkDeviceSize   m_atomSize = 1;
+    VkDeviceSize   m_deviceBytes     = 0;
+    VkDeviceSize   m_peakDeviceBytes = 0;
+    std::mutex     m_mutex;
+
+    Block* createBlock(VkDeviceSize size, uint32_t memoryTypeIndex, Kind kind, bool isImage);
+    void   destroyBlock(Block* pBlock);
+    bool   allocateFrom(Block* pBlock, VkMemoryRequirements requirements, Allocation* pAllocation);
+    bool   allocateType(uint32_t memoryTypeIndex, VkMemoryRequirements requirements, bool isImage, bool isTransient,
+                        Allocation* pAllocation);
+    VECTOR<uint32_t> getMemoryTypes(VkMemoryRequirements requirements, MemoryUsage usage);
+    VkDeviceSize getBlockSize(uint32_t memoryTypeIndex, Kind kind);
+    VkMappedMemoryRange getMappedRange(Allocation allocation, VkDeviceSize offset, VkDeviceSize size);
+
+    const VkDeviceSize GENERAL_BLOCK_SIZE = 64ull << 20;
+    const VkDeviceSize LINEAR_BLOCK_SIZE  = 32ull << 20;
+    const VkDeviceSize BAR_WINDOW_SIZE    = 256ull << 20;
+};
@@ -7,15 +7,38 @@
 
 Pipeline::~Pipeline() {}
 Pipeline::Pipeline()  {}
-void Pipeline::cleanup() { m_cleaner.flush("Pipeline"); }
+// A build still compiling is waited out before its pipeline is destroyed
+void Pipeline::cleanup() {
+    if (m_build.valid()) m_build.wait();
+    m_cleaner.flush("Pipeline");
+}
 
-VkPipeline Pipeline::get() { return m_pipeline; }
+// Resolves a pending build on first use, rethrowing whatever it failed with
+VkPipeline Pipeline::get() {
+    if (m_build.valid()) m_build.get();
+    return m_pipeline;
+}
 
 void Pipeline::setRenderpass(VkRenderPass renderpass) { m_renderpass = renderpass; }
 void Pipeline::setPipelineLayout(VkPipelineLayout pipelineLayout) { m_pipelineLayout = pipelineLayout; }
 void Pipeline::setShaderStages(VECTOR<VkPipelineShaderStageCreateInfo> shaderStages) { m_shaderStages = shaderStages; }
 void Pipeline::setVertexInputInfo(VkPipelineVertexInputStateCreateInfo vertexInputInfo) { m_vertexInputInfo = vertexInputInfo; }
 
+// Ids a stage does not declare are ignored, so every stage can share one info
+void Pipeline::setSpecialization(VECTOR<uint32_t> constants) {
+    m_specializationData = constants;
+    m_specializationEntries.resize(constants.size());
+    for (uint i = 0; i < constants.size(); i++)
+        m_specializationEntries[i] = { i, UINT32(i * sizeof(uint32_t)), sizeof(uint32_t) };
+    
+    m_specializationInfo.mapEntryCount = UINT32(m_specializationEntries.size());
+    m_specializationInfo.pMapEntries   = m_specializationEntries.data();
+    m_specializationInfo.dataSize      = m_specializationData.size() * sizeof(uint32_t);
+    m_specializationInfo.pData         = m_specializationData.data();
+    for (VkPipelineShaderStageCreateInfo& shaderStage : m_shaderStages)
+        shaderStage.pSpecializationInfo = &m_specializationInfo;
+}
+
 void Pipeline::setupViewportInfo() {
     m_viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     m_viewportInfo.viewportCount = 1;
@@ -75,6 +98,35 @@ void Pipeline::setupDepthStencilInfo(VkBool32 enable) {
 
 void Pipeline::createGraphicsPipeline() {
     VkDevice device = System::Device()->getDevice();
+    compileGraphicsPipeline();
+    m_cleaner.push([=](){ vkDestroyPipeline(device, m_pipeline, nullptr); });
+}
+
+void Pipeline::createComputePipeline() {
+    VkDevice device = System::Device()->getDevice();
+    compileComputePipeline();
+    m_cleaner.push([=](){ vkDestroyPipeline(device, m_pipeline, nullptr); });
+}
+
+// Every state the compile reads lives in this object, so the caller only
+// has to keep the shader modules, layout and renderpass until get
+void Pipeline::buildGraphicsPipeline() {
+    VkDevice device = System::Device()->getDevice();
+    m_cleaner.push([=](){ vkDestroyPipeline(device, m_pipeline, nullptr); });
+    m_build = System::ThreadPool()->submit([=](){ compileGraphicsPipeline(); });
+}
+
+void Pipeline::buildComputePipeline() {
+    VkDevice device = System::Device()->getDevice();
+    m_cleaner.push([=](){ vkDestroyPipeline(device, m_pipeline, nullptr); });
+    m_build = System::ThreadPool()->submit([=](){ compileComputePipeline(); });
+}
+
+
+// Private ==================================================
+
+void Pipeline::compileGraphicsPipeline() {
+    VkDevice device = System::Device()->getDevice();
     
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType      = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -92,12 +144,15 @@ void Pipeline::createGraphicsPipeline() {
     pipelineInfo.pDynamicState       = &m_dynamicInfo;
     pipelineInfo.pDepthStencilState  = &m_depthStencilInfo;
     
-    VkResult result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline );
+    TimeVal start = ChronoTime::now();
+    VkResult result = vkCreateGraphicsPipelines(device, System::PipelineCache()->get(), 1, &pipelineInfo, nullptr, &m_pipeline );
     CHECK_VKRESULT(result, "failed to create graphics pipeline!");
-    m_cleaner.push([=](){ vkDestroyPipeline(device, m_pipeline, nullptr); });
+    float time = TimeDif(ChronoTime::now() - start).count();
+    System::PipelineCache()->addCreateTime(time);
+    LOG("Pipeline::compile " << time * 1000.f << "ms");
 }
 
-void Pipeline::createComputePipeline() {
+void Pipeline::compileComputePipeline() {
     VkDevice device = System::Device()->getDevice();
     
     VkComputePipelineCreateInfo pipelineInfo{};
@@ -105,9 +160,12 @@ void Pipeline::createComputePipeline() {
     pipelineInfo.layout = m_pipelineLayout;
     pipelineInfo.stage  = m_shaderStages[0];
     
-    VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline );
-    CHECK_VKRESULT(result, "failed to create graphics pipeline!");
-    m_cleaner.push([=](){ vkDestroyPipeline(device, m_pipeline, nullptr); });
+    TimeVal start = ChronoTime::now();
+    VkResult result = vkCreateComputePipelines(device, System::PipelineCache()->get(), 1, &pipelineInfo, nullptr, &m_pipeline );
+    CHECK_VKRESULT(result, "failed to create compute pipeline!");
+    float time = TimeDif(ChronoTime::now() - start).count();
+    System::PipelineCache()->addCreateTime(time);
+    LOG("Pipeline::compile " << time * 1000.f << "ms");
 }
 
 
@@ -5,6 +5,8 @@
 
 #include "../include.h"
 
+#include <future>
+
 class Pipeline {
     
 public:
@@ -32,6 +34,8 @@ public:
     void setPipelineLayout(VkPipelineLayout pipelineLayout);
     void setShaderStages(VECTOR<VkPipelineShaderStageCreateInfo> shaderStages);
     void setVertexInputInfo(VkPipelineVertexInputStateCreateInfo vertexInputInfo);
+    // One 32 bit value per constant_id in order, given to every stage set before
+    void setSpecialization(VECTOR<uint32_t> constants);
     
     void setupViewportInfo();
     void setupInputAssemblyInfo();
@@ -47,6 +51,9 @@ public:
 
     void createComputePipeline();
     void createGraphicsPipeline();
+    // Compile on the thread pool through the shared cache, get waits for the result
+    void buildComputePipeline();
+    void buildGraphicsPipeline();
     
     VkPipeline get();
     
@@ -55,5 +62,13 @@ private:
     
     VkRenderPass m_renderpass;
     VkPipelineLayout m_pipelineLayout;
-    VkPipeline m_pipeline;
+    VECTOR<uint32_t>                 m_specializationData;
+    VECTOR<VkSpecializationMapEntry> m_specializationEntries;
+    VkSpecializationInfo             m_specializationInfo{};
+    
+    VkPipeline m_pipeline = VK_NULL_HANDLE;
+    std::future<void> m_build;
+    
+    void compileComputePipeline();
+    void compileGraphicsPipeline();
 };
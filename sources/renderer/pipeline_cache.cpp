@@ -0,0 +1,95 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#include "pipeline_cache.hpp"
+
+#include "../system.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+
+PipelineCache::~PipelineCache() {}
+PipelineCache::PipelineCache() : m_pDevice(System::Device()) {}
+
+void PipelineCache::cleanup() { m_cleaner.flush("PipelineCache"); }
+
+void PipelineCache::create() {
+    LOG("PipelineCache::create");
+    VkDevice device = m_pDevice->getDevice();
+    VECTOR<char> data = load();
+    m_isWarm = !data.empty();
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = data.size();
+    cacheInfo.pInitialData    = data.data();
+    VkResult result = vkCreatePipelineCache(device, &cacheInfo, nullptr, &m_pipelineCache);
+    CHECK_VKRESULT(result, "failed to create pipeline cache!");
+    m_cleaner.push([=](){ vkDestroyPipelineCache(device, m_pipelineCache, nullptr); });
+    m_cleaner.push([=](){ save(); });
+    LOG("PipelineCache::create " << (m_isWarm ? "warm, " : "cold, ") << data.size() << " bytes");
+}
+
+// Rename only a complete file so an interrupted write never looks valid
+void PipelineCache::save() {
+    LOG("PipelineCache::save " << m_createCount << " pipelines created in " << m_createTime * 1000.f <<
+        "ms, " << (m_isWarm ? "warm" : "cold"));
+    VkDevice device = m_pDevice->getDevice();
+    size_t size = 0;
+    vkGetPipelineCacheData(device, m_pipelineCache, &size, nullptr);
+    VECTOR<char> data(size);
+    VkResult result = vkGetPipelineCacheData(device, m_pipelineCache, &size, data.data());
+    if (result != VK_SUCCESS || size == 0) return;
+
+    STRING temp = PIPELINE_CACHE_FILE + ".tmp";
+    mkdir(PIPELINE_CACHE_PATH.c_str(), 0755);
+    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+    if (file.is_open()) {
+        file.write(data.data(), size);
+        file.close();
+    }
+    if (!file || std::rename(temp.c_str(), PIPELINE_CACHE_FILE.c_str()) != 0) {
+        ERR("PipelineCache::save failed to write " << PIPELINE_CACHE_FILE);
+        std::remove(temp.c_str());
+        return;
+    }
+    LOG("PipelineCache::saved " << size << " bytes");
+}
+
+VkPipelineCache PipelineCache::get() { return m_pipelineCache; }
+
+void PipelineCache::addCreateTime(float seconds) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_createCount++;
+    m_createTime += seconds;
+}
+
+
+// Private ==================================================
+
+VECTOR<char> PipelineCache::load() {
+    std::ifstream file(PIPELINE_CACHE_FILE, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) return {};
+    VECTOR<char> data(size_t(file.tellg()));
+    file.seekg(0);
+    file.read(data.data(), data.size());
+    if (!file || !isCompatible(data)) return {};
+    return data;
+}
+
+// Data from another GPU or driver is rejected by the header rather than handed to the driver
+bool PipelineCache::isCompatible(const VECTOR<char>& data) {
+    VkPipelineCacheHeaderVersionOne header{};
+    if (data.size() < sizeof(header)) return false;
+    memcpy(&header, data.data(), sizeof(header));
+
+    VkPhysicalDeviceProperties properties = m_pDevice->getDeviceProperties();
+    bool isCompatible = header.headerSize    >= sizeof(header) &&
+                        header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+                        header.vendorID      == properties.vendorID &&
+                        header.deviceID      == properties.deviceID &&
+                        memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    if (!isCompatible) LOG("PipelineCache::load " << PIPELINE_CACHE_FILE << " is from another device or driver");
+    return isCompatible;
+}
@@ -0,0 +1,44 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#pragma once
+
+#include "../include.h"
+#include "device.hpp"
+
+#include <mutex>
+
+const std::string PIPELINE_CACHE_PATH = "resources/cache/";
+const std::string PIPELINE_CACHE_FILE = PIPELINE_CACHE_PATH + "pipelines.bin";
+
+// One VkPipelineCache for every pipeline on the device. The driver's data is
+// loaded at create when its header matches this device and driver, and
+// written back through a temporary file at cleanup, so a warm run skips the
+// shader compiles a cold run pays for.
+class PipelineCache {
+
+public:
+    ~PipelineCache();
+    PipelineCache();
+
+    void cleanup();
+    void create();
+    void save();
+
+    VkPipelineCache get();
+    void addCreateTime(float seconds);
+
+private:
+    Cleaner m_cleaner;
+    Device* m_pDevice;
+
+    VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+    bool            m_isWarm = false;
+
+    uint       m_createCount = 0;
+    float      m_createTime  = 0.f;
+    std::mutex m_mutex;
+
+    VECTOR<char> load();
+    bool isCompatible(const VECTOR<char>& data);
+};
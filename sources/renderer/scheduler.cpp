@@ -0,0 +1,133 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#include "scheduler.hpp"
+
+#include "../system.hpp"
+
+Scheduler::~Scheduler() {}
+Scheduler::Scheduler() : m_pDevice(System::Device()) {}
+
+void Scheduler::cleanup() { m_cleaner.flush("Scheduler"); }
+
+void Scheduler::create(VkQueue queue) {
+    LOG("Scheduler::create");
+    VkDevice device = m_pDevice->getDevice();
+    m_queue = queue;
+    m_pGetSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValueKHR) vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR");
+    m_pWaitSemaphores           = (PFN_vkWaitSemaphoresKHR)           vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR");
+    CHECK_BOOL((m_pGetSemaphoreCounterValue && m_pWaitSemaphores), "timeline semaphores are not available!");
+
+    VkSemaphoreTypeCreateInfoKHR typeInfo{};
+    typeInfo.sType         = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+    typeInfo.initialValue  = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+    VkResult result = vkCreateSemaphore(device, &semaphoreInfo, nullptr, &m_semaphore);
+    CHECK_VKRESULT(result, "failed to create timeline semaphore!");
+    m_cleaner.push([=](){
+        waitIdle();
+        update();
+        vkDestroySemaphore(device, m_semaphore, nullptr);
+    });
+}
+
+// Binary semaphores in the lists take a value slot that the driver ignores,
+// waits on values that are already complete are dropped
+uint64_t Scheduler::submit(VkSubmitInfo submitInfo, VECTOR<Wait> waits) {
+    VECTOR<VkSemaphore> waitSemaphores(submitInfo.pWaitSemaphores,
+                                       submitInfo.pWaitSemaphores + submitInfo.waitSemaphoreCount);
+    VECTOR<VkPipelineStageFlags> waitStages(submitInfo.pWaitDstStageMask,
+                                            submitInfo.pWaitDstStageMask + submitInfo.waitSemaphoreCount);
+    VECTOR<uint64_t> waitValues(submitInfo.waitSemaphoreCount, 0);
+    for (Wait& wait : waits) {
+        if (wait.pScheduler->isComplete(wait.value)) continue;
+        waitSemaphores.push_back(wait.pScheduler->getSemaphore());
+        waitStages.push_back(wait.stage);
+        waitValues.push_back(wait.value);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t value = m_submitted + 1;
+
+    VECTOR<VkSemaphore> signalSemaphores(submitInfo.pSignalSemaphores,
+                                         submitInfo.pSignalSemaphores + submitInfo.signalSemaphoreCount);
+    signalSemaphores.push_back(m_semaphore);
+    VECTOR<uint64_t> signalValues(signalSemaphores.size(), 0);
+    signalValues.back() = value;
+
+    VkTimelineSemaphoreSubmitInfoKHR timelineInfo{};
+    timelineInfo.sType                     = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+    timelineInfo.pNext                     = submitInfo.pNext;
+    timelineInfo.waitSemaphoreValueCount   = UINT32(waitValues.size());
+    timelineInfo.pWaitSemaphoreValues      = waitValues.data();
+    timelineInfo.signalSemaphoreValueCount = UINT32(signalValues.size());
+    timelineInfo.pSignalSemaphoreValues    = signalValues.data();
+
+    submitInfo.pNext                = &timelineInfo;
+    submitInfo.waitSemaphoreCount   = UINT32(waitSemaphores.size());
+    submitInfo.pWaitSemaphores      = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask    = waitStages.data();
+    submitInfo.signalSemaphoreCount = UINT32(signalSemaphores.size());
+    submitInfo.pSignalSemaphores    = signalSemaphores.data();
+    VkResult result = vkQueueSubmit(m_queue, 1, &submitInfo, VK_NULL_HANDLE);
+    CHECK_VKRESULT(result, "failed to submit command buffer!");
+    m_submitted = value;
+    return value;
+}
+
+uint64_t Scheduler::getSubmittedValue() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_submitted;
+}
+
+uint64_t Scheduler::getCompletedValue() {
+    uint64_t value = 0;
+    m_pGetSemaphoreCounterValue(m_pDevice->getDevice(), m_semaphore, &value);
+    return value;
+}
+
+bool Scheduler::isComplete(uint64_t value) { return value == 0 || getCompletedValue() >= value; }
+
+// Blocks on the value alone, deferred work is left to update
+void Scheduler::wait(uint64_t value) {
+    if (isComplete(value)) return;
+    VkSemaphoreWaitInfoKHR waitInfo{};
+    waitInfo.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores    = &m_semaphore;
+    waitInfo.pValues        = &value;
+    m_pWaitSemaphores(m_pDevice->getDevice(), &waitInfo, UINT64_MAX);
+}
+
+void Scheduler::waitIdle() { wait(getSubmittedValue()); }
+
+VkSemaphore Scheduler::getSemaphore() { return m_semaphore; }
+
+void Scheduler::defer(uint64_t value, std::function<void()> work) {
+    if (isComplete(value)) {
+        work();
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_deferred.push_back({ value, work });
+}
+
+// Work is taken off the list before it runs, so it may defer more
+void Scheduler::update() {
+    uint64_t completed = getCompletedValue();
+    VECTOR<std::function<void()>> ready;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::deque<Deferred> deferred;
+        for (Deferred& entry : m_deferred) {
+            if (entry.value <= completed) ready.push_back(entry.work);
+            else                          deferred.push_back(entry);
+        }
+        m_deferred.swap(deferred);
+    }
+    for (std::function<void()>& work : ready) work();
+}
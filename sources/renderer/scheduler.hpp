@@ -0,0 +1,63 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#pragma once
+
+#include "../include.h"
+#include "device.hpp"
+
+#include <deque>
+#include <mutex>
+
+// Orders the work of one queue on a timeline semaphore. Every submit signals
+// the next value, so anything on the CPU that depends on the GPU, waiting,
+// freeing or reusing memory, keys off the value of the submit that last used
+// it instead of a fence or an idle queue.
+class Scheduler {
+
+public:
+    // A value of another queue's timeline the submit waits on at the given stages
+    struct Wait {
+        Scheduler*           pScheduler;
+        uint64_t             value;
+        VkPipelineStageFlags stage;
+    };
+
+    ~Scheduler();
+    Scheduler();
+
+    void cleanup();
+    void create(VkQueue queue);
+
+    // Adds the timeline signal to whatever the submit already waits on and signals
+    uint64_t submit(VkSubmitInfo submitInfo, VECTOR<Wait> waits = {});
+    uint64_t getSubmittedValue();
+    uint64_t getCompletedValue();
+    bool     isComplete(uint64_t value);
+    void     wait(uint64_t value);
+    void     waitIdle();
+    VkSemaphore getSemaphore();
+
+    // Runs from update once the value is reached, right away if it already is
+    void defer(uint64_t value, std::function<void()> work);
+    void update();
+
+private:
+    struct Deferred {
+        uint64_t value;
+        std::function<void()> work;
+    };
+
+    Cleaner m_cleaner;
+    Device* m_pDevice;
+
+    VkQueue     m_queue     = VK_NULL_HANDLE;
+    VkSemaphore m_semaphore = VK_NULL_HANDLE;
+    uint64_t    m_submitted = 0;
+
+    std::deque<Deferred> m_deferred;
+    std::mutex m_mutex;
+
+    PFN_vkGetSemaphoreCounterValueKHR m_pGetSemaphoreCounterValue = nullptr;
+    PFN_vkWaitSemaphoresKHR           m_pWaitSemaphores           = nullptr;
+};
@@ -5,6 +5,8 @@
 
 #include "../system.hpp"
 
+#include <algorithm>
+
 Swapchain::~Swapchain() {}
 Swapchain::Swapchain() : m_pDevice(System::Device()) {}
 
@@ -55,73 +57,72 @@ void Swapchain::create() {
 void Swapchain::createFrames(Renderpass* renderpass) {
     LOG("Swapchain::createFrames");
     VkDevice       device      = m_pDevice->getDevice();
-    Commander*     pCommander  = System::Commander();
     Renderpass*    pRenderpass = renderpass;
     VkSwapchainKHR swapchain   = m_swapchain;
     VkSwapchainCreateInfoKHR swapchainInfo = m_swapchainInfo;
 
+    // Read once, the uniform ring and frame commander are sized for it at startup
+    if (m_framesInFlight == 0) m_framesInFlight = UINT32(std::clamp(System::Settings()->FramesInFlight, 1, 3));
+    
     VECTOR<VkImage> swapchainImages = GetSwapchainImages(swapchain);
-    uint32_t totalFrame = UINT32(swapchainImages.size());
+    uint32_t totalImage = UINT32(swapchainImages.size());
+    uint32_t framesInFlight = m_framesInFlight;
     uint32_t width  = swapchainInfo.imageExtent.width;
     uint32_t height = swapchainInfo.imageExtent.height;
 
-    VECTOR<VkCommandBuffer> commandBuffers = pCommander->createCommandBuffers(totalFrame);
-    VECTOR<VkSemaphore> imageSemaphores(totalFrame);
-    VECTOR<VkSemaphore> submitSemaphores(totalFrame);
-    VECTOR<VkFence>     fences(totalFrame);
-    VECTOR<Frame*>      frames(totalFrame);
+    VECTOR<VkSemaphore> imageSemaphores(framesInFlight);
+    VECTOR<VkSemaphore> submitSemaphores(totalImage);
+    VECTOR<Frame*>      frames(totalImage);
     
     VkSemaphoreCreateInfo semaphoreInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
     
-    for (size_t i = 0; i < totalFrame; i++) {
+    for (size_t i = 0; i < totalImage; i++) {
         frames[i] = new Frame({width, height});
         frames[i]->createImageResource(swapchainImages[i], swapchainInfo.imageFormat);
         frames[i]->createFramebuffer(pRenderpass);
         
-        vkCreateFence(device, &fenceInfo, nullptr, &fences[i]);
-        vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageSemaphores[i]);
         vkCreateSemaphore(device, &semaphoreInfo, nullptr, &submitSemaphores[i]);
 
         m_cleaner.push([=](){ frames[i]->cleanup(); });
-        m_cleaner.push([=](){ vkDestroyFence(device, fences[i], nullptr); });
-        m_cleaner.push([=](){ vkDestroySemaphore(device, imageSemaphores[i], nullptr); });
         m_cleaner.push([=](){ vkDestroySemaphore(device, submitSemaphores[i], nullptr); });
     }
-    m_cleaner.push([=]() { System::Device()->waitAllQueueIdle(); });
+    for (size_t i = 0; i < framesInFlight; i++) {
+        vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageSemaphores[i]);
+        m_cleaner.push([=](){ vkDestroySemaphore(device, imageSemaphores[i], nullptr); });
+    }
+    m_cleaner.push([=]() { System::Scheduler()->waitIdle(); });
+    LOG("Swapchain::createFrames " << framesInFlight << " in flight over " << totalImage << " images");
     
     m_frames = frames;
-    m_totalFrame = totalFrame;
-    m_submitFences = fences;
+    m_totalImage = totalImage;
+    m_frameIdx = 0;
+    m_imageValues = VECTOR<uint64_t>(totalImage, 0);
+    m_frameValues = VECTOR<uint64_t>(framesInFlight, 0);
     m_submitSemaphores = submitSemaphores;
     m_imageSemaphores = imageSemaphores;
-    m_commandBuffers = commandBuffers;
     m_pRenderpass = renderpass;
 }
 
+// The slot's wait bounds how far the CPU runs ahead, the image's wait covers
+// an image still drawn by an older slot when there are fewer images than slots
 void Swapchain::prepareFrame() {
 //    LOG("Swapchain::prepareFrame");
+    System::Scheduler()->wait(m_frameValues[m_frameIdx]);
+    
     VkDevice device = System::Device()->getDevice();
     VkResult result = vkAcquireNextImageKHR(device, m_swapchain,
                                             UINT64_MAX, getImageSemaphore(),
-                                            VK_NULL_HANDLE, &m_frameIdx);
+                                            VK_NULL_HANDLE, &m_imageIdx);
 
     checkSwapchainResult(result);
     
-    VkFence submitFence = getSubmitFence();
-    vkWaitForFences(device, 1, &submitFence, VK_TRUE, UINT64_MAX);
+    System::Scheduler()->wait(m_imageValues[m_imageIdx]);
 }
 
-void Swapchain::submitFrame() {
+uint64_t Swapchain::submitFrame(VkCommandBuffer cmdBuffer, VECTOR<Scheduler::Wait> waits) {
 //    LOG("Swapchain::submitFrame");
-    VkDevice device = m_pDevice->getDevice();
-    VkQueue graphicQueue = m_pDevice->getGraphicQueue();
-    VkFence submitFence  = getSubmitFence();
     VkSemaphore imageSemaphore  = getImageSemaphore();
     VkSemaphore submitSemaphore = getSubmitSemaphore();
-    VkCommandBuffer cmdBuffer   = getCommandBuffer();
     VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
     
     VkSubmitInfo submitInfo{};
@@ -134,9 +135,10 @@ void Swapchain::submitFrame() {
     submitInfo.commandBufferCount   = 1;
     submitInfo.pCommandBuffers      = &cmdBuffer;
     
-    vkResetFences(device, 1, &submitFence);
-    VkResult result = vkQueueSubmit(graphicQueue, 1, &submitInfo, submitFence);
-    CHECK_VKRESULT(result, "failed to submit draw command buffer!");
+    uint64_t value = System::Scheduler()->submit(submitInfo, waits);
+    m_frameValues[m_frameIdx] = value;
+    m_imageValues[m_imageIdx] = value;
+    return value;
 }
 
 void Swapchain::presentFrame() {
@@ -144,8 +146,7 @@ void Swapchain::presentFrame() {
     VkQueue        presentQueue = m_pDevice->getPresentQueue();
     VkSwapchainKHR swapchain = m_swapchain;
     VkSemaphore    submitSemaphore = getSubmitSemaphore();
-    uint frameIdx = m_frameIdx;
-    uint totalFrame = m_totalFrame;
+    uint imageIdx = m_imageIdx;
     
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -153,12 +154,12 @@ void Swapchain::presentFrame() {
     presentInfo.pSwapchains        = &swapchain;
     presentInfo.waitSemaphoreCount = 1;
     presentInfo.pWaitSemaphores    = &submitSemaphore;
-    presentInfo.pImageIndices      = &frameIdx;
+    presentInfo.pImageIndices      = &imageIdx;
 
     VkResult result = vkQueuePresentKHR(presentQueue, &presentInfo);
     checkSwapchainResult(result);
     
-    m_semaphoreIdx = (m_semaphoreIdx + 1) % totalFrame;
+    m_frameIdx = (m_frameIdx + 1) % m_framesInFlight;
 }
 
 void Swapchain::checkSwapchainResult(VkResult result) {
@@ -167,11 +168,13 @@ void Swapchain::checkSwapchainResult(VkResult result) {
     recreate();
 }
 
-Frame* Swapchain::getCurrentFrame() { return m_frames[m_frameIdx]; }
-VkFence Swapchain::getSubmitFence() { return m_submitFences[m_frameIdx]; }
-VkCommandBuffer Swapchain::getCommandBuffer() { return m_commandBuffers[m_frameIdx]; }
-VkSemaphore Swapchain::getImageSemaphore()  { return m_imageSemaphores[m_semaphoreIdx]; }
-VkSemaphore Swapchain::getSubmitSemaphore() { return m_submitSemaphores[m_semaphoreIdx]; }
+Frame* Swapchain::getCurrentFrame() { return m_frames[m_imageIdx]; }
+uint   Swapchain::getImageIdx()   { return m_imageIdx; }
+uint   Swapchain::getTotalImage() { return m_totalImage; }
+uint   Swapchain::getFrameIdx()   { return m_frameIdx; }
+uint   Swapchain::getFramesInFlight() { return m_framesInFlight; }
+VkSemaphore Swapchain::getImageSemaphore()  { return m_imageSemaphores[m_frameIdx]; }
+VkSemaphore Swapchain::getSubmitSemaphore() { return m_submitSemaphores[m_imageIdx]; }
 
 
 // Private ==================================================
@@ -7,6 +7,7 @@
 #include "renderpass.hpp"
 #include "frame.hpp"
 #include "device.hpp"
+#include "scheduler.hpp"
 
 class Swapchain {
     
@@ -23,14 +24,17 @@ public:
     void createFrames(Renderpass* renderpass);
     
     void prepareFrame();
-    void submitFrame();
+    uint64_t submitFrame(VkCommandBuffer cmdBuffer, VECTOR<Scheduler::Wait> waits = {});
     void presentFrame();
     
-    VkFence getSubmitFence();
-    VkCommandBuffer getCommandBuffer();
     VkSemaphore getImageSemaphore();
     VkSemaphore getSubmitSemaphore();
     Frame* getCurrentFrame();
+    uint   getImageIdx();
+    uint   getTotalImage();
+    // Per-frame resources are indexed by the flight slot, not the image
+    uint   getFrameIdx();
+    uint   getFramesInFlight();
     
     VkSwapchainCreateInfoKHR m_swapchainInfo{};
     
@@ -39,15 +43,18 @@ private:
     Device* m_pDevice;
     Renderpass* m_pRenderpass;
     
-    uint m_totalFrame = 0;
+    uint m_totalImage = 0;
+    uint m_imageIdx = 0;
+    uint m_framesInFlight = 0;
     uint m_frameIdx = 0;
-    uint m_semaphoreIdx = 0;
     
-    VECTOR<Frame*>  m_frames;
-    VECTOR<VkFence> m_submitFences;
+    // Per image: its framebuffer, the semaphore present waits on and the submit that last drew to it
+    VECTOR<Frame*>      m_frames;
+    VECTOR<uint64_t>    m_imageValues;
     VECTOR<VkSemaphore> m_submitSemaphores;
+    // Per flight slot: the acquire semaphore and the slot's last submit
+    VECTOR<uint64_t>    m_frameValues;
     VECTOR<VkSemaphore> m_imageSemaphores;
-    VECTOR<VkCommandBuffer> m_commandBuffers;
     
     VkSwapchainKHR m_swapchain;
     
@@ -0,0 +1,123 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#include "texture_heap.hpp"
+
+#include "../system.hpp"
+
+#include <algorithm>
+
+TextureHeap::~TextureHeap() {}
+TextureHeap::TextureHeap() : m_pDevice(System::Device()) {}
+
+void TextureHeap::cleanup() { m_cleaner.flush("TextureHeap"); }
+
+// Partially bound, so slots never written or already removed need no valid view
+void TextureHeap::create(uint capacity) {
+    VkDevice device = m_pDevice->getDevice();
+    m_capacity = std::min(capacity, getMaxCapacity());
+    LOG("TextureHeap::create " << m_capacity);
+
+    VkDescriptorBindingFlagsEXT bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT           |
+                                               VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT         |
+                                               VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT |
+                                               VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo{};
+    bindingFlagsInfo.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    bindingFlagsInfo.bindingCount  = 1;
+    bindingFlagsInfo.pBindingFlags = &bindingFlags;
+
+    VkDescriptorSetLayoutBinding layoutBinding{};
+    layoutBinding.binding         = 0;
+    layoutBinding.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    layoutBinding.descriptorCount = m_capacity;
+    layoutBinding.stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext        = &bindingFlagsInfo;
+    layoutInfo.flags        = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings    = &layoutBinding;
+    VkResult result = vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &m_layout);
+    CHECK_VKRESULT(result, "failed to create texture heap layout!");
+    m_cleaner.push([=](){ vkDestroyDescriptorSetLayout(device, m_layout, nullptr); });
+
+    VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_capacity };
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags         = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+    poolInfo.maxSets       = 1;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes    = &poolSize;
+    result = vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_pool);
+    CHECK_VKRESULT(result, "failed to create texture heap pool!");
+    m_cleaner.push([=](){ vkDestroyDescriptorPool(device, m_pool, nullptr); });
+
+    VkDescriptorSetVariableDescriptorCountAllocateInfoEXT countInfo{};
+    countInfo.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT;
+    countInfo.descriptorSetCount = 1;
+    countInfo.pDescriptorCounts  = &m_capacity;
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.pNext              = &countInfo;
+    allocInfo.descriptorPool     = m_pool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts        = &m_layout;
+    result = vkAllocateDescriptorSets(device, &allocInfo, &m_descriptorSet);
+    CHECK_VKRESULT(result, "failed to allocate texture heap!");
+}
+
+uint TextureHeap::add(VkDescriptorImageInfo* pImageInfo) {
+    uint slot;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_freeSlots.empty()) {
+            slot = m_freeSlots.back();
+            m_freeSlots.pop_back();
+        } else {
+            CHECK_BOOL((m_next < m_capacity), "texture heap is full!");
+            slot = m_next++;
+        }
+    }
+
+    VkWriteDescriptorSet writeSet{};
+    writeSet.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writeSet.dstSet          = m_descriptorSet;
+    writeSet.dstBinding      = 0;
+    writeSet.dstArrayElement = slot;
+    writeSet.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writeSet.descriptorCount = 1;
+    writeSet.pImageInfo      = pImageInfo;
+    vkUpdateDescriptorSets(m_pDevice->getDevice(), 1, &writeSet, 0, nullptr);
+    return slot;
+}
+
+void TextureHeap::remove(uint slot) {
+    Scheduler* pScheduler = System::Scheduler();
+    pScheduler->defer(pScheduler->getSubmittedValue(), [=](){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_freeSlots.push_back(slot);
+    });
+}
+
+VkDescriptorSetLayout TextureHeap::getLayout()        { return m_layout; }
+VkDescriptorSet       TextureHeap::getDescriptorSet() { return m_descriptorSet; }
+
+
+// Private ==================================================
+
+// Update after bind descriptors have limits of their own, often far below the regular ones
+uint TextureHeap::getMaxCapacity() {
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties{};
+    indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &indexingProperties;
+    vkGetPhysicalDeviceProperties2(m_pDevice->getPhysicalDevice(), &properties);
+    return std::min({ indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+                      indexingProperties.maxDescriptorSetUpdateAfterBindSamplers,
+                      indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                      indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers });
+}
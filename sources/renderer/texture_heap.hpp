@@ -0,0 +1,49 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#pragma once
+
+#include "../include.h"
+#include "device.hpp"
+
+#include <mutex>
+
+const uint TEXTURE_HEAP_SIZE = 1024;
+
+// One descriptor set holding every texture, bound once at the set the shader
+// declares its runtime array in. An added view keeps its slot until removed,
+// shaders pick textures by slot index, so changing a material changes an
+// index instead of a descriptor set. Slots are written update after bind,
+// never while a pending submit may still read them.
+class TextureHeap {
+
+public:
+    ~TextureHeap();
+    TextureHeap();
+
+    void cleanup();
+    void create(uint capacity);
+
+    uint add(VkDescriptorImageInfo* pImageInfo);
+    // Call once nothing recorded from now on reads the slot, it is handed
+    // out again after every submit so far has completed
+    void remove(uint slot);
+
+    VkDescriptorSetLayout getLayout();
+    VkDescriptorSet       getDescriptorSet();
+
+private:
+    Cleaner m_cleaner;
+    Device* m_pDevice;
+
+    VkDescriptorSetLayout m_layout        = VK_NULL_HANDLE;
+    VkDescriptorPool      m_pool          = VK_NULL_HANDLE;
+    VkDescriptorSet       m_descriptorSet = VK_NULL_HANDLE;
+
+    uint         m_capacity = 0;
+    uint         m_next     = 0;
+    VECTOR<uint> m_freeSlots;
+    std::mutex   m_mutex;
+
+    uint getMaxCapacity();
+};
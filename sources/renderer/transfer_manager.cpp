@@ -0,0 +1,171 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#include "transfer_manager.hpp"
+
+#include "../system.hpp"
+
+TransferManager::~TransferManager() {}
+TransferManager::TransferManager() : m_pDevice(System::Device()), m_pScheduler(System::Scheduler()) {}
+
+void TransferManager::cleanup() { m_cleaner.flush("TransferManager"); }
+
+void TransferManager::create() {
+    LOG("TransferManager::create");
+    VkDevice device = m_pDevice->getDevice();
+    m_threadId         = std::this_thread::get_id();
+    m_hasTransferQueue = m_pDevice->hasTransferQueue();
+    m_graphicsPool     = createPool(m_pDevice->getGraphicQueueIndex());
+    m_cleaner.push([=](){ vkDestroyCommandPool(device, m_graphicsPool, nullptr); });
+    if (m_hasTransferQueue) {
+        m_transferPool = createPool(m_pDevice->getTransferQueueIndex());
+        m_cleaner.push([=](){ vkDestroyCommandPool(device, m_transferPool, nullptr); });
+    }
+    LOG("TransferManager::create transfer queue " << (m_hasTransferQueue ? "on" : "off"));
+    m_cleaner.push([=](){ wait(submit()); });
+}
+
+bool TransferManager::canRecord() { return std::this_thread::get_id() == m_threadId; }
+
+VkCommandBuffer TransferManager::getCommandBuffer() {
+    if (m_batch.graphicsCmd == VK_NULL_HANDLE) m_batch.graphicsCmd = beginCommandBuffer(m_graphicsPool);
+    return m_batch.graphicsCmd;
+}
+
+// Across families the same barrier releases on the transfer queue and
+// acquires on the graphics queue, the semaphore orders the two halves
+void TransferManager::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size,
+                                 VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    VkBufferCopy copyRegion = { 0, 0, size };
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType  = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.buffer = dstBuffer;
+    barrier.offset = 0;
+    barrier.size   = VK_WHOLE_SIZE;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+    if (!m_hasTransferQueue) {
+        VkCommandBuffer cmdBuffer = getCommandBuffer();
+        vkCmdCopyBuffer(cmdBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = dstAccess;
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0,
+                             0, nullptr, 1, &barrier, 0, nullptr);
+        return;
+    }
+
+    if (m_batch.transferCmd == VK_NULL_HANDLE) m_batch.transferCmd = beginCommandBuffer(m_transferPool);
+    VkCommandBuffer transferCmd = m_batch.transferCmd;
+    vkCmdCopyBuffer(transferCmd, srcBuffer, dstBuffer, 1, &copyRegion);
+    barrier.srcQueueFamilyIndex = m_pDevice->getTransferQueueIndex();
+    barrier.dstQueueFamilyIndex = m_pDevice->getGraphicQueueIndex();
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                         0, nullptr, 1, &barrier, 0, nullptr);
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(getCommandBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage, 0,
+                         0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+// Nothing recorded means the callback only waits on batches already in flight
+void TransferManager::onComplete(std::function<void()> callback) {
+    if (m_batch.graphicsCmd != VK_NULL_HANDLE) m_batch.callbacks.push_back(callback);
+    else                                       m_pScheduler->defer(m_lastTicket, callback);
+}
+
+TransferManager::Ticket TransferManager::submit() {
+    if (m_batch.graphicsCmd == VK_NULL_HANDLE) return m_lastTicket;
+    VkDevice device = m_pDevice->getDevice();
+    Batch batch = m_batch;
+    m_batch = Batch();
+
+    if (batch.transferCmd != VK_NULL_HANDLE) {
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        VkResult result = vkCreateSemaphore(device, &semaphoreInfo, nullptr, &batch.semaphore);
+        CHECK_VKRESULT(result, "failed to create transfer semaphore!");
+        vkEndCommandBuffer(batch.transferCmd);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount   = 1;
+        submitInfo.pCommandBuffers      = &batch.transferCmd;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores    = &batch.semaphore;
+        result = vkQueueSubmit(m_pDevice->getTransferQueue(), 1, &submitInfo, VK_NULL_HANDLE);
+        CHECK_VKRESULT(result, "failed to submit transfer batch!");
+    }
+
+    vkEndCommandBuffer(batch.graphicsCmd);
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers    = &batch.graphicsCmd;
+    if (batch.semaphore != VK_NULL_HANDLE) {
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores    = &batch.semaphore;
+        submitInfo.pWaitDstStageMask  = &waitStage;
+    }
+    m_lastTicket = m_pScheduler->submit(submitInfo);
+    LOG("TransferManager::submit " << m_lastTicket);
+
+    VkCommandPool graphicsPool = m_graphicsPool;
+    VkCommandPool transferPool = m_transferPool;
+    m_pScheduler->defer(m_lastTicket, [=](){
+        for (std::function<void()> callback : batch.callbacks) callback();
+        vkFreeCommandBuffers(device, graphicsPool, 1, &batch.graphicsCmd);
+        if (batch.transferCmd == VK_NULL_HANDLE) return;
+        vkDestroySemaphore(device, batch.semaphore, nullptr);
+        vkFreeCommandBuffers(device, transferPool, 1, &batch.transferCmd);
+    });
+    return m_lastTicket;
+}
+
+bool TransferManager::isComplete(Ticket ticket) { return m_pScheduler->isComplete(ticket); }
+
+void TransferManager::wait(Ticket ticket) {
+    m_pScheduler->wait(ticket);
+    m_pScheduler->update();
+}
+
+void TransferManager::update() { m_pScheduler->update(); }
+
+
+// Private ==================================================
+
+VkCommandPool TransferManager::createPool(uint32_t queueFamilyIndex) {
+    VkDevice device = m_pDevice->getDevice();
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = queueFamilyIndex;
+
+    VkCommandPool commandPool;
+    VkResult result = vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool);
+    CHECK_VKRESULT(result, "failed to create transfer command pool!");
+    return commandPool;
+}
+
+VkCommandBuffer TransferManager::beginCommandBuffer(VkCommandPool commandPool) {
+    VkDevice device = m_pDevice->getDevice();
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = commandPool;
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    VkResult result = vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+    CHECK_VKRESULT(result, "failed to allocate transfer command buffer!");
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    return commandBuffer;
+}
@@ -0,0 +1,65 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#pragma once
+
+#include "../include.h"
+#include "device.hpp"
+#include "scheduler.hpp"
+
+// Collects uploads and layout transitions from the main thread into one batch
+// instead of a submit and queue wait each. Buffer copies run on the dedicated
+// transfer queue when the device has one and are handed to the graphics queue
+// with ownership barriers, everything else is recorded on the graphics side.
+// A batch goes out on submit, or before the next graphics submit through the
+// Commander, and its ticket is the render queue's timeline value for it.
+class TransferManager {
+
+public:
+    typedef uint64_t Ticket;
+
+    ~TransferManager();
+    TransferManager();
+
+    void cleanup();
+    void create();
+
+    // Only the thread that created the manager may record into it
+    bool canRecord();
+
+    // Runs on the graphics queue after the batch's buffer copies
+    VkCommandBuffer getCommandBuffer();
+    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size,
+                    VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+    // Called once everything recorded so far has completed, for freeing sources
+    void onComplete(std::function<void()> callback);
+
+    // Ticket of the submitted batch, or of the last one when nothing was recorded
+    Ticket submit();
+    bool   isComplete(Ticket ticket);
+    void   wait(Ticket ticket);
+    void   update();
+
+private:
+    struct Batch {
+        VkCommandBuffer transferCmd = VK_NULL_HANDLE;
+        VkCommandBuffer graphicsCmd = VK_NULL_HANDLE;
+        VkSemaphore     semaphore   = VK_NULL_HANDLE;
+        VECTOR<std::function<void()>> callbacks;
+    };
+
+    Cleaner    m_cleaner;
+    Device*    m_pDevice;
+    Scheduler* m_pScheduler;
+
+    std::thread::id m_threadId;
+    VkCommandPool   m_graphicsPool = VK_NULL_HANDLE;
+    VkCommandPool   m_transferPool = VK_NULL_HANDLE;
+    bool            m_hasTransferQueue = false;
+
+    Batch  m_batch;
+    Ticket m_lastTicket = 0;
+
+    VkCommandPool   createPool(uint32_t queueFamilyIndex);
+    VkCommandBuffer beginCommandBuffer(VkCommandPool commandPool);
+};
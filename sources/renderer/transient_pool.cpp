@@ -0,0 +1,86 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#include "transient_pool.hpp"
+
+#include "../system.hpp"
+
+TransientPool::~TransientPool() {}
+TransientPool::TransientPool() : m_pDevice(System::Device()) {}
+
+void TransientPool::cleanup() { m_cleaner.flush("TransientPool"); }
+
+void TransientPool::create(STRING name) {
+    LOG("TransientPool::create " << name);
+    m_name = name;
+    m_cleaner.push([=](){
+        MemoryAllocator* pAllocator = System::MemoryAllocator();
+        for (Block* pBlock : m_blocks) {
+            pAllocator->free(pBlock->allocation);
+            delete pBlock;
+        }
+        m_blocks.clear();
+    });
+}
+
+// First fit over the blocks, a block is only added when no freed range is large enough
+TransientPool::Allocation TransientPool::allocate(VkMemoryRequirements requirements) {
+    Allocation allocation;
+    Block* pBlock = nullptr;
+    for (uint i = 0; i < m_blocks.size() && !pBlock; i++) {
+        if (!(requirements.memoryTypeBits & (1u << m_blocks[i]->memoryTypeIndex))) continue;
+        if (!m_blocks[i]->tlsf.allocate(requirements.size, requirements.alignment, &allocation.offset, &allocation.node)) continue;
+        pBlock = m_blocks[i];
+        allocation.block = i;
+    }
+    if (!pBlock) {
+        pBlock = createBlock(requirements);
+        allocation.block = UINT32(m_blocks.size() - 1);
+        bool isAllocated = pBlock->tlsf.allocate(requirements.size, requirements.alignment, &allocation.offset, &allocation.node);
+        CHECK_BOOL(isAllocated, "failed to allocate transient memory!");
+    }
+    
+    allocation.isAliased = allocation.offset < pBlock->highWater;
+    pBlock->highWater    = std::max(pBlock->highWater, allocation.offset + requirements.size);
+    allocation.memory    = pBlock->allocation.memory;
+    allocation.size      = requirements.size;
+    allocation.offset   += pBlock->allocation.offset;
+    
+    m_imageCount++;
+    m_aliasCount     += allocation.isAliased;
+    m_requestedBytes += allocation.size;
+    m_liveBytes      += allocation.size;
+    m_peakBytes       = std::max(m_peakBytes, m_liveBytes);
+    return allocation;
+}
+
+void TransientPool::free(Allocation allocation) {
+    m_blocks[allocation.block]->tlsf.free(allocation.node);
+    m_liveBytes -= allocation.size;
+}
+
+// Requested is what the images would hold with memory of their own all at once
+void TransientPool::report() {
+    VkDeviceSize heldBytes = 0;
+    for (Block* pBlock : m_blocks) heldBytes += pBlock->allocation.size;
+    LOG("TransientPool::report " << m_name << " " << m_imageCount << " images, " << m_aliasCount << " aliased, " <<
+        m_requestedBytes / (1 << 20) << "MB requested, peak live " << m_peakBytes / (1 << 20) << "MB, held " <<
+        heldBytes / (1 << 20) << "MB in " << m_blocks.size() << " blocks");
+}
+
+
+// Private ==================================================
+
+// Large enough to be dedicated memory in the allocator, so every block starts at offset 0
+TransientPool::Block* TransientPool::createBlock(VkMemoryRequirements requirements) {
+    VkMemoryRequirements blockRequirements = requirements;
+    blockRequirements.size = std::max(BLOCK_SIZE, TLSF::AlignUp(requirements.size + requirements.alignment, 1 << 20));
+    LOG("TransientPool::createBlock " << blockRequirements.size);
+
+    Block* pBlock = new Block();
+    pBlock->allocation = System::MemoryAllocator()->allocate(blockRequirements, MEMORY_GPU_ONLY, true);
+    pBlock->memoryTypeIndex = pBlock->allocation.pBlock->memoryTypeIndex;
+    pBlock->tlsf.create(pBlock->allocation.size);
+    m_blocks.push_back(pBlock);
+    return pBlock;
+}
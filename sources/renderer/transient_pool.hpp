@@ -0,0 +1,62 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#pragma once
+
+#include "../include.h"
+#include "device.hpp"
+#include "memory_allocator.hpp"
+
+// Device memory for images that only live inside one precompute job. The job
+// binds a pool to its thread and images marked transient take ranges of the
+// pool's blocks instead of memory of their own. A range freed when an image's
+// lifetime ends goes to the next image that fits, so intermediates that are
+// never alive together alias the same memory. The blocks go back to the
+// allocator together when the job ends.
+class TransientPool {
+
+public:
+    struct Allocation {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize   offset = 0;
+        VkDeviceSize   size   = 0;
+        uint           block  = 0;
+        uint32_t       node   = TLSF::NONE;
+        // The range backed an earlier image whose accesses have to finish first
+        bool           isAliased = false;
+    };
+
+    ~TransientPool();
+    TransientPool();
+
+    void cleanup();
+    void create(STRING name);
+
+    Allocation allocate(VkMemoryRequirements requirements);
+    void free(Allocation allocation);
+    void report();
+
+private:
+    struct Block {
+        MemoryAllocator::Allocation allocation;
+        uint32_t     memoryTypeIndex = 0;
+        VkDeviceSize highWater = 0;
+        TLSF         tlsf;
+    };
+
+    Cleaner m_cleaner;
+    Device* m_pDevice;
+
+    STRING         m_name;
+    VECTOR<Block*> m_blocks;
+
+    uint         m_imageCount     = 0;
+    uint         m_aliasCount     = 0;
+    VkDeviceSize m_requestedBytes = 0;
+    VkDeviceSize m_liveBytes      = 0;
+    VkDeviceSize m_peakBytes      = 0;
+
+    Block* createBlock(VkMemoryRequirements requirements);
+
+    const VkDeviceSize BLOCK_SIZE = 128ull << 20;
+};
@@ -10,13 +10,14 @@ Buffer::Buffer() : m_pDevice(System::Device()) {}
 
 void Buffer::cleanup() { m_cleaner.flush("Buffer"); }
 
-void Buffer::setup(VkDeviceSize size, VkBufferUsageFlags usage) {
+void Buffer::setup(VkDeviceSize size, VkBufferUsageFlags usage, MemoryUsage memoryUsage) {
     VkBufferCreateInfo bufferInfo = GetDefaultBufferCreateInfo();
     
     bufferInfo.size  = size;
     bufferInfo.usage = usage;
     
-    m_bufferInfo = bufferInfo;
+    m_bufferInfo  = bufferInfo;
+    m_memoryUsage = memoryUsage;
 }
 
 void Buffer::create() {
@@ -33,31 +34,25 @@ void Buffer::createBuffer() {
     m_cleaner.push([=](){ vkDestroyBuffer(device, m_buffer, nullptr); });
 }
 
+// Buffers that only take part in copies are staging or readback and go to
+// the allocator's linear blocks
 void Buffer::allocateBufferMemory() {
     LOG("Buffer::allocateBufferMemory");
-    Device*  pDevice = m_pDevice;
     VkDevice device  = m_pDevice->getDevice();
     VkBuffer buffer  = m_buffer;
+    MemoryAllocator* pAllocator = System::MemoryAllocator();
     
     VkMemoryRequirements memoryRequirements;
     vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
     
-    uint32_t memoryTypeIndex = pDevice->findMemoryTypeIndex(memoryRequirements.memoryTypeBits,
-                                                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                                            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    VkBufferUsageFlags transferUsage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bool isTransient = (m_bufferInfo.usage & ~transferUsage) == 0;
+    MemoryAllocator::Allocation allocation = pAllocator->allocate(memoryRequirements, m_memoryUsage,
+                                                                  false, isTransient);
+    vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
     
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize  = memoryRequirements.size;
-    allocInfo.memoryTypeIndex = memoryTypeIndex;
-    
-    VkDeviceMemory bufferMemory;
-    VkResult       result = vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory);
-    CHECK_VKRESULT(result, "failed to allocate buffer memory!");
-    vkBindBufferMemory(device, buffer, bufferMemory, 0);
-    
-    m_bufferMemory = bufferMemory;
-    m_cleaner.push([=](){ vkFreeMemory(device, m_bufferMemory, nullptr); });
+    m_allocation = allocation;
+    m_cleaner.push([=](){ pAllocator->free(m_allocation); });
 }
 
 void Buffer::createDescriptorInfo() {
@@ -88,7 +83,7 @@ void* Buffer::fillBuffer(const void* address, VkDeviceSize size, uint32_t shift)
     void* ptr = mapMemory(size);
     ptr = static_cast<char*>(ptr) + shift;
     memcpy(ptr, address, size);
-    unmapMemory();
+    flush(shift, size);
     return ptr;
 }
 
@@ -96,20 +91,23 @@ void* Buffer::fillBufferFull(const void* address) {
     return fillBuffer(address, static_cast<size_t>(m_bufferInfo.size));
 }
 
+// The allocator keeps host visible blocks mapped, several buffers share one
+// VkDeviceMemory so they can't map it themselves
 void* Buffer::mapMemory(VkDeviceSize size) {
-    void* ptr;
-    VkDevice device = m_pDevice->getDevice();
-    vkMapMemory(device, m_bufferMemory, 0, size, 0, &ptr);
-    return ptr;
+    CHECK_NULLPTR(m_allocation.pMapped, "buffer is not host visible!");
+    return m_allocation.pMapped;
 }
 
-void Buffer::unmapMemory() {
-    VkDevice device = m_pDevice->getDevice();
-    vkUnmapMemory(device, m_bufferMemory);
+void Buffer::flush(VkDeviceSize offset, VkDeviceSize size) {
+    System::MemoryAllocator()->flush(m_allocation, offset, size);
+}
+
+void Buffer::invalidate(VkDeviceSize offset, VkDeviceSize size) {
+    System::MemoryAllocator()->invalidate(m_allocation, offset, size);
 }
 
 VkBuffer       Buffer::get      () { return m_buffer;       }
-VkDeviceMemory Buffer::getBufferMemory() { return m_bufferMemory; }
+VkDeviceMemory Buffer::getBufferMemory() { return m_allocation.memory; }
 VkDeviceSize   Buffer::getBufferSize  () { return m_bufferInfo.size; }
 
 VkDescriptorBufferInfo* Buffer::getDescriptorInfo() { return &m_descriptorInfo; }
@@ -5,6 +5,7 @@
 
 #include "../include.h"
 #include "device.hpp"
+#include "memory_allocator.hpp"
 
 class Buffer {
     
@@ -14,7 +15,7 @@ public:
 
     void cleanup();
     
-    void setup (VkDeviceSize size, VkBufferUsageFlags usage);
+    void setup (VkDeviceSize size, VkBufferUsageFlags usage, MemoryUsage memoryUsage);
     void create();
     
     void createBuffer();
@@ -27,8 +28,19 @@ public:
     void* fillBuffer    (const void* address, VkDeviceSize size, uint32_t shift = 0);
     void* fillBufferFull(const void* address);
     
-    void* mapMemory  (VkDeviceSize size);
-    void  unmapMemory();
+    // Host visible buffers stay mapped for their lifetime, writes through the
+    // pointer are made visible with flush and GPU writes read after invalidate
+    void* mapMemory (VkDeviceSize size);
+    void  flush     (VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+    void  invalidate(VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+    
+    template<typename T> T* getMapped(VkDeviceSize offset = 0) {
+        return reinterpret_cast<T*>(static_cast<unsigned char*>(mapMemory(sizeof(T))) + offset);
+    }
+    template<typename T> void write(const T& value, VkDeviceSize offset = 0) {
+        *getMapped<T>(offset) = value;
+        flush(offset, sizeof(T));
+    }
     
     VkBuffer       get      ();
     VkDeviceSize   getBufferSize  ();
@@ -37,6 +49,7 @@ public:
     
     
     VkBufferCreateInfo m_bufferInfo{};
+    MemoryUsage        m_memoryUsage = MEMORY_UPLOAD;
 
 private:
     Cleaner m_cleaner;
@@ -45,7 +58,7 @@ private:
     unsigned char* m_desc;
     
     VkBuffer         m_buffer         = VK_NULL_HANDLE;
-    VkDeviceMemory   m_bufferMemory   = VK_NULL_HANDLE;
+    MemoryAllocator::Allocation m_allocation;
     VkDescriptorBufferInfo m_descriptorInfo{};
     
     static VkBufferCreateInfo GetDefaultBufferCreateInfo();
@@ -0,0 +1,221 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#include "cubemap_cache.hpp"
+
+#include "../system.hpp"
+#include "buffer.hpp"
+#include "../extensions/ext_ktx2.h"
+
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <sys/stat.h>
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME  1099511628211ULL
+
+CubemapCache::~CubemapCache() {}
+CubemapCache::CubemapCache() : m_pDevice(System::Device()) {}
+
+void CubemapCache::cleanup() { m_cleaner.flush("CubemapCache"); }
+
+void CubemapCache::setup(STRING hdrPath, STRING envPath, uint faceSize, uint mipLevels, VkFormat hdrFormat) {
+    LOG("CubemapCache::setup");
+    uint64_t key = FNV_OFFSET;
+    key = HashFile(hdrPath, key);
+    key = HashFile(envPath, key);
+    key = HashFile(KTX2::GetPath(hdrPath), key);
+    key = HashFile(KTX2::GetPath(envPath), key);
+    key = HashValue(m_pDevice->hasTextureCompressionBC(), key);
+    key = HashValue(faceSize, key);
+    key = HashValue(mipLevels, key);
+    key = HashValue(hdrFormat, key);
+    for (STRING name : SHADER_NAMES)
+        key = HashFile(SPIRV_PATH + name, key);
+    m_key = key;
+}
+
+bool CubemapCache::load(Image*& cubemap, Image*& envMap, Image*& reflMap, Image*& brdfMap) {
+    LOG("CubemapCache::load");
+    TimeVal startTime = ChronoTime::now();
+    STRING  path = getCachePath();
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        LOG("CubemapCache::miss " << path);
+        return false;
+    }
+
+    file.seekg(0, std::ios::end);
+    std::streamoff fileSize = file.tellg();
+    file.seekg(0, std::ios::beg);
+
+    CacheHeader header{};
+    file.read(reinterpret_cast<char*>(&header), sizeof(CacheHeader));
+    if (!file || memcmp(header.magic, CACHE_MAGIC, 4) != 0 ||
+        header.version != CACHE_VERSION || header.key != m_key || header.imageCount != 4) {
+        LOG("CubemapCache::miss stale " << path);
+        return false;
+    }
+
+    VECTOR<Image*>  images;
+    VECTOR<Buffer*> stagingBuffers;
+    for (uint i = 0; i < header.imageCount; i++) {
+        CacheImageHeader imageHeader{};
+        file.read(reinterpret_cast<char*>(&imageHeader), sizeof(CacheImageHeader));
+        if (!file || !IsValidImageHeader(imageHeader)) break;
+        if (fileSize - file.tellg() < std::streamoff(imageHeader.dataSize)) break;
+        images.push_back(createImage(imageHeader));
+
+        Buffer* pStaging = new Buffer();
+        pStaging->setup(imageHeader.dataSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MEMORY_UPLOAD);
+        pStaging->create();
+        file.read(pStaging->getMapped<char>(), imageHeader.dataSize);
+        pStaging->flush();
+        stagingBuffers.push_back(pStaging);
+        if (!file) break;
+    }
+
+    if (stagingBuffers.size() != header.imageCount) {
+        LOG("CubemapCache::miss corrupt " << path);
+        for (Buffer* pStaging : stagingBuffers) pStaging->cleanup();
+        for (Image*  pImage   : images)         pImage->cleanup();
+        return false;
+    }
+
+    Commander* pCommander = System::Commander();
+    VkCommandBuffer cmdBuffer = pCommander->createCommandBuffer();
+    pCommander->beginSingleTimeCommands(cmdBuffer);
+    for (uint i = 0; i < images.size(); i++) {
+        images[i]->cmdTransitionToTransferDst(cmdBuffer);
+        images[i]->cmdCopyBufferToImage(cmdBuffer, stagingBuffers[i]->get(), images[i]->getMipLevels());
+        images[i]->cmdTransitionToShaderR(cmdBuffer);
+    }
+    pCommander->endSingleTimeCommands(cmdBuffer);
+    for (Buffer* pStaging : stagingBuffers) pStaging->cleanup();
+
+    cubemap = images[0];
+    envMap  = images[1];
+    reflMap = images[2];
+    brdfMap = images[3];
+
+    float loadTime = TimeDif(ChronoTime::now() - startTime).count();
+    LOG("CubemapCache::hit " << path << " loaded in " << loadTime <<
+        "s, saved " << header.buildTime - loadTime << "s");
+    return true;
+}
+
+void CubemapCache::save(Image* cubemap, Image* envMap, Image* reflMap, Image* brdfMap, float buildTime) {
+    LOG("CubemapCache::save");
+    STRING path = getCachePath();
+    STRING temp = path + ".tmp";
+    VECTOR<Image*>  images = { cubemap, envMap, reflMap, brdfMap };
+    VECTOR<Buffer*> stagingBuffers;
+
+    Commander* pCommander = System::Commander();
+    VkCommandBuffer cmdBuffer = pCommander->createCommandBuffer();
+    pCommander->beginSingleTimeCommands(cmdBuffer);
+    for (Image* pImage : images) {
+        Buffer* pStaging = new Buffer();
+        pStaging->setup(pImage->getMipChainSize(), VK_BUFFER_USAGE_TRANSFER_DST_BIT, MEMORY_READBACK);
+        pStaging->create();
+        pImage->cmdTransitionToTransferSrc(cmdBuffer);
+        pImage->cmdCopyImageToBuffer(cmdBuffer, pStaging->get());
+        stagingBuffers.push_back(pStaging);
+    }
+    pCommander->endSingleTimeCommands(cmdBuffer);
+
+    mkdir(CACHE_PATH.c_str(), 0755);
+    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+    if (file.is_open()) {
+        CacheHeader header{};
+        memcpy(header.magic, CACHE_MAGIC, 4);
+        header.version    = CACHE_VERSION;
+        header.key        = m_key;
+        header.imageCount = UINT32(images.size());
+        header.buildTime  = buildTime;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(CacheHeader));
+
+        for (uint i = 0; i < images.size(); i++) {
+            VkImageCreateInfo imageInfo = images[i]->getImageInfo();
+            CacheImageHeader imageHeader{};
+            imageHeader.width     = imageInfo.extent.width;
+            imageHeader.height    = imageInfo.extent.height;
+            imageHeader.layers    = imageInfo.arrayLayers;
+            imageHeader.mipLevels = imageInfo.mipLevels;
+            imageHeader.format    = imageInfo.format;
+            imageHeader.dataSize  = stagingBuffers[i]->getBufferSize();
+            file.write(reinterpret_cast<const char*>(&imageHeader), sizeof(CacheImageHeader));
+            stagingBuffers[i]->invalidate();
+            file.write(stagingBuffers[i]->getMapped<char>(), imageHeader.dataSize);
+        }
+        file.close();
+    }
+    for (Buffer* pStaging : stagingBuffers) pStaging->cleanup();
+
+    // Rename only a complete file so an interrupted write never looks valid
+    if (!file || std::rename(temp.c_str(), path.c_str()) != 0) {
+        ERR("CubemapCache::save failed to write " << path);
+        std::remove(temp.c_str());
+        return;
+    }
+    LOG("CubemapCache::saved " << path << " built in " << buildTime << "s");
+}
+
+STRING CubemapCache::getCachePath() {
+    std::stringstream stream;
+    stream << CACHE_PATH << "ibl_" << std::hex << std::setw(16) << std::setfill('0') << m_key << ".bin";
+    return stream.str();
+}
+
+
+// Private ==================================================
+
+Image* CubemapCache::createImage(CacheImageHeader imageHeader) {
+    UInt2D size = { imageHeader.width, imageHeader.height };
+    Image* pImage = new Image();
+    if (imageHeader.layers == 6) pImage->setupForCubemap(size);
+    else                         pImage->setupForHDRTexture(size);
+    pImage->setImageFormat(VkFormat(imageHeader.format));
+    pImage->setMipLevels(imageHeader.mipLevels);
+    pImage->createWithSampler();
+    return pImage;
+}
+
+// Checked before any image is created, so a stale or truncated file allocates nothing
+bool CubemapCache::IsValidImageHeader(CacheImageHeader imageHeader) {
+    UInt2D size = { imageHeader.width, imageHeader.height };
+    if (size.width == 0 || size.height == 0) return false;
+    if (imageHeader.layers != 1 && imageHeader.layers != 6) return false;
+    uint32_t maxMipLevels = UINT32(std::floor(std::log2(std::max(size.width, size.height)))) + 1;
+    if (imageHeader.mipLevels == 0 || imageHeader.mipLevels > maxMipLevels) return false;
+    VkDeviceSize chainSize = Image::GetMipChainSize(VkFormat(imageHeader.format), size,
+                                                    imageHeader.layers, imageHeader.mipLevels);
+    return chainSize != 0 && chainSize == imageHeader.dataSize;
+}
+
+uint64_t CubemapCache::HashFile(STRING path, uint64_t hash) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return HashValue(0, hash);
+
+    VECTOR<char> chunk(1 << 20);
+    while (file) {
+        file.read(chunk.data(), chunk.size());
+        std::streamsize count = file.gcount();
+        for (std::streamsize i = 0; i < count; i++) {
+            hash ^= static_cast<unsigned char>(chunk[i]);
+            hash *= FNV_PRIME;
+        }
+    }
+    return hash;
+}
+
+uint64_t CubemapCache::HashValue(uint64_t value, uint64_t hash) {
+    for (int i = 0; i < 8; i++) {
+        hash ^= (value >> (i * 8)) & 0xff;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
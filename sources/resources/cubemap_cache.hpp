@@ -0,0 +1,71 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#pragma once
+
+#include "../include.h"
+#include "device.hpp"
+#include "image.hpp"
+
+const std::string CACHE_PATH = "resources/cache/";
+
+// Stores the finished IBL images (cubemap, envMap, reflMap, brdfMap) with their
+// full mip chains, keyed on the source hdr content, face size, mip count, the
+// intermediate hdr format and the SPIR-V of every shader in the precompute chain.
+class CubemapCache {
+
+    struct CacheHeader {
+        char     magic[4];
+        uint32_t version;
+        uint64_t key;
+        uint32_t imageCount;
+        float    buildTime;
+    };
+
+    struct CacheImageHeader {
+        uint32_t width;
+        uint32_t height;
+        uint32_t layers;
+        uint32_t mipLevels;
+        uint32_t format;
+        uint64_t dataSize;
+    };
+
+public:
+    ~CubemapCache();
+    CubemapCache();
+
+    void cleanup();
+
+    void setup(STRING hdrPath, STRING envPath, uint faceSize, uint mipLevels, VkFormat hdrFormat);
+    bool load(Image*& cubemap, Image*& envMap, Image*& reflMap, Image*& brdfMap);
+    void save(Image*  cubemap, Image*  envMap, Image*  reflMap, Image*  brdfMap, float buildTime);
+
+    STRING getCachePath();
+
+private:
+    Cleaner m_cleaner;
+    Device* m_pDevice;
+
+    uint64_t m_key = 0;
+
+    Image* createImage(CacheImageHeader imageHeader);
+
+    static bool     IsValidImageHeader(CacheImageHeader imageHeader);
+    static uint64_t HashFile (STRING path, uint64_t hash);
+    static uint64_t HashValue(uint64_t value, uint64_t hash);
+
+private:
+    const uint32_t CACHE_VERSION = 2;
+    const char     CACHE_MAGIC[4] = {'I', 'B', 'L', 'C'};
+    const VECTOR<STRING> SHADER_NAMES = {
+        "hdr_rgba32f.comp.spv",
+        "hdr_rgba16f.comp.spv",
+        "mipmap_rgba16f.comp.spv",
+        "mipmap_rgba32f.comp.spv",
+        "equirect.vert.spv",
+        "equirect.frag.spv",
+        "reflection.vert.spv",
+        "reflection.frag.spv",
+        "brdf.comp.spv" };
+};
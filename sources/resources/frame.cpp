@@ -41,6 +41,7 @@ void Frame::createCubeResource() {
     m_layer = 6;
     m_pColorImage = new Image();
     m_pColorImage->setupForCubemap(m_size);
+    m_pColorImage->setTransient();
     m_pColorImage->createWithSampler();
     m_attachments.push_back(m_pColorImage->getImageView());
     m_cleaner.push([=](){ m_pColorImage->cleanup(); });
@@ -5,8 +5,11 @@
 
 #include "../system.hpp"
 #include "buffer.hpp"
+#include "../pipelines/compute_mipmap.hpp"
 
 #include "../extensions/ext_stb_image.h"
+#include "../extensions/ext_ktx2.h"
+#include "../extensions/ext_tga.h"
 
 Image::~Image() {}
 Image::Image() : m_pDevice(System::Device()),
@@ -58,13 +61,10 @@ void Image::setupForSwapchain(VkImage image, VkFormat imageFormat) {
     m_imageViewInfo.format = imageFormat;
 }
 
+// Pixels are decoded straight into staging by cmdCopyRawDataToImage
 void Image::setupForTexture(const std::string filepath) {
     LOG("Image::setupForTexture");
-    int width, height, channels;
-    m_rawData = STBI::LoadImage(filepath, &width, &height, &channels);
-    m_rawChannel = channels;
-    UInt2D size = { (uint)width, (uint)height };
-    setupForTexture(size);
+    setupForTextureInfo(filepath);
 }
 
 void Image::setupForTexture(UInt2D size) {
@@ -73,19 +73,26 @@ void Image::setupForTexture(UInt2D size) {
     m_imageInfo.format    = VK_FORMAT_R8G8B8A8_SRGB;
     m_imageInfo.usage     = VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
                             VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                            VK_IMAGE_USAGE_STORAGE_BIT |
                             VK_IMAGE_USAGE_SAMPLED_BIT;
+    // Storage is only used through a UNORM view by ComputeMipmap
+    m_imageInfo.flags     = VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT |
+                            VK_IMAGE_CREATE_EXTENDED_USAGE_BIT;
     
     m_imageViewInfo.format = m_imageInfo.format;
     m_imageViewInfo.subresourceRange.levelCount = m_imageInfo.mipLevels;
 }
 
-void Image::setupForHDRTexture(const std::string filepath) {
-    LOG("Image::setupForHDRTexture");
+// Reads only the header, decodeMipChain fills the pixels later
+void Image::setupForTextureInfo(const std::string filepath) {
+    LOG("Image::setupForTextureInfo");
+    if (setupForCompressed(filepath)) return;
     int width, height, channels;
-    m_rawHDR = STBI::LoadHDR(filepath, &width, &height, &channels);
-    m_rawChannel = channels;
+    CHECK_BOOL(STBI::LoadInfo(filepath, &width, &height, &channels), "failed to read texture info!");
+    m_rawChannel = STBI_rgb_alpha;
+    m_filepath   = filepath;
     UInt2D size = { (uint)width, (uint)height };
-    setupForHDRTexture(size);
+    setupForTexture(size);
 }
 
 void Image::setupForHDRTexture(UInt2D size) {
@@ -101,6 +108,45 @@ void Image::setupForHDRTexture(UInt2D size) {
     m_imageViewInfo.subresourceRange.levelCount = m_imageInfo.mipLevels;
 }
 
+// Picks up the .ktx2 written by tools/compress_textures.sh next to filepath,
+// returns false so the caller can fall back to stb when there is none
+bool Image::setupForCompressed(const std::string filepath, bool isHDR) {
+    if (!m_pDevice->hasTextureCompressionBC()) return false;
+    STRING ktxPath = KTX2::GetPath(filepath);
+    KTX2::Info info;
+    if (!KTX2::LoadInfo(ktxPath, &info)) return false;
+    
+    // Encoders tag BC7 as UNORM, the PBR sets have always been sampled as sRGB
+    VkFormat format = info.format;
+    if (!isHDR && format == VK_FORMAT_BC7_UNORM_BLOCK) format = VK_FORMAT_BC7_SRGB_BLOCK;
+    bool isSupported = isHDR ? format == VK_FORMAT_BC6H_UFLOAT_BLOCK || format == VK_FORMAT_BC6H_SFLOAT_BLOCK
+                             : format == VK_FORMAT_BC7_SRGB_BLOCK;
+    isSupported &= info.levels.size() <= MaxMipLevel(info.width, info.height);
+    for (uint i = 0; isSupported && i < info.levels.size(); i++) {
+        uint32_t width  = std::max(info.width  >> i, 1u);
+        uint32_t height = std::max(info.height >> i, 1u);
+        isSupported = info.levels[i].byteLength == GetLevelSize(format, width, height);
+    }
+    if (!isSupported) {
+        LOG("Image::setupForCompressed skipping " << ktxPath);
+        return false;
+    }
+    
+    LOG("Image::setupForCompressed " << ktxPath);
+    m_filepath = filepath;
+    m_imageInfo.extent    = {info.width, info.height, 1};
+    m_imageInfo.mipLevels = UINT32(info.levels.size());
+    m_imageInfo.format    = format;
+    m_imageInfo.usage     = VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                            VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                            VK_IMAGE_USAGE_SAMPLED_BIT;
+    m_imageInfo.flags     = 0;
+    
+    m_imageViewInfo.format = m_imageInfo.format;
+    m_imageViewInfo.subresourceRange.levelCount = m_imageInfo.mipLevels;
+    return true;
+}
+
 void Image::setupForCubemap(UInt2D size) {
     m_imageInfo.extent       = {size.width, size.height, 1};
     m_imageInfo.mipLevels    = 1;
@@ -163,24 +209,31 @@ void Image::createImageViews() {
 
 void Image::allocateImageMemory() {
     LOG("Image::allocateImageMemory");
-    Device*  pDevice = m_pDevice;
     VkDevice device  = m_pDevice->getDevice();
     VkImage  image   = m_image;
+    MemoryAllocator* pAllocator = System::MemoryAllocator();
     
     VkMemoryRequirements memoryRequirements;
     vkGetImageMemoryRequirements(device, image, &memoryRequirements);
-    uint32_t memoryTypeIndex = pDevice->findMemoryTypeIndex(memoryRequirements.memoryTypeBits,
-                                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
     
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize  = memoryRequirements.size;
-    allocInfo.memoryTypeIndex = memoryTypeIndex;
+    TransientPool* pTransientPool = m_isTransient ? System::TransientPool() : nullptr;
+    if (pTransientPool) {
+        TransientPool::Allocation allocation = pTransientPool->allocate(memoryRequirements);
+        vkBindImageMemory(device, image, allocation.memory, allocation.offset);
+        m_allocation.memory = allocation.memory;
+        m_allocation.offset = allocation.offset;
+        m_allocation.size   = allocation.size;
+        m_cleaner.push([=](){ pTransientPool->free(allocation); });
+        if (allocation.isAliased) cmdCall(&Image::cmdAliasBarrier);
+        return;
+    }
+    
+    bool isOptimal = m_imageInfo.tiling == VK_IMAGE_TILING_OPTIMAL;
+    MemoryAllocator::Allocation allocation = pAllocator->allocate(memoryRequirements, MEMORY_GPU_ONLY, isOptimal);
+    vkBindImageMemory(device, image, allocation.memory, allocation.offset);
     
-    VkResult result = vkAllocateMemory(device, &allocInfo, nullptr, &m_imageMemory);
-    CHECK_VKRESULT(result, "failed to allocate image memory!");
-    m_cleaner.push([=](){ vkFreeMemory(device, m_imageMemory, nullptr); });
-    vkBindImageMemory(device, image, m_imageMemory, 0);
+    m_allocation = allocation;
+    m_cleaner.push([=](){ pAllocator->free(m_allocation); });
 }
 
 void Image::createSampler() {
@@ -213,30 +266,100 @@ void Image::createSampler() {
 
 void Image::cmdCopyRawDataToImage() {
     LOG("Image::copyRawDataToImage");
-    Buffer *tempBuffer = new Buffer();
-    tempBuffer->setup(getDeviceSize(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
-    tempBuffer->create();
-    tempBuffer->fillBufferFull(m_rawData);
+    if (IsBlockCompressed(m_imageInfo.format)) {
+        cmdCopyCompressedToImage();
+        return;
+    }
+    StagingArena* pStagingArena = System::StagingArena();
+    StagingArena::Allocation staging = pStagingArena->allocate(getDeviceSize());
+    int width  = m_imageInfo.extent.width;
+    int height = m_imageInfo.extent.height;
+    CHECK_BOOL(STBI::LoadImageInto(m_filepath, staging.pData, width, height), "failed to decode texture!");
+    pStagingArena->flush(staging);
     
-    Commander* pCommander = System::Commander();
-    VkCommandBuffer cmdBuffer = pCommander->createCommandBuffer();
-    pCommander->beginSingleTimeCommands(cmdBuffer);
+    ComputeMipmap* pComputeMipmap = nullptr;
+    if (ComputeMipmap::IsSupported(this)) {
+        pComputeMipmap = new ComputeMipmap();
+        pComputeMipmap->setup(this);
+    }
+    
+    VkCommandBuffer cmdBuffer = beginCommands();
+    cmdTransitionToTransferDst(cmdBuffer);
+    cmdCopyBufferToImage(cmdBuffer, staging.buffer, staging.offset, 0, 1);
+    if (pComputeMipmap) pComputeMipmap->dispatch(cmdBuffer);
+    else                cmdGenerateMipmaps(cmdBuffer);
+    endCommands(cmdBuffer, [=](){
+        pStagingArena->release(staging);
+        if (pComputeMipmap) pComputeMipmap->cleanup();
+    });
+}
+
+// Safe to call from any thread, only touches the file and pDst
+void Image::decodeMipChain(const std::string filepath, unsigned char* pDst) {
+    LOG("Image::decodeMipChain " << filepath);
+    VECTOR<VkBufferImageCopy> regions = getMipCopyRegions(m_imageInfo.mipLevels);
+    uint channelSize = getChannelSize();
+    
+    // Mips come precomputed in the container, copy them straight in
+    if (IsBlockCompressed(m_imageInfo.format)) {
+        STRING ktxPath = KTX2::GetPath(filepath);
+        VECTOR<VkDeviceSize> offsets;
+        for (VkBufferImageCopy region : regions) offsets.push_back(region.bufferOffset);
+        KTX2::Info info;
+        bool isLoaded = KTX2::LoadInfo(ktxPath, &info) && info.levels.size() == regions.size() &&
+                        KTX2::LoadLevels(ktxPath, info, pDst, offsets);
+        CHECK_BOOL(isLoaded, "failed to read compressed texture!");
+        return;
+    }
+    
+    int width, height, channels;
+    unsigned char* pData = STBI::LoadImage(filepath, &width, &height, &channels);
+    CHECK_NULLPTR(pData, "failed to decode texture!");
+    if (width != m_imageInfo.extent.width || height != m_imageInfo.extent.height) {
+        STBI::FreeImage(pData);
+        RUNTIME_ERROR("texture size changed while decoding!");
+    }
+    
+    // Staging memory is slow to read back, the chain is built from the
+    // decoded copy and that copy is dropped as soon as level 1 exists
+    UInt2D srcSize = { (uint)width, (uint)height };
+    memcpy(pDst, pData, srcSize.width * srcSize.height * channelSize);
+    const unsigned char* pSrc = pData;
+    VECTOR<unsigned char> src;
+    VECTOR<unsigned char> dst;
+    for (uint i = 1; i < regions.size(); i++) {
+        UInt2D dstSize = { regions[i].imageExtent.width, regions[i].imageExtent.height };
+        dst.resize(dstSize.width * dstSize.height * channelSize);
+        DownsampleSRGB(pSrc, srcSize, dst.data(), dstSize);
+        memcpy(pDst + regions[i].bufferOffset, dst.data(), dst.size());
+        if (i == 1) STBI::FreeImage(pData);
+        std::swap(src, dst);
+        pSrc    = src.data();
+        srcSize = dstSize;
+    }
+    if (regions.size() == 1) STBI::FreeImage(pData);
+}
+
+void Image::cmdCopyCompressedToImage() {
+    LOG("Image::cmdCopyCompressedToImage");
+    StagingArena* pStagingArena = System::StagingArena();
+    StagingArena::Allocation staging = pStagingArena->allocate(getMipChainSize());
+    decodeMipChain(m_filepath, staging.pData);
+    pStagingArena->flush(staging);
+    
+    VkCommandBuffer cmdBuffer = beginCommands();
     cmdTransitionToTransferDst(cmdBuffer);
-    cmdCopyBufferToImage(cmdBuffer, tempBuffer->get());
-    cmdGenerateMipmaps(cmdBuffer);
-    pCommander->endSingleTimeCommands(cmdBuffer);
-    tempBuffer->cleanup();
+    cmdCopyBufferToImage(cmdBuffer, staging.buffer, staging.offset, 0, m_imageInfo.mipLevels);
+    endCommands(cmdBuffer, [=](){ pStagingArena->release(staging); });
 }
 
 void Image::cmdClearColorImage(VkClearColorValue clearColor) {
     LOG("Image::cmdClearColorImage");
-    Commander*      pCommander = System::Commander();
-    VkCommandBuffer cmdBuffer  = pCommander->createCommandBuffer();
-    pCommander->beginSingleTimeCommands(cmdBuffer);
+    VkCommandBuffer cmdBuffer = beginCommands();
     cmdTransitionToTransferDst(cmdBuffer);
     vkCmdClearColorImage(cmdBuffer, m_image, m_imageLayout,
                          &clearColor, 1, &m_imageViewInfo.subresourceRange);
-    pCommander->endSingleTimeCommands(cmdBuffer);
+    endCommands(cmdBuffer);
 }
 
 void Image::cmdCopyImageToImage(VkCommandBuffer cmdBuffer, Image* pSrcImage) {
@@ -296,6 +419,45 @@ void Image::cmdCopyBufferToImage(VkCommandBuffer cmdBuffer, VkBuffer buffer) {
                            1, &region);
 }
 
+void Image::cmdCopyBufferToImage(VkCommandBuffer cmdBuffer, VkBuffer buffer, uint mipLevels) {
+    LOG("Image::cmdCopyBufferToImage");
+    VkImage image = m_image;
+    VECTOR<VkBufferImageCopy> regions = getMipCopyRegions(mipLevels);
+    
+    vkCmdCopyBufferToImage(cmdBuffer,
+                           buffer,
+                           image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           UINT32(regions.size()), regions.data());
+}
+
+void Image::cmdCopyBufferToImage(VkCommandBuffer cmdBuffer, VkBuffer buffer, VkDeviceSize offset, uint baseMip, uint levelCount) {
+    LOG("Image::cmdCopyBufferToImage");
+    VkImage image = m_image;
+    VECTOR<VkBufferImageCopy> regions = getMipCopyRegions(baseMip + levelCount);
+    regions.erase(regions.begin(), regions.begin() + baseMip);
+    for (VkBufferImageCopy& region : regions) region.bufferOffset += offset;
+    
+    vkCmdCopyBufferToImage(cmdBuffer,
+                           buffer,
+                           image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           UINT32(regions.size()), regions.data());
+}
+
+void Image::cmdCopyImageToBuffer(VkCommandBuffer cmdBuffer, VkBuffer buffer) {
+    LOG("Image::cmdCopyImageToBuffer");
+    VkImage image = m_image;
+    VECTOR<VkBufferImageCopy> regions = getMipCopyRegions(m_imageInfo.mipLevels);
+    
+    vkCmdCopyImageToBuffer(cmdBuffer,
+                           image,
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           buffer,
+                           UINT32(regions.size()), regions.data());
+}
+
+// Blit chain, kept as the fallback for images ComputeMipmap can't take
 void Image::cmdGenerateMipmaps(VkCommandBuffer cmdBuffer) {
     LOG("Image::cmdGenerateMipmaps");
     VkPhysicalDevice      physicalDevice = m_pDevice->getPhysicalDevice();;
@@ -414,6 +576,27 @@ void Image::cmdTransitionToTransferSrc(VkCommandBuffer cmdBuffer) {
                     VK_PIPELINE_STAGE_TRANSFER_BIT);
 }
 
+// Only the given range leaves TRANSFER_DST, views starting at baseMip become usable
+void Image::cmdTransitionMipsToShaderR(VkCommandBuffer cmdBuffer, uint baseMip, uint levelCount) {
+    VkImageMemoryBarrier barrier = GetDefaultImageMemoryBarrier();
+    barrier.image         = m_image;
+    barrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.subresourceRange.baseMipLevel = baseMip;
+    barrier.subresourceRange.levelCount   = levelCount;
+    barrier.subresourceRange.layerCount   = m_imageInfo.arrayLayers;
+    
+    m_imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    vkCmdPipelineBarrier(cmdBuffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                         0, nullptr,
+                         0, nullptr,
+                         1, &barrier);
+}
+
 void Image::cmdChangeLayout(VkCommandBuffer cmdBuffer,
                             VkImageLayout newLayout,
                             VkAccessFlags dstAccess,
@@ -434,6 +617,20 @@ void Image::cmdChangeLayout(VkCommandBuffer cmdBuffer,
                          1, &barrier);
 }
 
+// Whatever the images that held the memory before did has to finish before this one touches it
+void Image::cmdAliasBarrier(VkCommandBuffer cmdBuffer) {
+    VkMemoryBarrier barrier{};
+    barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    vkCmdPipelineBarrier(cmdBuffer,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+                         1, &barrier,
+                         0, nullptr,
+                         0, nullptr);
+}
+
 void Image::cmdTransitionToShaderR    () { cmdCall(&Image::cmdTransitionToShaderR);     }
 void Image::cmdTransitionToPresent    () { cmdCall(&Image::cmdTransitionToPresent);     }
 void Image::cmdTransitionToStorageW   () { cmdCall(&Image::cmdTransitionToStorageW);    }
@@ -454,7 +651,7 @@ VkDescriptorImageInfo* Image::getDescriptorInfo() {
 
 VkImageView     Image::getImageView  (uint idx) { return m_imageViews[idx]; }
 VkImage         Image::getImage      () { return m_image;       }
-VkDeviceMemory  Image::getImageMemory() { return m_imageMemory; }
+VkDeviceMemory  Image::getImageMemory() { return m_allocation.memory; }
 VkSampler       Image::getSampler    () { return m_sampler;     }
 uint            Image::getRawChannel () { return m_rawChannel;  }
 uint            Image::getChannelSize() { return GetChannelSize(m_imageInfo.format); }
@@ -462,13 +659,15 @@ uint            Image::getMipLevels  () { return m_imageInfo.mipLevels; }
 UInt2D          Image::getImageSize  () { return {m_imageInfo.extent.width, m_imageInfo.extent.height}; }
 VkDeviceSize    Image::getDeviceSize () { return m_imageInfo.extent.width * m_imageInfo.extent.height * getChannelSize() * m_imageInfo.arrayLayers; }
 
+VkDeviceSize Image::getMipChainSize() {
+    UInt2D size = { m_imageInfo.extent.width, m_imageInfo.extent.height };
+    return GetMipChainSize(m_imageInfo.format, size, m_imageInfo.arrayLayers, m_imageInfo.mipLevels);
+}
+
 VkImageLayout         Image::getImageLayout()   { return m_imageLayout; }
 VkImageCreateInfo     Image::getImageInfo()     { return m_imageInfo; }
 VkImageViewCreateInfo Image::getImageViewInfo() { return m_imageViewInfo; }
 
-unsigned char* Image::getRawData() { return m_rawData; }
-float        * Image::getRawHDR()  { return m_rawHDR;  }
-
 void Image::setMipLevels(uint mipLevels) { m_imageInfo.mipLevels = mipLevels; }
 void Image::setImageLayout(VkImageLayout imageLayout) { m_imageLayout = imageLayout; }
 void Image::setImageFormat(VkFormat format) {
@@ -476,31 +675,192 @@ void Image::setImageFormat(VkFormat format) {
     m_imageViewInfo.format = format;
 }
 
+// Queues of more than one family use the image without ownership transfers
+void Image::setTransient() { m_isTransient = true; }
+
+void Image::setQueueFamilies(VECTOR<uint32_t> queueFamilyIndices) {
+    m_queueFamilyIndices = queueFamilyIndices;
+    if (m_queueFamilyIndices.size() < 2) return;
+    m_imageInfo.sharingMode           = VK_SHARING_MODE_CONCURRENT;
+    m_imageInfo.queueFamilyIndexCount = UINT32(m_queueFamilyIndices.size());
+    m_imageInfo.pQueueFamilyIndices   = m_queueFamilyIndices.data();
+}
+
 
 // Private ==================================================
 
 void Image::cmdCall(void (Image::*cmdFunc)(VkCommandBuffer)) {
+    VkCommandBuffer cmdBuffer = beginCommands();
+    (this->*cmdFunc)(cmdBuffer);
+    endCommands(cmdBuffer);
+}
+
+// The main thread records into the open transfer batch, other threads submit and wait
+VkCommandBuffer Image::beginCommands() {
+    TransferManager* pTransferManager = System::TransferManager();
+    if (pTransferManager && pTransferManager->canRecord()) return pTransferManager->getCommandBuffer();
     Commander*      pCommander = System::Commander();
     VkCommandBuffer cmdBuffer  = pCommander->createCommandBuffer();
     pCommander->beginSingleTimeCommands(cmdBuffer);
-    (this->*cmdFunc)(cmdBuffer);
-    pCommander->endSingleTimeCommands(cmdBuffer);
+    return cmdBuffer;
+}
+
+// onComplete runs once the commands have executed on the GPU
+void Image::endCommands(VkCommandBuffer cmdBuffer, std::function<void()> onComplete) {
+    TransferManager* pTransferManager = System::TransferManager();
+    if (pTransferManager && pTransferManager->canRecord()) {
+        if (onComplete) pTransferManager->onComplete(onComplete);
+        return;
+    }
+    System::Commander()->endSingleTimeCommands(cmdBuffer);
+    if (onComplete) onComplete();
+}
+
+// Mip levels are packed one after another, all layers of a level are contiguous
+VECTOR<VkBufferImageCopy> Image::getMipCopyRegions(uint mipLevels) {
+    VkImageCreateInfo imageInfo = m_imageInfo;
+    
+    VECTOR<VkBufferImageCopy> regions(mipLevels);
+    VkDeviceSize offset = 0;
+    for (uint i = 0; i < mipLevels; i++) {
+        uint32_t width  = std::max(imageInfo.extent.width  >> i, 1u);
+        uint32_t height = std::max(imageInfo.extent.height >> i, 1u);
+        regions[i] = {};
+        regions[i].bufferOffset = offset;
+        regions[i].imageOffset  = {0, 0, 0};
+        regions[i].imageExtent  = {width, height, 1};
+        regions[i].imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+        regions[i].imageSubresource.mipLevel       = i;
+        regions[i].imageSubresource.baseArrayLayer = 0;
+        regions[i].imageSubresource.layerCount     = imageInfo.arrayLayers;
+        offset += GetLevelSize(imageInfo.format, width, height) * imageInfo.arrayLayers;
+    }
+    return regions;
+}
+
+// Red channel of each source lands in r, g, b of the output, alpha is opaque.
+// Sources are decoded on the thread pool and the packing is queued behind them,
+// so the caller does not block and the pack task only waits on decodes a worker
+// has already taken. A failed pack rethrows from the future.
+std::future<void> Image::PackChannels(VECTOR<STRING> srcPaths, const std::string dstPath) {
+    ThreadPool* pThreadPool = System::ThreadPool();
+    VECTOR<std::shared_future<unsigned char*>> decodes;
+    std::shared_ptr<VECTOR<UInt2D>> pSizes = std::make_shared<VECTOR<UInt2D>>(srcPaths.size());
+    for (uint i = 0; i < srcPaths.size(); i++) {
+        STRING path = srcPaths[i];
+        decodes.push_back(pThreadPool->submit([=](){
+            int width, height, channels;
+            unsigned char* pData = STBI::LoadImage(path, &width, &height, &channels);
+            (*pSizes)[i] = { (uint)width, (uint)height };
+            return pData;
+        }).share());
+    }
+    
+    TimeVal startTime = ChronoTime::now();
+    return pThreadPool->submit([=](){
+        VECTOR<unsigned char*> pSources;
+        for (const std::shared_future<unsigned char*>& decode : decodes) pSources.push_back(decode.get());
+        
+        VECTOR<UInt2D>& sizes = *pSizes;
+        bool isValid = !srcPaths.empty() && srcPaths.size() <= 3;
+        for (uint i = 0; i < pSources.size(); i++) {
+            isValid &= pSources[i] != nullptr &&
+                       sizes[i].width == sizes[0].width && sizes[i].height == sizes[0].height;
+        }
+        VECTOR<unsigned char> packed;
+        if (isValid) {
+            packed.resize(size_t(sizes[0].width) * sizes[0].height * 4, 0xff);
+            for (uint c = 0; c < pSources.size(); c++) {
+                for (size_t i = 0; i < packed.size(); i += 4) packed[i + c] = pSources[c][i];
+            }
+        }
+        for (unsigned char* pData : pSources) {
+            if (pData) STBI::FreeImage(pData);
+        }
+        CHECK_BOOL(isValid, "failed to pack textures, sources missing or of different size!");
+        bool isWritten = TGA::WriteImage(dstPath, sizes[0].width, sizes[0].height, packed.data());
+        CHECK_BOOL(isWritten, "failed to write packed texture!");
+        LOG("Image::PackChannels " << dstPath << " in " << TimeDif(ChronoTime::now() - startTime).count() << "s");
+    });
+}
+
+// Tightly packed levels in the order of getMipCopyRegions
+VkDeviceSize Image::GetMipChainSize(VkFormat format, UInt2D size, uint32_t layers, uint32_t mipLevels) {
+    VkDeviceSize chainSize = 0;
+    for (uint i = 0; i < mipLevels; i++) {
+        uint32_t width  = std::max(size.width  >> i, 1u);
+        uint32_t height = std::max(size.height >> i, 1u);
+        chainSize += GetLevelSize(format, width, height) * layers;
+    }
+    return chainSize;
 }
 
 uint32_t Image::MaxMipLevel(int width, int height) {
-    return fmin(UINT32(std::floor(std::log2(std::max(width, height)))) + 1, 7);
+    return UINT32(std::floor(std::log2(std::max(width, height)))) + 1;
 }
 
 unsigned int Image::GetChannelSize(VkFormat format) {
     switch (format) {
         case VK_FORMAT_R8G8B8_SRGB  : return 3; break;
         case VK_FORMAT_R8G8B8A8_SRGB: return 4; break;
+        case VK_FORMAT_R8G8B8A8_UNORM: return 4; break;
+        case VK_FORMAT_R16G16B16A16_SFLOAT: return 8; break;
         case VK_FORMAT_R32G32B32_SFLOAT: return 12; break;
         case VK_FORMAT_R32G32B32A32_SFLOAT: return 16; break;
         default: return 0; break;
     }
 }
 
+bool Image::IsBlockCompressed(VkFormat format) {
+    return format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+}
+
+// BC levels are stored in 4x4 blocks, partial blocks at the edges still take a full one
+VkDeviceSize Image::GetLevelSize(VkFormat format, uint32_t width, uint32_t height) {
+    if (!IsBlockCompressed(format)) return VkDeviceSize(width) * height * GetChannelSize(format);
+    bool isHalfBlock = format <= VK_FORMAT_BC1_RGBA_SRGB_BLOCK ||
+                       format == VK_FORMAT_BC4_UNORM_BLOCK || format == VK_FORMAT_BC4_SNORM_BLOCK;
+    return VkDeviceSize((width + 3) / 4) * ((height + 3) / 4) * (isHalfBlock ? 8 : 16);
+}
+
+// 2x2 box filter in linear space, alpha is averaged as is
+void Image::DownsampleSRGB(const unsigned char* pSrc, UInt2D srcSize, unsigned char* pDst, UInt2D dstSize) {
+    static float toLinear[256];
+    static unsigned char toSRGB[4096];
+    static bool initialized = [](){
+        for (int i = 0; i < 256; i++) {
+            float c = i / 255.f;
+            toLinear[i] = c <= 0.04045f ? c / 12.92f : pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        for (int i = 0; i < 4096; i++) {
+            float c = i / 4095.f;
+            c = c <= 0.0031308f ? c * 12.92f : 1.055f * pow(c, 1.f / 2.4f) - 0.055f;
+            toSRGB[i] = (unsigned char)(std::min(std::max(c, 0.f), 1.f) * 255.f + 0.5f);
+        }
+        return true;
+    }();
+    (void)initialized;
+    
+    for (uint y = 0; y < dstSize.height; y++) {
+        uint y0 = std::min(y * 2, srcSize.height - 1);
+        uint y1 = std::min(y * 2 + 1, srcSize.height - 1);
+        for (uint x = 0; x < dstSize.width; x++) {
+            uint x0 = std::min(x * 2, srcSize.width - 1);
+            uint x1 = std::min(x * 2 + 1, srcSize.width - 1);
+            const unsigned char* p00 = pSrc + (y0 * srcSize.width + x0) * 4;
+            const unsigned char* p01 = pSrc + (y0 * srcSize.width + x1) * 4;
+            const unsigned char* p10 = pSrc + (y1 * srcSize.width + x0) * 4;
+            const unsigned char* p11 = pSrc + (y1 * srcSize.width + x1) * 4;
+            unsigned char* pOut = pDst + (y * dstSize.width + x) * 4;
+            for (int c = 0; c < 3; c++) {
+                float linear = (toLinear[p00[c]] + toLinear[p01[c]] + toLinear[p10[c]] + toLinear[p11[c]]) * 0.25f;
+                pOut[c] = toSRGB[UINT32(linear * 4095.f + 0.5f)];
+            }
+            pOut[3] = (unsigned char)((p00[3] + p01[3] + p10[3] + p11[3] + 2) / 4);
+        }
+    }
+}
+
 VkImageCreateInfo Image::GetDefaultImageCreateInfo() {
     VkImageCreateInfo imageInfo{};
     imageInfo.sType     = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
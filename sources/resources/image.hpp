@@ -5,6 +5,10 @@
 
 #include "../include.h"
 #include "device.hpp"
+#include "memory_allocator.hpp"
+#include "transient_pool.hpp"
+
+#include <future>
 
 class Image {
     
@@ -21,8 +25,9 @@ public:
     
     void setupForTexture    (const std::string filepath);
     void setupForTexture    (UInt2D size);
-    void setupForHDRTexture (const std::string filepath);
+    void setupForTextureInfo(const std::string filepath);
     void setupForHDRTexture (UInt2D size);
+    bool setupForCompressed (const std::string filepath, bool isHDR = false);
     void setupForCubemap    (UInt2D size);
     
     void create             ();
@@ -35,6 +40,8 @@ public:
     void createSampler      ();
     
     void cmdCopyRawDataToImage();
+    void cmdCopyCompressedToImage();
+    void decodeMipChain       (const std::string filepath, unsigned char* pDst);
     void cmdClearColorImage   (VkClearColorValue clearColor = {0., 0., 0., 1.});
     
     void cmdTransitionToShaderR();
@@ -49,6 +56,7 @@ public:
     void cmdTransitionToTransferDst(VkCommandBuffer cmdBuffer);
     void cmdTransitionToTransferSrc();
     void cmdTransitionToTransferSrc(VkCommandBuffer cmdBuffer);
+    void cmdTransitionMipsToShaderR(VkCommandBuffer cmdBuffer, uint baseMip, uint levelCount);
     
     void cmdChangeLayout(VkCommandBuffer cmdBuffer,
                          VkImageLayout newLayout,
@@ -59,6 +67,9 @@ public:
     void cmdCopyImageToImage (VkCommandBuffer cmdBuffer, Image* pSrcImage, VkExtent3D extent, uint srcMipLevel = 0, uint dstMipLevel = 0);
     void cmdCopyImageToImage (VkCommandBuffer cmdBuffer, Image* pSrcImage);
     void cmdCopyBufferToImage(VkCommandBuffer cmdBuffer, VkBuffer buffer);
+    void cmdCopyBufferToImage(VkCommandBuffer cmdBuffer, VkBuffer buffer, uint mipLevels);
+    void cmdCopyBufferToImage(VkCommandBuffer cmdBuffer, VkBuffer buffer, VkDeviceSize offset, uint baseMip, uint levelCount);
+    void cmdCopyImageToBuffer(VkCommandBuffer cmdBuffer, VkBuffer buffer);
     void cmdGenerateMipmaps  (VkCommandBuffer cmdBuffer);
     
     VkImageView      getImageView  (uint idx = 0);
@@ -66,6 +77,7 @@ public:
     VkDeviceMemory   getImageMemory();
     UInt2D           getImageSize  ();
     VkDeviceSize     getDeviceSize ();
+    VkDeviceSize     getMipChainSize();
     VkSampler        getSampler    ();
     uint             getRawChannel ();
     uint             getChannelSize();
@@ -76,39 +88,50 @@ public:
     VkImageCreateInfo     getImageInfo();
     VkImageViewCreateInfo getImageViewInfo();
     
-    unsigned char* getRawData();
-    float        * getRawHDR();
+    static std::future<void> PackChannels(VECTOR<STRING> srcPaths, const std::string dstPath);
+    static VkDeviceSize GetMipChainSize(VkFormat format, UInt2D size, uint32_t layers, uint32_t mipLevels);
     
     void setMipLevels(uint mipLevels);
     void setImageLayout(VkImageLayout imageLayout);
     void setImageFormat(VkFormat format);
+    void setQueueFamilies(VECTOR<uint32_t> queueFamilyIndices);
+    // Takes memory from the thread's transient pool when a precompute job has one
+    void setTransient();
     
 private:
     Cleaner m_cleaner;
     Device* m_pDevice;
     
-    uint m_rawChannel;
-    unsigned char* m_rawData;
-    float        * m_rawHDR;
+    uint        m_rawChannel;
+    std::string m_filepath;
 
     VkImage          m_image          = VK_NULL_HANDLE;
-    VkDeviceMemory   m_imageMemory    = VK_NULL_HANDLE;
+    MemoryAllocator::Allocation m_allocation;
     VECTOR<VkImageView> m_imageViews;
     
     VkImageLayout         m_imageLayout;
     VkImageCreateInfo     m_imageInfo{};
     VkImageViewCreateInfo m_imageViewInfo{};
     VECTOR<VkDescriptorImageInfo> m_descriptorInfos;
+    VECTOR<uint32_t>              m_queueFamilyIndices;
+    bool                          m_isTransient = false;
 
     // For Texture
     VkSampler m_sampler = VK_NULL_HANDLE;
     
     uint32_t MaxMipLevel(int width, int height);
     static unsigned int GetChannelSize(VkFormat format);
+    static bool         IsBlockCompressed(VkFormat format);
+    static VkDeviceSize GetLevelSize(VkFormat format, uint32_t width, uint32_t height);
+    static void DownsampleSRGB(const unsigned char* pSrc, UInt2D srcSize, unsigned char* pDst, UInt2D dstSize);
     static VkImageCreateInfo     GetDefaultImageCreateInfo();
     static VkImageViewCreateInfo GetDefaultImageViewCreateInfo();
     static VkImageMemoryBarrier  GetDefaultImageMemoryBarrier();
     
     void cmdCall(void (Image::*cmdFunc)(VkCommandBuffer));
+    void cmdAliasBarrier(VkCommandBuffer cmdBuffer);
+    VkCommandBuffer beginCommands();
+    void            endCommands(VkCommandBuffer cmdBuffer, std::function<void()> onComplete = nullptr);
+    VECTOR<VkBufferImageCopy> getMipCopyRegions(uint mipLevels);
     
 };
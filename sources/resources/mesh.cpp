@@ -9,6 +9,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <unordered_map>
+#include <fstream>
+#include <sys/stat.h>
 
 #include "../libraries/tiny_obj_loader/tiny_obj_loader.h"
 
@@ -25,17 +27,19 @@ void Mesh::cleanup() {
 }
 
 void Mesh::createPlane() {
-    m_positions = {{-1., 0., 1.}, {1., 0., 1.}, {1., 0., -1.}, {-1., 0., -1.}};
-    m_normals   = {{ 0., 1., 0.}, {0., 1., 0.}, {0., 1.,  0.}, { 0., 1.,  0.}};
-    m_texCoords = {{0, 1}, {1, 1}, {1, 0}, {0, 0}};
-    m_indices   = { 0, 1, 2, 2, 3, 0 };
+    m_vertices = {{{-1., 0.,  1.}, {0., 1., 0.}, {0, 1}},
+                  {{ 1., 0.,  1.}, {0., 1., 0.}, {1, 1}},
+                  {{ 1., 0., -1.}, {0., 1., 0.}, {1, 0}},
+                  {{-1., 0., -1.}, {0., 1., 0.}, {0, 0}}};
+    m_indices  = { 0, 1, 2, 2, 3, 0 };
 }
 
 void Mesh::createQuad() {
-    m_positions = {{.5, .5, 0.}, {-.5, .5, 0.}, {-.5,-.5, 0.}, {.5,-.5, 0.}};
-    m_normals   = {{ 0., 0., 1.}, {0., 0., 1.}, {0., 0., 1.}, { 0., 0., 1.}};
-    m_texCoords = {{0, 1}, {1, 1}, {1, 0}, {0, 0}};
-    m_indices   = { 0, 1, 2, 2, 3, 0 };
+    m_vertices = {{{ .5,  .5, 0.}, {0., 0., 1.}, {0, 1}},
+                  {{-.5,  .5, 0.}, {0., 0., 1.}, {1, 1}},
+                  {{-.5, -.5, 0.}, {0., 0., 1.}, {1, 0}},
+                  {{ .5, -.5, 0.}, {0., 0., 1.}, {0, 0}}};
+    m_indices  = { 0, 1, 2, 2, 3, 0 };
 }
 
 void Mesh::createCube() {
@@ -64,9 +68,7 @@ void Mesh::createCube() {
         if (axis == 2) texture.y = vertex.y > 0;
         else           texture.y = vertex.z < 0;
 
-        m_positions.emplace_back(vertex);
-        m_normals  .emplace_back(normal);
-        m_texCoords.emplace_back(texture);
+        m_vertices.push_back({ vertex, normal, texture });
     }
     
     m_indices = {
@@ -95,12 +97,9 @@ void Mesh::createSphere(int wedge, int segment) {
             x = xz * cosf(segmentAngle);        // r * sin(u) * cos(v)
             z = xz * sinf(segmentAngle);        // r * sin(u) * sin(v)
             
-            m_positions.emplace_back(glm::vec3(x, y, z));
-            m_normals  .emplace_back(glm::vec3(x, y, z));
-
             s = (float)j / segment;             // vertex tex coord (s, t)
             t = (float)i / wedge;               // range between [0, 1]
-            m_texCoords.emplace_back(glm::vec2(s, t));
+            m_vertices.push_back({ glm::vec3(x, y, z), glm::vec3(x, y, z), glm::vec2(s, t) });
         }
     }
     
@@ -118,8 +117,22 @@ void Mesh::createSphere(int wedge, int segment) {
     }
 }
 
+// Parses the file once and keeps a binary copy next to it, later runs read
+// that copy until the source size or modification time changes
 void Mesh::loadModel(const char* filename) {
-    LOG("Mesh::loadModel");
+    LOG("Mesh::loadModel " << filename);
+    STRING cachePath = filename + MESH_CACHE_PATH;
+    MeshCacheHeader sourceHeader{};
+    bool hasSource = GetSourceHeader(filename, &sourceHeader);
+    if (hasSource && loadCache(cachePath, sourceHeader)) return;
+    
+    TimeVal startTime = ChronoTime::now();
+    parseModel(filename);
+    LOG("Mesh::parseModel done in " << TimeDif(ChronoTime::now() - startTime).count() << "s");
+    if (hasSource) saveCache(cachePath, sourceHeader);
+}
+
+void Mesh::parseModel(const char* filename) {
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
     std::vector<tinyobj::material_t> materials;
@@ -152,10 +165,8 @@ void Mesh::loadModel(const char* filename) {
             size_t hash = std::hash<glm::vec3>()(position) ^
                          (std::hash<glm::vec2>()(texCoord) << 1);
             if (uniqueVertices.count(hash) == 0) {
-                uniqueVertices[hash] = UINT32(m_positions.size());
-                m_positions.emplace_back(glm::vec3(position.x, position.y, position.z));
-                m_normals  .emplace_back(glm::vec3(normal.x, normal.y, normal.z));
-                m_texCoords.emplace_back(glm::vec2(texCoord.x, texCoord.y));
+                uniqueVertices[hash] = UINT32(m_vertices.size());
+                m_vertices.push_back({ position, normal, texCoord });
             }
 
             m_indices.push_back(uniqueVertices[hash]);
@@ -163,74 +174,39 @@ void Mesh::loadModel(const char* filename) {
     }
 }
 
-void Mesh::createVertexBuffer() {
+void Mesh::createVertexBuffer(MemoryUsage memoryUsage) {
     LOG("Mesh::createVertexBuffer");
-    VkDeviceSize bufferSize = sizeofPositions() + sizeofNormals() + sizeofTexCoords();
-    
-    Buffer* tempBuffer = new Buffer();
-    tempBuffer->setup(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
-    tempBuffer->create();
-    
-    uint32_t shift = 0;
-    for (int i = 0; i < m_positions.size(); i++) {
-        tempBuffer->fillBuffer(&m_positions[i], m_sizeofPosition, shift);
-        shift += m_sizeofPosition;
-        tempBuffer->fillBuffer(&m_normals  [i], m_sizeofNormal  , shift);
-        shift += m_sizeofNormal;
-        tempBuffer->fillBuffer(&m_texCoords[i], m_sizeofTexCoord, shift);
-        shift += m_sizeofTexCoord;
-    }
-    
-    Buffer* vertexBuffer = new Buffer();
-    vertexBuffer->setup(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-    vertexBuffer->create();
-    vertexBuffer->cmdCopyFromBuffer(tempBuffer->get(), bufferSize);
-    
-    tempBuffer->cleanup();
-    
-    m_pVertexBuffer = vertexBuffer;
+    m_pVertexBuffer = CreateBuffer(m_vertices.data(), sizeofVertices(),
+                                   VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, memoryUsage);
 }
 
-void Mesh::createIndexBuffer() {
+void Mesh::createIndexBuffer(MemoryUsage memoryUsage) {
     LOG("Mesh::createIndexBuffer");
-    VkDeviceSize bufferSize = sizeofIndices();
-    
-    Buffer* tempBuffer = new Buffer();
-    tempBuffer->setup(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
-    tempBuffer->create();
-    tempBuffer->fillBufferFull(m_indices.data());
-    
-    Buffer* indexBuffer = new Buffer();
-    indexBuffer->setup(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
-    indexBuffer->create();
-    indexBuffer->cmdCopyFromBuffer(tempBuffer->get(), bufferSize);
-    
-    tempBuffer->cleanup();
-    
-    { m_pIndexBuffer = indexBuffer; }
+    m_pIndexBuffer = CreateBuffer(m_indices.data(), sizeofIndices(),
+                                  VK_BUFFER_USAGE_INDEX_BUFFER_BIT, memoryUsage);
 }
 
 void Mesh::createVertexStateInfo() {
     VkVertexInputBindingDescription* bindingDesc = new VkVertexInputBindingDescription();
     bindingDesc->binding = 0;
-    bindingDesc->stride = m_sizeofPosition + m_sizeofNormal + m_sizeofTexCoord;
+    bindingDesc->stride = m_sizeofVertex;
     bindingDesc->inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
     
     m_vertexAttrDescs.resize(3);
     m_vertexAttrDescs[0].binding  = 0;
     m_vertexAttrDescs[0].location = 0;
     m_vertexAttrDescs[0].format   = VK_FORMAT_R32G32B32_SFLOAT;
-    m_vertexAttrDescs[0].offset   = 0;
+    m_vertexAttrDescs[0].offset   = offsetof(Vertex, position);
     
     m_vertexAttrDescs[1].binding  = 0;
     m_vertexAttrDescs[1].location = 1;
     m_vertexAttrDescs[1].format   = VK_FORMAT_R32G32B32_SFLOAT;
-    m_vertexAttrDescs[1].offset   = m_sizeofPosition;
+    m_vertexAttrDescs[1].offset   = offsetof(Vertex, normal);
     
     m_vertexAttrDescs[2].binding  = 0;
     m_vertexAttrDescs[2].location = 2;
     m_vertexAttrDescs[2].format   = VK_FORMAT_R32G32_SFLOAT;
-    m_vertexAttrDescs[2].offset   = m_sizeofPosition + m_sizeofNormal;
+    m_vertexAttrDescs[2].offset   = offsetof(Vertex, texCoord);
     
     m_vertexStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
     m_vertexStateInfo.vertexBindingDescriptionCount = 1;
@@ -250,7 +226,112 @@ Buffer*  Mesh::getVertexBuffer() { return m_pVertexBuffer ; }
 Buffer*  Mesh::getIndexBuffer()  { return m_pIndexBuffer;   }
 uint32_t Mesh::getIndexSize()    { return UINT32(m_indices.size()); }
 
-uint32_t Mesh::sizeofPositions() { return m_sizeofPosition * UINT32(m_positions.size()); }
-uint32_t Mesh::sizeofNormals  () { return m_sizeofNormal   * UINT32(m_normals.size()); }
-uint32_t Mesh::sizeofTexCoords() { return m_sizeofTexCoord * UINT32(m_texCoords.size()); }
-uint32_t Mesh::sizeofIndices  () { return m_sizeofIndex    * UINT32(m_indices.size()); }
+uint32_t Mesh::sizeofVertices() { return m_sizeofVertex * UINT32(m_vertices.size()); }
+uint32_t Mesh::sizeofIndices () { return m_sizeofIndex  * UINT32(m_indices.size()); }
+
+
+// Private ==================================================
+
+bool Mesh::loadCache(STRING path, MeshCacheHeader sourceHeader) {
+    TimeVal startTime = ChronoTime::now();
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        LOG("Mesh::loadCache miss " << path);
+        return false;
+    }
+    
+    uint64_t fileSize = file.tellg();
+    MeshCacheHeader header{};
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(&header), sizeof(MeshCacheHeader));
+    uint64_t dataSize = uint64_t(header.vertexCount) * header.vertexStride +
+                        uint64_t(header.indexCount)  * header.indexSize;
+    if (!file || memcmp(header.magic, MESH_CACHE_MAGIC, 4) != 0 || header.version != MESH_CACHE_VERSION ||
+        header.sourceSize   != sourceHeader.sourceSize   || header.sourceTime != sourceHeader.sourceTime ||
+        header.vertexStride != m_sizeofVertex || header.indexSize != m_sizeofIndex ||
+        sizeof(MeshCacheHeader) + dataSize != fileSize) {
+        LOG("Mesh::loadCache stale " << path);
+        return false;
+    }
+    
+    VECTOR<Vertex>   vertices(header.vertexCount);
+    VECTOR<uint32_t> indices (header.indexCount);
+    file.read(reinterpret_cast<char*>(vertices.data()), vertices.size() * sizeof(Vertex));
+    file.read(reinterpret_cast<char*>(indices.data()),  indices.size()  * sizeof(uint32_t));
+    if (!file) {
+        LOG("Mesh::loadCache corrupt " << path);
+        return false;
+    }
+    m_vertices = std::move(vertices);
+    m_indices  = std::move(indices);
+    LOG("Mesh::loadCache hit " << path << " in " << TimeDif(ChronoTime::now() - startTime).count() << "s");
+    return true;
+}
+
+void Mesh::saveCache(STRING path, MeshCacheHeader sourceHeader) {
+    STRING temp = path + ".tmp";
+    MeshCacheHeader header = sourceHeader;
+    memcpy(header.magic, MESH_CACHE_MAGIC, 4);
+    header.version      = MESH_CACHE_VERSION;
+    header.vertexCount  = UINT32(m_vertices.size());
+    header.indexCount   = UINT32(m_indices.size());
+    header.vertexStride = m_sizeofVertex;
+    header.indexSize    = m_sizeofIndex;
+    
+    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+    if (file.is_open()) {
+        file.write(reinterpret_cast<const char*>(&header), sizeof(MeshCacheHeader));
+        file.write(reinterpret_cast<const char*>(m_vertices.data()), sizeofVertices());
+        file.write(reinterpret_cast<const char*>(m_indices.data()),  sizeofIndices());
+        file.close();
+    }
+    
+    // Rename only a complete file so an interrupted write never looks valid
+    if (!file || std::rename(temp.c_str(), path.c_str()) != 0) {
+        ERR("Mesh::saveCache failed to write " << path);
+        std::remove(temp.c_str());
+        return;
+    }
+    LOG("Mesh::saveCache " << path);
+}
+
+bool Mesh::GetSourceHeader(STRING path, MeshCacheHeader* pHeader) {
+    struct stat fileStat;
+    if (stat(path.c_str(), &fileStat) != 0) return false;
+    pHeader->sourceSize = fileStat.st_size;
+    pHeader->sourceTime = fileStat.st_mtime;
+    return true;
+}
+
+// GPU only buffers are filled through a staging copy, host visible ones directly.
+// On the main thread the copy goes into the transfer batch and the staging
+// buffer lives until that batch completes.
+Buffer* Mesh::CreateBuffer(const void* pData, VkDeviceSize bufferSize, VkBufferUsageFlags usage,
+                           MemoryUsage memoryUsage) {
+    Buffer* pBuffer = new Buffer();
+    if (memoryUsage != MEMORY_GPU_ONLY) {
+        pBuffer->setup(bufferSize, usage, memoryUsage);
+        pBuffer->create();
+        pBuffer->fillBufferFull(pData);
+        return pBuffer;
+    }
+    
+    Buffer* tempBuffer = new Buffer();
+    tempBuffer->setup(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MEMORY_UPLOAD);
+    tempBuffer->create();
+    tempBuffer->fillBufferFull(pData);
+    
+    pBuffer->setup(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, MEMORY_GPU_ONLY);
+    pBuffer->create();
+    
+    TransferManager* pTransferManager = System::TransferManager();
+    if (pTransferManager && pTransferManager->canRecord()) {
+        pTransferManager->copyBuffer(tempBuffer->get(), pBuffer->get(), bufferSize, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                                     VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT);
+        pTransferManager->onComplete([=](){ tempBuffer->cleanup(); });
+        return pBuffer;
+    }
+    pBuffer->cmdCopyFromBuffer(tempBuffer->get(), bufferSize);
+    tempBuffer->cleanup();
+    return pBuffer;
+}
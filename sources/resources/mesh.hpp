@@ -6,9 +6,28 @@
 #include "../include.h"
 #include "buffer.hpp"
 
+// Binary copy of a parsed model, written next to the source as <file>.mesh.
+// Header, then the interleaved vertices, then the indices.
+struct MeshCacheHeader {
+    char     magic[4];
+    uint32_t version;
+    uint64_t sourceSize;
+    int64_t  sourceTime;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t vertexStride;
+    uint32_t indexSize;
+};
+
 class Mesh {
     
 public:
+    struct Vertex {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec2 texCoord;
+    };
+    
     Mesh();
     ~Mesh();
     
@@ -24,13 +43,11 @@ public:
     void rotate(float angle, glm::vec3 axis);
     void translate(glm::vec3 translation);
     
-    void createIndexBuffer();
-    void createVertexBuffer();
+    void createIndexBuffer (MemoryUsage memoryUsage = MEMORY_GPU_ONLY);
+    void createVertexBuffer(MemoryUsage memoryUsage = MEMORY_GPU_ONLY);
     void createVertexStateInfo();
     
-    uint32_t sizeofPositions();
-    uint32_t sizeofNormals();
-    uint32_t sizeofTexCoords();
+    uint32_t sizeofVertices();
     uint32_t sizeofIndices();
     
     glm::mat4 getMatrix();
@@ -51,14 +68,23 @@ private:
     VECTOR<VkVertexInputAttributeDescription> m_vertexAttrDescs;
     VkPipelineVertexInputStateCreateInfo m_vertexStateInfo{};
     
-    VECTOR<glm::vec3> m_positions;
-    VECTOR<glm::vec3> m_normals;
-    VECTOR<glm::vec2> m_texCoords;
-    VECTOR<uint32_t>  m_indices;
+    VECTOR<Vertex>   m_vertices;
+    VECTOR<uint32_t> m_indices;
+    
+    const uint32_t m_sizeofVertex = sizeof(Vertex);
+    const uint32_t m_sizeofIndex  = sizeof(uint32_t);
     
-    const uint32_t m_sizeofPosition = sizeof(glm::vec3);
-    const uint32_t m_sizeofNormal   = sizeof(glm::vec3);
-    const uint32_t m_sizeofTexCoord = sizeof(glm::vec2);
-    const uint32_t m_sizeofIndex    = sizeof(uint32_t);
+    void parseModel(const char* filename);
+    bool loadCache (STRING path, MeshCacheHeader sourceHeader);
+    void saveCache (STRING path, MeshCacheHeader sourceHeader);
+    
+    static bool GetSourceHeader(STRING path, MeshCacheHeader* pHeader);
+    static Buffer* CreateBuffer(const void* pData, VkDeviceSize bufferSize, VkBufferUsageFlags usage,
+                                MemoryUsage memoryUsage);
+    
+private:
+    const uint32_t MESH_CACHE_VERSION = 1;
+    const char     MESH_CACHE_MAGIC[4] = {'M', 'E', 'S', 'H'};
+    const STRING   MESH_CACHE_PATH = ".mesh";
     
 };
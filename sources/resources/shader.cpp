@@ -6,6 +6,7 @@
 #include "../system.hpp"
 
 #include <fstream>
+#include <dirent.h>
 
 Shader::~Shader() {}
 Shader::Shader() : m_pDevice(System::Device()) {}
@@ -52,7 +53,45 @@ VkPipelineShaderStageCreateInfo Shader::getShaderStageInfo() {
     return m_shaderStageInfo;
 }
 
+// Reads every SPIR-V file in directory ahead of time, so a worker thread can
+// take the disk reads off the startup path before any module is created
+void Shader::Preload(const std::string directory) {
+    LOG("Shader::Preload " << directory);
+    DIR* pDir = opendir(directory.c_str());
+    if (pDir == nullptr) return;
+    while (dirent* pEntry = readdir(pDir)) {
+        STRING name = pEntry->d_name;
+        if (name.size() < 4 || name.compare(name.size() - 4, 4, ".spv") != 0) continue;
+        
+        std::ifstream file(directory + name, std::ios::ate | std::ios::binary);
+        if (!file.is_open()) continue;
+        VECTOR<char> buffer((size_t) file.tellg());
+        file.seekg(0);
+        file.read(buffer.data(), buffer.size());
+        
+        std::lock_guard<std::mutex> lock(m_preloadMutex);
+        m_preloaded[directory + name] = std::move(buffer);
+    }
+    closedir(pDir);
+}
+
+// Drops whatever startup did not use
+void Shader::ReleasePreloaded() {
+    std::lock_guard<std::mutex> lock(m_preloadMutex);
+    m_preloaded.clear();
+}
+
 VECTOR<char> Shader::ReadBinaryFile(const std::string filename) {
+    {
+        std::lock_guard<std::mutex> lock(m_preloadMutex);
+        auto it = m_preloaded.find(filename);
+        if (it != m_preloaded.end()) {
+            // Used once, later loads see the file as it is on disk
+            VECTOR<char> buffer = std::move(it->second);
+            m_preloaded.erase(it);
+            return buffer;
+        }
+    }
     std::ifstream file(filename, std::ios::ate | std::ios::binary);
     if (!file.is_open()) throw std::runtime_error("failed to open file!");
 
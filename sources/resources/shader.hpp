@@ -6,6 +6,8 @@
 #include "../include.h"
 #include "device.hpp"
 
+#include <mutex>
+
 class Shader {
     
 public:
@@ -22,6 +24,9 @@ public:
     
     VkPipelineShaderStageCreateInfo getShaderStageInfo();
     
+    static void Preload(const std::string directory);
+    static void ReleasePreloaded();
+    
     VkShaderModuleCreateInfo        m_shaderInfo{};
     VkPipelineShaderStageCreateInfo m_shaderStageInfo{};
     
@@ -34,4 +39,7 @@ private:
     
     std::vector<char> ReadBinaryFile(const std::string filename);
     
+    inline static std::mutex m_preloadMutex;
+    inline static std::unordered_map<std::string, VECTOR<char>> m_preloaded;
+    
 };
@@ -0,0 +1,140 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#include "staging_arena.hpp"
+
+#include "../system.hpp"
+
+// Covers BC block sizes and the 4 byte offset rule of buffer to image copies
+#define ARENA_ALIGNMENT 16
+
+StagingArena::~StagingArena() {}
+StagingArena::StagingArena() : m_pDevice(System::Device()) {}
+
+void StagingArena::cleanup() { m_cleaner.flush("StagingArena"); }
+
+void StagingArena::create(VkDeviceSize capacity) {
+    LOG("StagingArena::create " << capacity);
+    m_capacity = capacity;
+    m_pBuffer  = new Buffer();
+    m_pBuffer->setup(capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MEMORY_UPLOAD);
+    m_pBuffer->create();
+    m_pMapped  = static_cast<unsigned char*>(m_pBuffer->mapMemory(capacity));
+    m_cleaner.push([=](){
+        System::Scheduler()->waitIdle();
+        for (Dedicated dedicated : m_dedicated) dedicated.pBuffer->cleanup();
+        m_dedicated.clear();
+        m_blocks.clear();
+        m_pBuffer->cleanup();
+    });
+}
+
+// Blocks only on space that is already on its way back to the ring
+StagingArena::Allocation StagingArena::allocate(VkDeviceSize size) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size = (size + ARENA_ALIGNMENT - 1) & ~VkDeviceSize(ARENA_ALIGNMENT - 1);
+    recycleBlocks(false);
+
+    VkDeviceSize offset;
+    while (!findSpace(size, &offset)) {
+        if (m_blocks.empty() || !m_blocks.front().isReleased) return allocateDedicated(size);
+        recycleBlocks(true);
+    }
+    m_blocks.push_back({ offset, size, 0, false });
+    m_head = offset + size;
+
+    Allocation allocation;
+    allocation.buffer = m_pBuffer->get();
+    allocation.offset = offset;
+    allocation.size   = size;
+    allocation.pData  = m_pMapped + offset;
+    return allocation;
+}
+
+void StagingArena::flush(Allocation allocation) {
+    if (allocation.pDedicated) allocation.pDedicated->flush();
+    else                       m_pBuffer->flush(allocation.offset, allocation.size);
+}
+
+void StagingArena::release(Allocation allocation, uint64_t value) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (allocation.pDedicated) {
+        m_dedicated.push_back({ allocation.pDedicated, value });
+    } else {
+        for (Block& block : m_blocks) {
+            if (block.offset != allocation.offset) continue;
+            block.value      = value;
+            block.isReleased = true;
+            break;
+        }
+    }
+    recycleBlocks(false);
+}
+
+void StagingArena::recycle() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    recycleBlocks(false);
+}
+
+VkDeviceSize StagingArena::getUsedSize() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    VkDeviceSize size = 0;
+    for (Block block : m_blocks) size += block.size;
+    return size;
+}
+
+
+// Private ==================================================
+
+// Live blocks sit between the front block and m_head, possibly wrapped. The
+// tail end skipped by a wrap comes back with the block in front of it.
+bool StagingArena::findSpace(VkDeviceSize size, VkDeviceSize* pOffset) {
+    VkDeviceSize capacity = m_capacity;
+    VkDeviceSize head     = m_head;
+    if (m_blocks.empty()) {
+        *pOffset = 0;
+        return size <= capacity;
+    }
+
+    VkDeviceSize tail = m_blocks.front().offset;
+    if (head > tail) {
+        if (head + size <= capacity) { *pOffset = head; return true; }
+        if (size <= tail)            { *pOffset = 0;    return true; }
+        return false;
+    }
+    if (head + size <= tail) { *pOffset = head; return true; }
+    return false;
+}
+
+bool StagingArena::isComplete(uint64_t value, bool wait) {
+    Scheduler* pScheduler = System::Scheduler();
+    if (wait) pScheduler->wait(value);
+    return pScheduler->isComplete(value);
+}
+
+// With wait set, blocks on the front block alone and frees at least that one
+void StagingArena::recycleBlocks(bool wait) {
+    while (!m_blocks.empty() && m_blocks.front().isReleased) {
+        if (!isComplete(m_blocks.front().value, wait)) break;
+        m_blocks.pop_front();
+        wait = false;
+    }
+    while (!m_dedicated.empty() && isComplete(m_dedicated.front().value, false)) {
+        m_dedicated.front().pBuffer->cleanup();
+        m_dedicated.pop_front();
+    }
+}
+
+StagingArena::Allocation StagingArena::allocateDedicated(VkDeviceSize size) {
+    LOG("StagingArena::allocateDedicated " << size);
+    Buffer* pBuffer = new Buffer();
+    pBuffer->setup(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MEMORY_UPLOAD);
+    pBuffer->create();
+
+    Allocation allocation;
+    allocation.buffer     = pBuffer->get();
+    allocation.size       = size;
+    allocation.pData      = static_cast<unsigned char*>(pBuffer->mapMemory(size));
+    allocation.pDedicated = pBuffer;
+    return allocation;
+}
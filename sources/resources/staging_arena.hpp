@@ -0,0 +1,74 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#pragma once
+
+#include "../include.h"
+#include "device.hpp"
+#include "buffer.hpp"
+
+#include <deque>
+#include <mutex>
+
+// Holds a full 2K material set with its mip chains
+const VkDeviceSize STAGING_ARENA_SIZE = 128ull << 20;
+
+// One persistently mapped upload buffer shared by every texture upload. Space
+// is handed out in ring order and comes back once the render queue's timeline
+// reaches the value given to release. Requests that don't fit get a dedicated buffer instead.
+class StagingArena {
+
+public:
+    struct Allocation {
+        VkBuffer       buffer     = VK_NULL_HANDLE;
+        VkDeviceSize   offset     = 0;
+        VkDeviceSize   size       = 0;
+        unsigned char* pData      = nullptr;
+        Buffer*        pDedicated = nullptr;
+    };
+
+    ~StagingArena();
+    StagingArena();
+
+    void cleanup();
+    void create(VkDeviceSize capacity);
+
+    Allocation allocate(VkDeviceSize size);
+    // Makes CPU writes to the allocation visible, call before submitting the copy
+    void flush(Allocation allocation);
+    // Value of the render queue submit that reads the allocation,
+    // 0 when the copy has already completed
+    void release(Allocation allocation, uint64_t value = 0);
+    void recycle();
+
+    VkDeviceSize getUsedSize();
+
+private:
+    struct Block {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        uint64_t     value;
+        bool         isReleased;
+    };
+    struct Dedicated {
+        Buffer*  pBuffer;
+        uint64_t value;
+    };
+
+    Cleaner m_cleaner;
+    Device* m_pDevice;
+
+    Buffer*        m_pBuffer  = nullptr;
+    unsigned char* m_pMapped  = nullptr;
+    VkDeviceSize   m_capacity = 0;
+    VkDeviceSize   m_head     = 0;
+
+    std::deque<Block>     m_blocks;
+    std::deque<Dedicated> m_dedicated;
+    std::mutex m_mutex;
+
+    bool findSpace(VkDeviceSize size, VkDeviceSize* pOffset);
+    bool isComplete(uint64_t value, bool wait);
+    void recycleBlocks(bool wait);
+    Allocation allocateDedicated(VkDeviceSize size);
+};
@@ -0,0 +1,176 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#include "texture_streamer.hpp"
+
+#include "../system.hpp"
+
+#define STAGING_ALIGNMENT 16
+
+TextureStreamer::~TextureStreamer() {}
+TextureStreamer::TextureStreamer() : m_pDevice(System::Device()) {}
+
+void TextureStreamer::cleanup() { m_cleaner.flush("TextureStreamer"); }
+
+void TextureStreamer::create() {
+    LOG("TextureStreamer::create");
+    m_cleaner.push([=](){ finish(); });
+}
+
+// Returns false while a previous batch is still streaming. The images are
+// created from the file headers once prepare is done, the caller owns them.
+bool TextureStreamer::load(VECTOR<STRING> paths, std::future<void> prepare) {
+    if (isBusy()) return false;
+    LOG("TextureStreamer::load");
+    m_startTime   = ChronoTime::now();
+    m_pCommander  = System::Commander();
+    m_paths       = paths;
+    m_prepare     = std::move(prepare);
+    m_isStreaming = true;
+    if (!m_prepare.valid()) beginDecode();
+    return true;
+}
+
+// Advances the batch as far as it can without blocking, or to the end if wait
+void TextureStreamer::update(bool wait) {
+    if (!m_isStreaming) return;
+    if (m_submitted == 0) {
+        if (!isPrepared(wait)) return;
+        if (!isDecoded(wait)) return;
+        submitUpload();
+    }
+    for (uint i = 0; i < 2; i++) {
+        if (!isUploaded(i, wait)) return;
+    }
+    LOG("TextureStreamer::done in " << TimeDif(ChronoTime::now() - m_startTime).count() << "s");
+    freeStaging();
+}
+
+void TextureStreamer::finish() { update(true); }
+
+bool TextureStreamer::isBusy() { return m_isStreaming; }
+
+uint TextureStreamer::getResidentMip() { return m_residentMip; }
+
+VECTOR<Image*> TextureStreamer::getTextures() { return m_pTextures; }
+
+
+// Private ==================================================
+
+bool TextureStreamer::isPrepared(bool wait) {
+    if (!m_prepare.valid()) return true;
+    if (wait) m_prepare.wait();
+    if (m_prepare.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
+    // Rethrows a failed prepare on the render thread
+    m_prepare.get();
+    LOG("TextureStreamer::prepared in " << TimeDif(ChronoTime::now() - m_startTime).count() << "s");
+    beginDecode();
+    return true;
+}
+
+// Creates the images from the file headers and queues the decodes
+void TextureStreamer::beginDecode() {
+    VECTOR<STRING> paths = m_paths;
+    m_residentMip = NOT_RESIDENT;
+    m_submitted   = 0;
+    m_pTextures.resize(paths.size());
+    m_offsets.resize(paths.size());
+    
+    VkDeviceSize stagingSize = 0;
+    for (uint i = 0; i < paths.size(); i++) {
+        m_pTextures[i] = new Image();
+        m_pTextures[i]->setupForTextureInfo(paths[i]);
+        m_pTextures[i]->createWithSampler();
+        m_offsets[i] = stagingSize;
+        stagingSize += m_pTextures[i]->getMipChainSize();
+        stagingSize  = (stagingSize + STAGING_ALIGNMENT - 1) & ~VkDeviceSize(STAGING_ALIGNMENT - 1);
+    }
+    
+    m_staging = System::StagingArena()->allocate(stagingSize);
+    unsigned char* pMapped = m_staging.pData;
+    
+    ThreadPool* pThreadPool = System::ThreadPool();
+    for (uint i = 0; i < paths.size(); i++) {
+        Image* pImage = m_pTextures[i];
+        unsigned char* pDst = pMapped + m_offsets[i];
+        STRING path = paths[i];
+        m_decodes.push_back(pThreadPool->submit([=](){ pImage->decodeMipChain(path, pDst); }));
+    }
+}
+
+bool TextureStreamer::isDecoded(bool wait) {
+    for (std::future<void>& decode : m_decodes) {
+        if (wait) decode.wait();
+        if (decode.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
+    }
+    // Rethrows a failed decode on the render thread
+    for (std::future<void>& decode : m_decodes) decode.get();
+    m_decodes.clear();
+    LOG("TextureStreamer::decoded in " << TimeDif(ChronoTime::now() - m_startTime).count() << "s");
+    return true;
+}
+
+// The coarse levels come from the same buffer, so they land first and the
+// base levels follow in the next submit without another staging copy
+void TextureStreamer::submitUpload() {
+    LOG("TextureStreamer::submitUpload");
+    Commander*      pCommander = m_pCommander;
+    VkBuffer        staging    = m_staging.buffer;
+    VECTOR<Image*>  pTextures  = m_pTextures;
+    VECTOR<VkDeviceSize> offsets = m_offsets;
+    for (VkDeviceSize& offset : offsets) offset += m_staging.offset;
+    System::StagingArena()->flush(m_staging);
+    
+    m_cmdBuffers[0] = pCommander->createCommandBuffer();
+    pCommander->beginSingleTimeCommands(m_cmdBuffers[0]);
+    for (uint i = 0; i < pTextures.size(); i++) {
+        uint mipLevels  = pTextures[i]->getMipLevels();
+        uint coarseBase = GetCoarseBase(pTextures[i]);
+        pTextures[i]->cmdTransitionToTransferDst(m_cmdBuffers[0]);
+        pTextures[i]->cmdCopyBufferToImage(m_cmdBuffers[0], staging, offsets[i], coarseBase, mipLevels - coarseBase);
+        pTextures[i]->cmdTransitionMipsToShaderR(m_cmdBuffers[0], coarseBase, mipLevels - coarseBase);
+    }
+    m_values[0] = pCommander->submitSingleTimeCommands(m_cmdBuffers[0]);
+    
+    m_cmdBuffers[1] = pCommander->createCommandBuffer();
+    pCommander->beginSingleTimeCommands(m_cmdBuffers[1]);
+    for (uint i = 0; i < pTextures.size(); i++) {
+        uint coarseBase = GetCoarseBase(pTextures[i]);
+        if (coarseBase == 0) continue;
+        pTextures[i]->cmdCopyBufferToImage(m_cmdBuffers[1], staging, offsets[i], 0, coarseBase);
+        pTextures[i]->cmdTransitionMipsToShaderR(m_cmdBuffers[1], 0, coarseBase);
+    }
+    m_values[1] = pCommander->submitSingleTimeCommands(m_cmdBuffers[1]);
+    m_submitted = 2;
+    
+    // Both submits share the queue, so the last value covers the whole batch
+    System::StagingArena()->release(m_staging, m_values[1]);
+}
+
+bool TextureStreamer::isUploaded(uint submitIdx, bool wait) {
+    Scheduler* pScheduler = m_pCommander->getScheduler();
+    uint64_t   value      = m_values[submitIdx];
+    if (m_cmdBuffers[submitIdx] == VK_NULL_HANDLE) return true;
+    if (wait) pScheduler->wait(value);
+    if (!pScheduler->isComplete(value)) return false;
+    
+    m_pCommander->freeCommandBuffer(m_cmdBuffers[submitIdx]);
+    m_cmdBuffers[submitIdx] = VK_NULL_HANDLE;
+    m_residentMip = submitIdx == 0 ? 1 : 0;
+    LOG("TextureStreamer::resident mip " << m_residentMip << " after " <<
+        TimeDif(ChronoTime::now() - m_startTime).count() << "s");
+    return true;
+}
+
+// The arena got the timeline value at submit and can take the space back now
+void TextureStreamer::freeStaging() {
+    System::StagingArena()->recycle();
+    m_staging     = {};
+    m_isStreaming = false;
+    m_submitted   = 0;
+}
+
+// Level 0 holds three quarters of the chain, everything below it goes first
+uint TextureStreamer::GetCoarseBase(Image* pImage) {
+    return std::min(1u, pImage->getMipLevels() - 1);
+}
@@ -0,0 +1,66 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#pragma once
+
+#include "../include.h"
+#include "../renderer/device.hpp"
+#include "../renderer/commander.hpp"
+#include "image.hpp"
+#include "staging_arena.hpp"
+
+#include <future>
+
+// Loads a batch of textures without blocking the render thread. A prepare
+// step that writes the files, such as packing, runs first on the thread pool.
+// Files are decoded and mipmapped on the thread pool straight into one staging arena
+// allocation, then uploaded in two submits: every level but the base first,
+// the base last.
+class TextureStreamer {
+    
+public:
+    ~TextureStreamer();
+    TextureStreamer();
+    
+    void cleanup();
+    void create();
+    
+    bool load  (VECTOR<STRING> paths, std::future<void> prepare = {});
+    void update(bool wait = false);
+    void finish();
+    
+    bool isBusy();
+    uint getResidentMip();
+    VECTOR<Image*> getTextures();
+    
+    static const uint NOT_RESIDENT = UINT32_MAX;
+    
+private:
+    Cleaner m_cleaner;
+    Device* m_pDevice;
+    
+    Commander* m_pCommander = nullptr;
+    StagingArena::Allocation m_staging;
+    bool m_isStreaming = false;
+    VECTOR<Image*>       m_pTextures;
+    VECTOR<VkDeviceSize> m_offsets;
+    VECTOR<STRING>            m_paths;
+    std::future<void>         m_prepare;
+    VECTOR<std::future<void>> m_decodes;
+    
+    uint64_t        m_values[2]     = { 0, 0 };
+    VkCommandBuffer m_cmdBuffers[2] = { VK_NULL_HANDLE, VK_NULL_HANDLE };
+    
+    uint m_submitted   = 0;
+    uint m_residentMip = NOT_RESIDENT;
+    TimeVal m_startTime;
+    
+    bool isPrepared(bool wait);
+    void beginDecode();
+    bool isDecoded(bool wait);
+    bool isUploaded(uint submitIdx, bool wait);
+    void submitUpload();
+    void freeStaging();
+    
+    static uint GetCoarseBase(Image* pImage);
+};
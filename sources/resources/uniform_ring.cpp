@@ -0,0 +1,44 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#include "uniform_ring.hpp"
+
+#include "../system.hpp"
+
+UniformRing::~UniformRing() {}
+UniformRing::UniformRing() : m_pDevice(System::Device()) {}
+
+void UniformRing::cleanup() { m_cleaner.flush("UniformRing"); }
+
+void UniformRing::create(uint frameCount, VkDeviceSize frameSize) {
+    LOG("UniformRing::create " << frameCount << " x " << frameSize);
+    m_alignment  = m_pDevice->getDeviceProperties().limits.minUniformBufferOffsetAlignment;
+    m_frameCount = frameCount;
+    m_frameSize  = TLSF::AlignUp(frameSize, m_alignment);
+    
+    m_pBuffer = new Buffer();
+    m_pBuffer->setup(m_frameSize * frameCount, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, MEMORY_DYNAMIC);
+    m_pBuffer->create();
+    m_cleaner.push([=](){ m_pBuffer->cleanup(); });
+    beginFrame(0);
+}
+
+void UniformRing::beginFrame(uint frameIdx) {
+    CHECK_BOOL((frameIdx < m_frameCount), "uniform ring has no slot for this frame!");
+    m_head = m_frameSize * frameIdx;
+    m_end  = m_head + m_frameSize;
+}
+
+uint32_t UniformRing::push(const void* pData, VkDeviceSize size) {
+    VkDeviceSize offset = m_head;
+    CHECK_BOOL((offset + size <= m_end), "uniform ring frame is full!");
+    memcpy(m_pBuffer->getMapped<unsigned char>(offset), pData, size);
+    m_pBuffer->flush(offset, size);
+    m_head = TLSF::AlignUp(offset + size, m_alignment);
+    return UINT32(offset);
+}
+
+VkDescriptorBufferInfo* UniformRing::getDescriptorInfo(VkDeviceSize range) {
+    m_descriptorInfos.push_back({ m_pBuffer->get(), 0, range });
+    return &m_descriptorInfos.back();
+}
@@ -0,0 +1,49 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#pragma once
+
+#include "../include.h"
+#include "device.hpp"
+#include "buffer.hpp"
+
+#include <deque>
+
+// Room for the constants of one frame
+const VkDeviceSize UNIFORM_RING_FRAME_SIZE = 64ull << 10;
+
+// One mapped uniform buffer split into a slot per frame in flight. Each frame
+// pushes its constants linearly into its own slot and binds them through
+// dynamic offsets, so descriptor sets never change and a slot is only rewritten
+// once the frame that last used it has completed on the GPU.
+class UniformRing {
+
+public:
+    ~UniformRing();
+    UniformRing();
+
+    void cleanup();
+    void create(uint frameCount, VkDeviceSize frameSize);
+
+    // Call after the last submit of frameIdx has been waited on
+    void beginFrame(uint frameIdx);
+
+    uint32_t push(const void* pData, VkDeviceSize size);
+    template<typename T> uint32_t push(const T& value) { return push(&value, sizeof(T)); }
+
+    // For a VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC binding of range bytes
+    VkDescriptorBufferInfo* getDescriptorInfo(VkDeviceSize range);
+
+private:
+    Cleaner m_cleaner;
+    Device* m_pDevice;
+
+    Buffer*       m_pBuffer    = nullptr;
+    uint          m_frameCount = 0;
+    VkDeviceSize  m_frameSize  = 0;
+    VkDeviceSize  m_alignment  = 1;
+    VkDeviceSize  m_head = 0;
+    VkDeviceSize  m_end  = 0;
+
+    std::deque<VkDescriptorBufferInfo> m_descriptorInfos;
+};
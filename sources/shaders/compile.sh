@@ -22,11 +22,20 @@ shader_folder=(
     $shader_dir/
     $shader_dir/
                 
+    $compute_dir/
+    $compute_dir/
+    $compute_dir/
+    $compute_dir/
     $compute_dir/
     $compute_dir/
     $compute_dir/
     $compute_dir/
                 
+    $pbr_dir/
+    $pbr_dir/
+    $pbr_dir/
+    $pbr_dir/
+    $pbr_dir/
     $pbr_dir/
     $pbr_dir/
     $pbr_dir/
@@ -42,15 +51,24 @@ shader_names=(
     swapchain.vert
     swapchain.frag
             
-    hdr.comp
+    hdr_rgba32f.comp
+    hdr_rgba16f.comp
     fluid.comp
     interference1d.comp
     brdf.comp
+    mipmap_rgba8.comp
+    mipmap_rgba16f.comp
+    mipmap_rgba32f.comp
                 
     cubemap.vert
     cubemap.frag
     main1d.vert
     main1d.frag
+    fetch.vert
+    fetch_unpacked.frag
+    fetch_packed.frag
+    geometry.vert
+    geometry.frag
         
     equirect.vert
     equirect.frag
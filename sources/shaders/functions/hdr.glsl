@@ -0,0 +1,21 @@
+// Expands packed RGBE texels to float, HDR_FORMAT picks the output image format
+
+layout(local_size_x = 16, local_size_y = 16, local_size_z = 1) in;
+
+// One texel per uint, bytes in file order r, g, b, e
+layout(set = 0, binding = 0) readonly buffer inputBuffer { uint rgbe[]; };
+layout(set = 0, binding = 1, HDR_FORMAT) uniform writeonly image2D outputImage;
+
+layout(push_constant) uniform Misc { ivec2 size; };
+
+void main() {
+    uint xi = gl_GlobalInvocationID.x;
+    uint yi = gl_GlobalInvocationID.y;
+
+    if(xi >= size.x || yi >= size.y) return;
+    
+    uvec4 texel = (uvec4(rgbe[yi * size.x + xi]) >> uvec4(0, 8, 16, 24)) & 0xffu;
+    // Same expansion as stbi_loadf, c * 2^(e - 136) and black for a zero exponent
+    float scale = texel.a == 0u ? 0.0 : exp2(float(texel.a) - 136.0);
+    imageStore(outputImage, ivec2(xi, yi), vec4(vec3(texel.rgb) * scale, 1.0));
+}
@@ -0,0 +1,124 @@
+// Single pass mip chain generator, included by the mipmap_<format>.comp shaders
+// which define MIP_FORMAT. Every group reduces a 64x64 tile of level 0 down to
+// one texel of level 6, the last group to finish a layer then reduces level 6
+// down to level 12 the same way.
+
+#define MAX_MIPS  13
+#define TILE_MIPS 6
+
+layout(local_size_x = 256, local_size_y = 1, local_size_z = 1) in;
+
+layout(set = 0, binding = 0) coherent buffer Counter { uint counter[]; };
+layout(set = 0, binding = 1, MIP_FORMAT) uniform coherent image2DArray mips[MAX_MIPS];
+
+layout(push_constant) uniform Misc {
+    ivec2 size;
+    uint  mipCount;
+    uint  isSRGB;
+};
+
+shared vec4 tile[16][16];
+shared bool isLastGroup;
+
+vec4 toLinear(vec4 c) {
+    if (isSRGB == 0) return c;
+    vec3 low  = c.rgb / 12.92;
+    vec3 high = pow((c.rgb + 0.055) / 1.055, vec3(2.4));
+    return vec4(mix(high, low, lessThanEqual(c.rgb, vec3(0.04045))), c.a);
+}
+
+vec4 toSRGB(vec4 c) {
+    if (isSRGB == 0) return c;
+    vec3 low  = c.rgb * 12.92;
+    vec3 high = 1.055 * pow(c.rgb, vec3(1.0 / 2.4)) - 0.055;
+    return vec4(mix(high, low, lessThanEqual(c.rgb, vec3(0.0031308))), c.a);
+}
+
+ivec2 mipSize(uint level) { return max(size >> int(level), ivec2(1)); }
+
+// The image array is only indexed with constants, no dynamic indexing feature needed
+vec4 loadMip(uint level, ivec2 p, int layer) {
+    ivec3 q = ivec3(min(p, mipSize(level) - 1), layer);
+    vec4 c = vec4(0.0);
+    switch (int(level)) {
+        case 0: c = imageLoad(mips[0], q); break;
+        case 6: c = imageLoad(mips[6], q); break;
+    }
+    return toLinear(c);
+}
+
+void storeMip(uint level, ivec2 p, int layer, vec4 c) {
+    if (level >= mipCount || any(greaterThanEqual(p, mipSize(level)))) return;
+    ivec3 q = ivec3(p, layer);
+    c = toSRGB(c);
+    switch (int(level)) {
+        case  1: imageStore(mips[ 1], q, c); break;
+        case  2: imageStore(mips[ 2], q, c); break;
+        case  3: imageStore(mips[ 3], q, c); break;
+        case  4: imageStore(mips[ 4], q, c); break;
+        case  5: imageStore(mips[ 5], q, c); break;
+        case  6: imageStore(mips[ 6], q, c); break;
+        case  7: imageStore(mips[ 7], q, c); break;
+        case  8: imageStore(mips[ 8], q, c); break;
+        case  9: imageStore(mips[ 9], q, c); break;
+        case 10: imageStore(mips[10], q, c); break;
+        case 11: imageStore(mips[11], q, c); break;
+        case 12: imageStore(mips[12], q, c); break;
+    }
+}
+
+vec4 reduceShared(ivec2 p) {
+    return (tile[p.y*2][p.x*2] + tile[p.y*2][p.x*2+1] + tile[p.y*2+1][p.x*2] + tile[p.y*2+1][p.x*2+1]) * 0.25;
+}
+
+// Writes levels srcLevel+1 .. srcLevel+6 for one 64x64 tile of srcLevel
+void reduceTile(uint srcLevel, ivec2 tileId, int layer) {
+    uint  t  = gl_LocalInvocationIndex;
+    ivec2 xy = ivec2(t % 16, t / 16);
+    
+    // First two levels in registers, each thread reduces 4x4 source texels
+    vec4 sum = vec4(0.0);
+    for (int j = 0; j < 2; j++) {
+        for (int i = 0; i < 2; i++) {
+            ivec2 p = tileId * 64 + xy * 4 + ivec2(i, j) * 2;
+            vec4  c = (loadMip(srcLevel, p, layer) + loadMip(srcLevel, p + ivec2(1, 0), layer) +
+                       loadMip(srcLevel, p + ivec2(0, 1), layer) + loadMip(srcLevel, p + ivec2(1, 1), layer)) * 0.25;
+            storeMip(srcLevel + 1, tileId * 32 + xy * 2 + ivec2(i, j), layer, c);
+            sum += c;
+        }
+    }
+    sum *= 0.25;
+    storeMip(srcLevel + 2, tileId * 16 + xy, layer, sum);
+    tile[xy.y][xy.x] = sum;
+    
+    // The rest through shared memory, 16x16 texels down to one
+    for (uint level = 3u, dim = 8u; level <= TILE_MIPS; level++, dim /= 2u) {
+        barrier();
+        ivec2 p = ivec2(t % dim, t / dim);
+        vec4  c = vec4(0.0);
+        if (t < dim * dim) {
+            c = reduceShared(p);
+            storeMip(srcLevel + level, tileId * int(dim) + p, layer, c);
+        }
+        barrier();
+        if (t < dim * dim) tile[p.y][p.x] = c;
+    }
+}
+
+void main() {
+    int layer = int(gl_WorkGroupID.z);
+    reduceTile(0u, ivec2(gl_WorkGroupID.xy), layer);
+    if (mipCount <= TILE_MIPS + 1) return;
+    
+    // Publish this group's level 6 texel, the last group of the layer carries on
+    if (gl_LocalInvocationIndex == 0) {
+        memoryBarrierImage();
+        uint groups = gl_NumWorkGroups.x * gl_NumWorkGroups.y;
+        isLastGroup = atomicAdd(counter[layer], 1) == groups - 1;
+    }
+    barrier();
+    if (!isLastGroup) return;
+    
+    memoryBarrierImage();
+    reduceTile(TILE_MIPS, ivec2(0), layer);
+}
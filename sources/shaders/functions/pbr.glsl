@@ -43,9 +43,10 @@ vec4 fresnelSchlickRoughness(float cosTheta, vec4 F0, float roughness) {
 
 vec4 pbr() {
     vec4  albedo    = texture(albedoMap, fragTexCoord);
-    float metallic  = texture(metallicMap, fragTexCoord).r;
-    float roughness = texture(roughnessMap, fragTexCoord).r;
-    float ao        = texture(aoMap, fragTexCoord).r;
+    vec3  orm       = texture(ormMap, fragTexCoord).rgb;
+    float ao        = orm.r;
+    float roughness = orm.g;
+    float metallic  = orm.b;
 
     vec3 N = getNormalFromMap();
     vec3 V = normalize(viewPosition - fragPosition);
@@ -0,0 +1,13 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Full screen triangle, the material repeats so the finer mips get minified
+const float TILING = 4.0;
+
+layout(location = 0) out vec2 fragTexCoord;
+
+void main() {
+    vec2 uv      = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    fragTexCoord = uv * TILING;
+    gl_Position  = vec4(uv * 2.0f - 1.0f, 1.0f, 1.0f);
+}
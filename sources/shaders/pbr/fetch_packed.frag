@@ -0,0 +1,19 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Material fetches of main1d.frag with AO, roughness and metallic packed in one map
+
+layout(set = 0, binding = 0) uniform sampler2D albedoMap;
+layout(set = 0, binding = 1) uniform sampler2D normalMap;
+layout(set = 0, binding = 2) uniform sampler2D ormMap;
+
+layout(location = 0) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    vec4 albedo = texture(albedoMap, fragTexCoord);
+    vec3 normal = texture(normalMap, fragTexCoord).rgb;
+    vec3 orm    = texture(ormMap, fragTexCoord).rgb;
+    outColor = albedo * vec4(normal * orm, 1.0);
+}
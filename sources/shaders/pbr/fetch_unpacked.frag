@@ -0,0 +1,23 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Material fetches of main1d.frag with the five separate maps
+
+layout(set = 0, binding = 0) uniform sampler2D albedoMap;
+layout(set = 0, binding = 1) uniform sampler2D aoMap;
+layout(set = 0, binding = 2) uniform sampler2D metallicMap;
+layout(set = 0, binding = 3) uniform sampler2D normalMap;
+layout(set = 0, binding = 4) uniform sampler2D roughnessMap;
+
+layout(location = 0) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    vec4  albedo    = texture(albedoMap, fragTexCoord);
+    vec3  normal    = texture(normalMap, fragTexCoord).rgb;
+    float ao        = texture(aoMap, fragTexCoord).r;
+    float roughness = texture(roughnessMap, fragTexCoord).r;
+    float metallic  = texture(metallicMap, fragTexCoord).r;
+    outColor = albedo * vec4(normal * vec3(ao, roughness, metallic), 1.0);
+}
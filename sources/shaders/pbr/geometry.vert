@@ -0,0 +1,19 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Reads every attribute of main1d.vert, instances are spread on a grid so the
+// pass stays bound by vertex fetch rather than by rasterization
+const uint GRID = 4;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    vec2 cell   = vec2(gl_InstanceIndex % GRID, (gl_InstanceIndex / GRID) % GRID);
+    vec2 center = (cell + 0.5) / GRID * 2.0 - 1.0;
+    fragColor   = (inNormal * 0.5 + 0.5) * vec3(inTexCoord, 1.0);
+    gl_Position = vec4(center + inPosition.xy * (0.5 / GRID), inPosition.z * 0.5 + 0.5, 1.0);
+}
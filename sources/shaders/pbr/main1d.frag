@@ -1,14 +1,25 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : enable
 
 #include "../functions/constants.glsl"
 
+// Constants ==================================================
+// Set per pipeline by GraphicsScene, paths that are off are compiled out
+layout(constant_id = 0) const bool USE_TEXTURE  = false;
+layout(constant_id = 1) const bool INTERFERENCE = true;
+layout(constant_id = 2) const bool USE_FLUID    = false;
+layout(constant_id = 3) const bool IS_LIGHT     = false;
+
 // Buffers ==================================================
 
 layout(push_constant) uniform Misc {
     mat4 model;
     vec3 viewPosition;
     uint isLight;
+    uint albedoIdx;
+    uint normalIdx;
+    uint ormIdx;
 };
 
 layout(set = 1, binding = 0) uniform Lights {
@@ -18,12 +29,13 @@ layout(set = 1, binding = 0) uniform Lights {
     float radiance;
 } lights;
 
+// The toggles are read from the constants above, they stay so the block matches UBParam
 layout(set = 1, binding = 1) uniform Params {
     vec4 albedo;
     float metallic;
     float roughness;
     float ao;
-    uint  useTexture;
+    uint  useTexture; // USE_TEXTURE
     uint  useFluid;
     
     uint  interference;
@@ -35,11 +47,11 @@ layout(set = 1, binding = 1) uniform Params {
 } params;
 
 // Textures ==================================================
-layout(set = 2, binding = 0) uniform sampler2D albedoMap;
-layout(set = 2, binding = 1) uniform sampler2D aoMap;
-layout(set = 2, binding = 2) uniform sampler2D metallicMap;
-layout(set = 2, binding = 3) uniform sampler2D normalMap;
-layout(set = 2, binding = 4) uniform sampler2D roughnessMap;
+// Texture heap, the push constants pick the slots of this draw's material
+layout(set = 2, binding = 0) uniform sampler2D textures[];
+#define albedoMap textures[albedoIdx]
+#define normalMap textures[normalIdx]
+#define ormMap    textures[ormIdx] // r ao, g roughness, b metallic
 
 layout(set = 3, binding = 0) uniform sampler2D heightMap;
 layout(set = 4, binding = 0) uniform sampler2D interferenceImage;
@@ -63,23 +75,29 @@ layout(location = 0) out vec4 outColor;
 #include "../functions/pbr.glsl"
 
 void main() {
+    if (IS_LIGHT) {
+        outColor = lights.color;
+        return;
+    }
+    
     // PBR
     vec3  N         = fragNormal;
     vec4  albedo    = params.albedo;
     float metallic  = params.metallic;
     float roughness = params.roughness;
     float ao        = params.ao;
-    if (params.useTexture > 0) {
+    if (USE_TEXTURE) {
         N         = getNormalFromMap();
         albedo    = texture(albedoMap, fragTexCoord);
-        metallic  = texture(metallicMap, fragTexCoord).r;
-        roughness = texture(roughnessMap, fragTexCoord).r;
-        ao        = texture(aoMap, fragTexCoord).r;
+        vec3 orm  = texture(ormMap, fragTexCoord).rgb;
+        ao        = orm.r;
+        roughness = orm.g;
+        metallic  = orm.b;
     }
     
     vec4 iridescence = vec4(1.);
-    if (params.interference > 0) {
-        vec4  heightmap = params.useFluid > 0 ? texture(heightMap, fragTexCoord) : vec4(params.thicknessScale);
+    if (INTERFERENCE) {
+        vec4  heightmap = USE_FLUID ? texture(heightMap, fragTexCoord) : vec4(params.thicknessScale);
         float n2 = params.refractiveIndex;
         float d  = heightmap.x * params.thicknessScale;
         float theta1 = getTheta1(N);
@@ -149,6 +167,4 @@ void main() {
     // HDR tonemapping
     color.rgb = color.rgb / (color.rgb + vec3(1.0));
     outColor = color;
-    
-    if (isLight == 1) outColor = lights.color;
 }
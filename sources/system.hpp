@@ -5,7 +5,18 @@
 
 #include "files.hpp"
 #include "device.hpp"
+#include "memory_allocator.hpp"
+#include "transient_pool.hpp"
+#include "scheduler.hpp"
 #include "commander.hpp"
+#include "transfer_manager.hpp"
+#include "frame_commander.hpp"
+#include "pipeline_cache.hpp"
+#include "texture_heap.hpp"
+#include "descriptor_allocator.hpp"
+#include "thread_pool.hpp"
+#include "staging_arena.hpp"
+#include "uniform_ring.hpp"
 
 struct Settings {
     bool ShowDemo  = false;
@@ -14,6 +25,9 @@ struct Settings {
     
     long Iteration = 0;
     
+    // 1 to 3, read when the swapchain is created. Fewer frames lower latency, more keep the GPU fed
+    int  FramesInFlight = 2;
+    
     glm::vec3 CameraPos = {};
     
     VkClearColorValue        ClearColor = {0.01f, 0.01f, 0.01f, 1.0f};
@@ -50,11 +64,17 @@ struct Settings {
     bool   UseTexture = false;
     int    Textures  = 6;
     int    Cubemaps  = 2;
+    bool   HalfFloatHDR = false;
+    bool   TransientAliasing = true;
     int    Shapes    = 0;
     
     // Button
     bool btnUpdateTexture = false;
     bool btnUpdateCubemap = false;
+    bool btnBenchmarkMipmap = false;
+    bool btnBenchmarkMaterial = false;
+    bool btnBenchmarkGeometry = false;
+    bool btnBenchmarkPermutation = false;
     
 };
 
@@ -84,20 +104,59 @@ class System {
 public:
     Files*      m_pFiles      = nullptr;
     Device*     m_pDevice     = nullptr;
+    MemoryAllocator* m_pMemoryAllocator = nullptr;
+    Scheduler*  m_pScheduler  = nullptr;
     Commander*  m_pCommander  = nullptr;
+    TransferManager* m_pTransferManager = nullptr;
+    FrameCommander*  m_pFrameCommander  = nullptr;
+    PipelineCache*   m_pPipelineCache   = nullptr;
+    TextureHeap*     m_pTextureHeap     = nullptr;
+    DescriptorAllocator* m_pDescriptorAllocator = nullptr;
+    ThreadPool* m_pThreadPool = nullptr;
+    StagingArena* m_pStagingArena = nullptr;
+    UniformRing*  m_pUniformRing  = nullptr;
     Settings*   m_pSettings   = new struct Settings();
     RenderTime* m_pRenderTime = new struct RenderTime();
     
     static Files*      Files     () { return Instance().m_pFiles;     }
     static Device*     Device    () { return Instance().m_pDevice;     }
-    static Commander*  Commander () { return Instance().m_pCommander;  }
+    static MemoryAllocator* MemoryAllocator() { return Instance().m_pMemoryAllocator; }
+    static Scheduler*  Scheduler () { return Instance().m_pScheduler;  }
+    static Commander*  Commander () { return m_pThreadCommander ? m_pThreadCommander : Instance().m_pCommander; }
+    static TransferManager* TransferManager() { return Instance().m_pTransferManager; }
+    static FrameCommander*  FrameCommander () { return Instance().m_pFrameCommander;  }
+    static PipelineCache*   PipelineCache  () { return Instance().m_pPipelineCache;   }
+    static TextureHeap*     TextureHeap    () { return Instance().m_pTextureHeap;     }
+    static DescriptorAllocator* DescriptorAllocator() { return Instance().m_pDescriptorAllocator; }
     static Settings*   Settings  () { return Instance().m_pSettings;   }
+    static ThreadPool* ThreadPool() { return Instance().m_pThreadPool; }
+    static StagingArena* StagingArena() { return Instance().m_pStagingArena; }
+    static UniformRing*  UniformRing () { return Instance().m_pUniformRing;  }
     static RenderTime* RenderTime() { return Instance().m_pRenderTime; }
+    static TransientPool* TransientPool() { return m_pThreadTransientPool; }
     
     static void initFiles() { Instance().m_pFiles = new class Files(); }
+    static void initThreadPool() {
+        Instance().m_pThreadPool = new class ThreadPool();
+        Instance().m_pThreadPool->create();
+    }
     
     static void setDevice   (class Device*    device   ) { Instance().m_pDevice    = device; }
+    static void setScheduler(class Scheduler* scheduler) { Instance().m_pScheduler = scheduler; }
     static void setCommander(class Commander* commander) { Instance().m_pCommander = commander; }
+    static void setMemoryAllocator(class MemoryAllocator* memoryAllocator) { Instance().m_pMemoryAllocator = memoryAllocator; }
+    static void setTransferManager(class TransferManager* transferManager) { Instance().m_pTransferManager = transferManager; }
+    static void setFrameCommander (class FrameCommander*  frameCommander ) { Instance().m_pFrameCommander  = frameCommander; }
+    static void setPipelineCache  (class PipelineCache*   pipelineCache  ) { Instance().m_pPipelineCache   = pipelineCache; }
+    static void setTextureHeap    (class TextureHeap*     textureHeap    ) { Instance().m_pTextureHeap     = textureHeap; }
+    static void setDescriptorAllocator(class DescriptorAllocator* descriptorAllocator) { Instance().m_pDescriptorAllocator = descriptorAllocator; }
+    static void setStagingArena(class StagingArena* stagingArena) { Instance().m_pStagingArena = stagingArena; }
+    static void setUniformRing (class UniformRing*  uniformRing ) { Instance().m_pUniformRing  = uniformRing; }
+    
+    // Worker threads record and submit through their own pool
+    static void setThreadCommander(class Commander* commander) { m_pThreadCommander = commander; }
+    // Set for the length of a precompute job, transient images on the thread alias its memory
+    static void setThreadTransientPool(class TransientPool* transientPool) { m_pThreadTransientPool = transientPool; }
     
     static System& Instance() {
         static System instance; // Guaranteed to be destroyed. Instantiated on first use.
@@ -107,6 +166,9 @@ public:
     
 private:
     
+    inline static thread_local class Commander* m_pThreadCommander = nullptr;
+    inline static thread_local class TransientPool* m_pThreadTransientPool = nullptr;
+    
     ~System() {}
     System() {}
 
@@ -0,0 +1,138 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#include "task_graph.hpp"
+
+#include "system.hpp"
+
+#include <iomanip>
+#include <sstream>
+
+TaskGraph::~TaskGraph() {}
+TaskGraph::TaskGraph() {}
+
+uint TaskGraph::addMain(STRING name, std::function<void()> work, VECTOR<uint> dependencies) {
+    return add(name, work, dependencies, false);
+}
+
+uint TaskGraph::addWorker(STRING name, std::function<void()> work, VECTOR<uint> dependencies) {
+    return add(name, work, dependencies, true);
+}
+
+// Main tasks run in the order they become ready, a finished worker is
+// handled first so its dependents reach the pool as early as possible
+void TaskGraph::run() {
+    LOG("TaskGraph::run " << m_tasks.size() << " tasks");
+    m_startTime = ChronoTime::now();
+    for (uint i = 0; i < m_tasks.size(); i++)
+        if (m_tasks[i].remaining == 0) start(i);
+    
+    for (uint done = 0; done < m_tasks.size(); done++) {
+        uint idx;
+        bool isWorker;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [=](){ return !m_finished.empty() || !m_readyMain.empty(); });
+            isWorker = !m_finished.empty();
+            std::queue<uint>& queue = isWorker ? m_finished : m_readyMain;
+            idx = queue.front();
+            queue.pop();
+        }
+        Task& task = m_tasks[idx];
+        if (isWorker) {
+            if (task.error) std::rethrow_exception(task.error);
+        } else {
+            task.startTime = getTime();
+            task.work();
+            task.endTime   = getTime();
+        }
+        finish(idx);
+    }
+    m_totalTime = getTime();
+}
+
+// The critical path walks back from the last task through whichever
+// dependency finished last, that chain is what bounds the startup time
+void TaskGraph::report() {
+    VECTOR<Task> tasks = m_tasks;
+    float workTime = 0;
+    uint  lastIdx  = 0;
+    for (uint i = 0; i < tasks.size(); i++) {
+        std::stringstream stream;
+        stream << std::fixed << std::setprecision(1) << std::left << std::setw(20) << tasks[i].name <<
+            (tasks[i].isWorker ? " worker" : " main  ") <<
+            " start " << std::right << std::setw(8) << tasks[i].startTime * 1000 << "ms" <<
+            " took "  << std::setw(8) << (tasks[i].endTime - tasks[i].startTime) * 1000 << "ms";
+        LOG("TaskGraph::task " << stream.str());
+        workTime += tasks[i].endTime - tasks[i].startTime;
+        if (tasks[i].endTime > tasks[lastIdx].endTime) lastIdx = i;
+    }
+    if (tasks.empty()) return;
+    
+    VECTOR<uint> path = { lastIdx };
+    while (!tasks[path.back()].dependencies.empty()) {
+        uint criticalIdx = tasks[path.back()].dependencies[0];
+        for (uint dependency : tasks[path.back()].dependencies)
+            if (tasks[dependency].endTime > tasks[criticalIdx].endTime) criticalIdx = dependency;
+        path.push_back(criticalIdx);
+    }
+    
+    std::stringstream stream;
+    float pathTime = 0;
+    stream << std::fixed << std::setprecision(1);
+    for (uint i = UINT32(path.size()); i-- > 0;) {
+        Task task = tasks[path[i]];
+        pathTime += task.endTime - task.startTime;
+        stream << task.name << " " << (task.endTime - task.startTime) * 1000 << "ms" << (i > 0 ? " > " : "");
+    }
+    LOG("TaskGraph::critical path " << stream.str());
+    
+    stream.str("");
+    stream << std::fixed << std::setprecision(1) << "wall " << m_totalTime * 1000 << "ms, " <<
+        "critical path " << pathTime * 1000 << "ms, " <<
+        "summed tasks " << workTime * 1000 << "ms";
+    LOG("TaskGraph::total " << stream.str());
+}
+
+
+// Private ==================================================
+
+uint TaskGraph::add(STRING name, std::function<void()> work, VECTOR<uint> dependencies, bool isWorker) {
+    uint idx = UINT32(m_tasks.size());
+    Task task;
+    task.name         = name;
+    task.work         = work;
+    task.dependencies = dependencies;
+    task.isWorker     = isWorker;
+    task.remaining    = UINT32(dependencies.size());
+    m_tasks.push_back(task);
+    for (uint dependency : dependencies) m_tasks[dependency].dependents.push_back(idx);
+    return idx;
+}
+
+void TaskGraph::start(uint idx) {
+    if (!m_tasks[idx].isWorker) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_readyMain.push(idx);
+        return;
+    }
+    System::ThreadPool()->submit([=](){
+        Task& task = m_tasks[idx];
+        task.startTime = getTime();
+        try { task.work(); }
+        catch (...) { task.error = std::current_exception(); }
+        task.endTime = getTime();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_finished.push(idx);
+        }
+        m_condition.notify_one();
+    });
+}
+
+void TaskGraph::finish(uint idx) {
+    for (uint dependent : m_tasks[idx].dependents)
+        if (--m_tasks[dependent].remaining == 0) start(dependent);
+}
+
+float TaskGraph::getTime() { return TimeDif(ChronoTime::now() - m_startTime).count(); }
@@ -0,0 +1,55 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#pragma once
+
+#include "include.h"
+#include "thread_pool.hpp"
+
+#include <queue>
+#include <mutex>
+#include <exception>
+#include <condition_variable>
+
+// Runs a set of tasks in dependency order. Worker tasks go to the thread pool as
+// soon as their dependencies finish, main tasks run on the thread calling run,
+// which is the only one allowed to touch the window, queues and cleaners.
+class TaskGraph {
+
+    struct Task {
+        STRING name;
+        std::function<void()> work;
+        VECTOR<uint> dependencies;
+        VECTOR<uint> dependents;
+        bool  isWorker  = false;
+        uint  remaining = 0;
+        float startTime = 0;
+        float endTime   = 0;
+        std::exception_ptr error;
+    };
+
+public:
+    ~TaskGraph();
+    TaskGraph();
+
+    uint addMain  (STRING name, std::function<void()> work, VECTOR<uint> dependencies = {});
+    uint addWorker(STRING name, std::function<void()> work, VECTOR<uint> dependencies = {});
+
+    void run();
+    void report();
+
+private:
+    VECTOR<Task> m_tasks;
+    TimeVal      m_startTime;
+    float        m_totalTime = 0;
+
+    std::queue<uint> m_readyMain;
+    std::queue<uint> m_finished;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+
+    uint add(STRING name, std::function<void()> work, VECTOR<uint> dependencies, bool isWorker);
+    void start(uint idx);
+    void finish(uint idx);
+    float getTime();
+};
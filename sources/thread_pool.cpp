@@ -0,0 +1,45 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#include "thread_pool.hpp"
+
+ThreadPool::~ThreadPool() {}
+ThreadPool::ThreadPool() {}
+
+void ThreadPool::cleanup() { m_cleaner.flush("ThreadPool"); }
+
+void ThreadPool::create(uint threadCount) {
+    LOG("ThreadPool::create " << threadCount);
+    m_stop = false;
+    for (uint i = 0; i < std::max(threadCount, 1u); i++)
+        m_threads.push_back(std::thread(&ThreadPool::work, this));
+
+    m_cleaner.push([=](){
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_condition.notify_all();
+        for (std::thread& thread : m_threads) thread.join();
+        m_threads.clear();
+    });
+}
+
+uint ThreadPool::getThreadCount() { return UINT32(m_threads.size()); }
+
+
+// Private ==================================================
+
+void ThreadPool::work() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [=](){ return m_stop || !m_tasks.empty(); });
+            if (m_stop && m_tasks.empty()) return;
+            task = std::move(m_tasks.front());
+            m_tasks.pop();
+        }
+        task();
+    }
+}
@@ -0,0 +1,47 @@
+//  Copyright © 2022 Subph. All rights reserved.
+//
+
+#pragma once
+
+#include "include.h"
+
+#include <queue>
+#include <mutex>
+#include <future>
+#include <condition_variable>
+
+class ThreadPool {
+
+public:
+    ~ThreadPool();
+    ThreadPool();
+
+    void cleanup();
+    void create(uint threadCount = std::thread::hardware_concurrency());
+
+    template<typename F>
+    std::future<std::invoke_result_t<F>> submit(F&& task) {
+        typedef std::invoke_result_t<F> Result;
+        auto pTask = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> future = pTask->get_future();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.push([pTask](){ (*pTask)(); });
+        }
+        m_condition.notify_one();
+        return future;
+    }
+
+    uint getThreadCount();
+
+private:
+    Cleaner m_cleaner;
+
+    bool m_stop = false;
+    VECTOR<std::thread> m_threads;
+    std::queue<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+
+    void work();
+};
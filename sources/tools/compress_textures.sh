@@ -0,0 +1,46 @@
+#!/usr/bin/env bash
+
+# Writes a <file>.ktx2 next to every PBR map (BC7) and environment hdr (BC6H)
+# with the full mip chain precomputed. Image::setupForCompressed loads those
+# directly, delete them to go back to the stb path.
+#
+# Needs compressonatorcli from https://github.com/GPUOpen-Tools/compressonator
+# Usage: SRCROOT=<repo root> sources/tools/compress_textures.sh [-f]
+
+texture_dir="$SRCROOT/resources/textures"
+compressonator_dir="$SRCROOT/libraries/compressonator"
+compressonator="$compressonator_dir/compressonatorcli"
+[ -x "$compressonator" ] || compressonator="compressonatorcli"
+
+force=false
+[ "$1" == "-f" ] && force=true
+
+echo "texture dir: $texture_dir"
+echo "compressonator: $compressonator"
+
+compress() {
+    input=$1
+    format=$2
+    output="$input.ktx2"
+    if [ $force == false ] && [ "$output" -nt "$input" ]; then
+        echo "up to date $output"
+        return
+    fi
+    echo "compressing $input to $format"
+    "$compressonator" -fd "$format" -mipsize 1 "$input" "$output" > /dev/null
+    if [ $? -ne 0 ]; then
+        echo "failed to compress $input"
+        rm -f "$output"
+    fi
+}
+
+# BC7 is written as UNORM, the loader promotes it to sRGB like the png path.
+# The _orm.tga files are packed by the app, run it once per set beforehand.
+for file in "$texture_dir"/pbr/*/*_albedo.png "$texture_dir"/pbr/*/*_normal.png "$texture_dir"/pbr/*/*_orm.tga; do
+    [ -f "$file" ] || continue
+    compress "$file" BC7
+done
+
+for file in "$texture_dir"/cubemap/*/*.hdr; do
+    compress "$file" BC6H
+done
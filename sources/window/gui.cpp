@@ -22,6 +22,7 @@ void GUI::initGUI(Window* pWindow, Renderpass* pRenderpass) {
     m_initInfo.Device         = pDevice->getDevice();
     m_initInfo.Queue          = pDevice->getGraphicQueue();
     m_initInfo.DescriptorPool = IMGUI::CreateDescPool(device);
+    m_initInfo.PipelineCache  = System::PipelineCache()->get();
     m_initInfo.MinImageCount  = 3;
     m_initInfo.ImageCount     = 3;
     m_initInfo.MSAASamples    = VK_SAMPLE_COUNT_1_BIT;
@@ -113,6 +114,42 @@ void GUI::drawStatusWindow() {
         ImGui::SliderFloat("Roughness", &settings->Roughness, 0.f, 1.f);
     }
     
+    ImGui::Separator();
+    if (ImGui::CollapsingHeader("Memory")) {
+        VECTOR<MemoryAllocator::HeapStats> heapStats = System::MemoryAllocator()->getHeapStats();
+        for (uint i = 0; i < heapStats.size(); i++) {
+            MemoryAllocator::HeapStats stats = heapStats[i];
+            ImGui::Text("Heap %u %s", i, stats.isDeviceLocal ? "(device)" : "(host)");
+            ImGui::Text("  %.1f / %.1f MB in %u blocks", stats.usedBytes / 1048576.f,
+                        stats.blockBytes / 1048576.f, stats.blockCount);
+            ImGui::Text("  %u allocations, heap %.0f MB", stats.allocationCount,
+                        stats.heapSize / 1048576.f);
+        }
+    }
+    
+    
+    ImGui::Separator();
+    if (ImGui::CollapsingHeader("Benchmark")) {
+        if (ImGui::Button("Mipmaps")) {
+            LOG("Button::Benchmark Mipmaps");
+            settings->btnBenchmarkMipmap = true;
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Materials")) {
+            LOG("Button::Benchmark Materials");
+            settings->btnBenchmarkMaterial = true;
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Geometry")) {
+            LOG("Button::Benchmark Geometry");
+            settings->btnBenchmarkGeometry = true;
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Permutations")) {
+            LOG("Button::Benchmark Permutations");
+            settings->btnBenchmarkPermutation = true;
+        }
+    }
     
     ImGui::Separator();
     ImGui::Checkbox("Show ImGUI demo", &settings->ShowDemo);
@@ -132,15 +169,15 @@ void GUI::drawImageWindow() {
     ImGui::Checkbox("Simulate Fluid", &settings->RunFluid);
     if (ImGui::BeginTabBar("FluidTabBar")) {
         if (ImGui::BeginTabItem("Height")) {
-            ImGui::Image(m_heightMapTexID, {234, 234});
+            ImGui::Image(m_heightMapTexID[m_fluidIdx], {234, 234});
             ImGui::EndTabItem();
         }
         if (ImGui::BeginTabItem("Fluid")) {
-            ImGui::Image(m_fluidTexID, {234, 234});
+            ImGui::Image(m_fluidTexID[m_fluidIdx], {234, 234});
             ImGui::EndTabItem();
         }
         if (ImGui::BeginTabItem("Iridesence")) {
-            ImGui::Image(m_iridescentTexID, {234, 234});
+            ImGui::Image(m_iridescentTexID[m_fluidIdx], {234, 234});
             ImGui::EndTabItem();
         }
         ImGui::EndTabBar();
@@ -172,6 +209,7 @@ void GUI::drawImageWindow() {
             ImGui::PushItemWidth(ImGui::GetWindowWidth() * 0.65f);
             ImGui::SliderInt("Cubemaps", &settings->Cubemaps, 0, pFiles->getTotalCubemap()-1);
             ImGui::Image(m_cubemapPrevID[settings->Cubemaps], {234, 117});
+            ImGui::Checkbox("Half float HDR", &settings->HalfFloatHDR);
             if (ImGui::Button("Update Cubemap")) {
                 LOG("Button::Cubemap Update");
                 pFiles->setCubemapIdx(settings->Cubemaps);
@@ -194,21 +232,23 @@ void GUI::addInterferenceImage(Image* pImage) {
     m_interferenceTexID = (ImTextureID)ImGui_ImplVulkan_CreateTexture(pImage->getSampler(), pImage->getImageView(), pImage->getImageLayout());
 }
 
-void GUI::updateHeightMapImage(Image* pImage) {
+void GUI::updateHeightMapImage(Image* pImage, uint idx) {
     pImage->cmdTransitionToShaderR();
-    m_heightMapTexID = (ImTextureID)ImGui_ImplVulkan_CreateTexture(pImage->getSampler(), pImage->getImageView(), pImage->getImageLayout());
+    m_heightMapTexID[idx] = (ImTextureID)ImGui_ImplVulkan_CreateTexture(pImage->getSampler(), pImage->getImageView(), pImage->getImageLayout());
 }
 
-void GUI::updateIridescentImage(Image* pImage) {
+void GUI::updateIridescentImage(Image* pImage, uint idx) {
     pImage->cmdTransitionToShaderR();
-    m_iridescentTexID = (ImTextureID)ImGui_ImplVulkan_CreateTexture(pImage->getSampler(), pImage->getImageView(), pImage->getImageLayout());
+    m_iridescentTexID[idx] = (ImTextureID)ImGui_ImplVulkan_CreateTexture(pImage->getSampler(), pImage->getImageView(), pImage->getImageLayout());
 }
 
-void GUI::updateFluidImage(Image* pImage) {
+void GUI::updateFluidImage(Image* pImage, uint idx) {
     pImage->cmdTransitionToShaderR();
-    m_fluidTexID = (ImTextureID)ImGui_ImplVulkan_CreateTexture(pImage->getSampler(), pImage->getImageView(), pImage->getImageLayout());
+    m_fluidTexID[idx] = (ImTextureID)ImGui_ImplVulkan_CreateTexture(pImage->getSampler(), pImage->getImageView(), pImage->getImageLayout());
 }
 
+void GUI::setFluidIdx(uint idx) { m_fluidIdx = idx; }
+
 void GUI::addCubemapImage(Image* pImage) {
     m_cubemapTexID = (ImTextureID)ImGui_ImplVulkan_CreateTexture(pImage->getSampler(), pImage->getImageView(), pImage->getImageLayout());
 }
@@ -22,9 +22,10 @@ public:
     void renderGUI(VkCommandBuffer cmdBuffer);
     
     void addInterferenceImage(Image* pImage);
-    void updateHeightMapImage(Image* pImage);
-    void updateIridescentImage(Image* pImage);
-    void updateFluidImage(Image* pImage);
+    void updateHeightMapImage(Image* pImage, uint idx = 0);
+    void updateIridescentImage(Image* pImage, uint idx = 0);
+    void updateFluidImage(Image* pImage, uint idx = 0);
+    void setFluidIdx(uint idx);
     
     void addCubemapImage(Image* pImage);
     void addTextureImage(Image* pImage);
@@ -37,9 +38,10 @@ private:
     Window* m_pWindow;
     
     ImTextureID m_interferenceTexID;
-    ImTextureID m_fluidTexID;
-    ImTextureID m_heightMapTexID;
-    ImTextureID m_iridescentTexID;
+    ImTextureID m_fluidTexID[2];
+    ImTextureID m_heightMapTexID[2];
+    ImTextureID m_iridescentTexID[2];
+    uint        m_fluidIdx = 0;
     
     VECTOR<ImTextureID> m_cubemapPrevID;
     VECTOR<ImTextureID> m_texturePrevID;